@@ -167,6 +167,7 @@ static int restore_tty;
 
 #if HAVE_THREADS
 static void free_input_threads(void);
+static void free_encoder_thread(OutputStream *ost);
 #endif
 
 /* sub2video hack:
@@ -605,6 +606,9 @@ static void ffmpeg_cleanup(int ret)
         av_dict_free(&ost->sws_dict);
         av_dict_free(&ost->swr_opts);
 
+#if HAVE_THREADS
+        free_encoder_thread(ost);
+#endif
         avcodec_free_context(&ost->enc_ctx);
         avcodec_parameters_free(&ost->ref_par);
 
@@ -971,6 +975,211 @@ early_exit:
     return float_pts;
 }
 
+typedef struct EncoderThreadMessage {
+    AVPacket pkt;
+    /* no packet, the encoder thread only took a frame off its input queue */
+    int frame_consumed;
+} EncoderThreadMessage;
+
+#if HAVE_THREADS
+static void *encoder_thread(void *arg)
+{
+    OutputStream  *ost = arg;
+    AVCodecContext *enc = ost->enc_ctx;
+    EncoderThreadMessage msg;
+    AVFrame *frame;
+    int64_t frame_pts;
+    int flushing, ret;
+
+    do {
+        ret = av_thread_message_queue_recv(ost->enc_in_queue, &frame, 0);
+        if (ret < 0)
+            break;
+
+        flushing  = !frame;
+        frame_pts = frame ? frame->pts : AV_NOPTS_VALUE;
+        if (frame && enc->codec_type == AVMEDIA_TYPE_VIDEO &&
+            !ost->frame_aspect_ratio.num)
+            enc->sample_aspect_ratio = frame->sample_aspect_ratio;
+        ret = avcodec_send_frame(enc, frame);
+        av_frame_free(&frame);
+
+        while (ret >= 0) {
+            memset(&msg, 0, sizeof(msg));
+            av_init_packet(&msg.pkt);
+
+            ret = avcodec_receive_packet(enc, &msg.pkt);
+            if ((flushing || enc->codec_type == AVMEDIA_TYPE_VIDEO) &&
+                (ret >= 0 || ret == AVERROR_EOF) &&
+                ost->logfile && enc->stats_out)
+                fprintf(ost->logfile, "%s", enc->stats_out);
+            if (ret == AVERROR(EAGAIN)) {
+                ret = 0;
+                break;
+            }
+            if (ret < 0)
+                break;
+
+            if (enc->codec_type == AVMEDIA_TYPE_VIDEO &&
+                msg.pkt.pts == AV_NOPTS_VALUE &&
+                !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
+                msg.pkt.pts = frame_pts;
+
+            ret = av_thread_message_queue_send(ost->enc_out_queue, &msg, 0);
+            if (ret < 0)
+                av_packet_unref(&msg.pkt);
+        }
+
+        if (ret >= 0) {
+            memset(&msg, 0, sizeof(msg));
+            msg.frame_consumed = 1;
+            ret = av_thread_message_queue_send(ost->enc_out_queue, &msg, 0);
+        }
+    } while (ret >= 0);
+
+    av_thread_message_queue_set_err_send(ost->enc_in_queue, ret);
+    av_thread_message_queue_set_err_recv(ost->enc_out_queue, ret);
+
+    return NULL;
+}
+
+static void encoder_thread_free_frame(void *msg)
+{
+    av_frame_free(msg);
+}
+
+static void encoder_thread_free_msg(void *msg)
+{
+    av_packet_unref(&((EncoderThreadMessage *)msg)->pkt);
+}
+
+static void free_encoder_thread(OutputStream *ost)
+{
+    if (!ost->enc_in_queue)
+        return;
+
+    av_thread_message_queue_set_err_send(ost->enc_out_queue, AVERROR_EOF);
+    av_thread_message_queue_set_err_send(ost->enc_in_queue, AVERROR_EOF);
+    av_thread_message_flush(ost->enc_in_queue);
+    av_thread_message_queue_set_err_recv(ost->enc_in_queue, AVERROR_EOF);
+
+    pthread_join(ost->enc_thread, NULL);
+
+    av_thread_message_queue_free(&ost->enc_in_queue);
+    av_thread_message_queue_free(&ost->enc_out_queue);
+}
+
+static int init_encoder_thread(OutputStream *ost)
+{
+    int ret;
+
+    ret = av_thread_message_queue_alloc(&ost->enc_in_queue,
+                                        ost->enc_thread_queue_size,
+                                        sizeof(AVFrame *));
+    if (ret < 0)
+        return ret;
+    av_thread_message_queue_set_free_func(ost->enc_in_queue,
+                                          encoder_thread_free_frame);
+
+    /* the encoder never blocks for long on this queue as the main thread
+     * drains it whenever it hands over a frame */
+    ret = av_thread_message_queue_alloc(&ost->enc_out_queue,
+                                        ost->enc_thread_queue_size,
+                                        sizeof(EncoderThreadMessage));
+    if (ret < 0)
+        goto fail;
+    av_thread_message_queue_set_free_func(ost->enc_out_queue,
+                                          encoder_thread_free_msg);
+
+    if ((ret = pthread_create(&ost->enc_thread, NULL, encoder_thread, ost))) {
+        av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    return 0;
+fail:
+    av_thread_message_queue_free(&ost->enc_in_queue);
+    av_thread_message_queue_free(&ost->enc_out_queue);
+    return ret;
+}
+#endif
+
+/*
+ * Get one message from the encoder thread of ost and mux the packet it
+ * carries, if any.
+ *
+ * @return 0 if a message was processed, AVERROR(EAGAIN) if none was available
+ *         and flags contains AV_THREAD_MESSAGE_NONBLOCK, AVERROR_EOF once the
+ *         encoder has been flushed, another negative error code on failure
+ */
+static int encoder_thread_receive(OutputFile *of, OutputStream *ost,
+                                  unsigned flags)
+{
+    enum AVMediaType type = ost->st->codecpar->codec_type;
+    EncoderThreadMessage msg;
+    int frame_size, ret;
+
+    ret = av_thread_message_queue_recv(ost->enc_out_queue, &msg, flags);
+    if (ret < 0 || msg.frame_consumed)
+        return ret;
+
+    if (ost->finished & MUXER_FINISHED) {
+        av_packet_unref(&msg.pkt);
+        return 0;
+    }
+
+    av_packet_rescale_ts(&msg.pkt, ost->enc_time_base, ost->mux_timebase);
+
+    if (debug_ts) {
+        av_log(NULL, AV_LOG_INFO, "encoder -> type:%s "
+               "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
+               av_get_media_type_string(type),
+               av_ts2str(msg.pkt.pts), av_ts2timestr(msg.pkt.pts, &ost->mux_timebase),
+               av_ts2str(msg.pkt.dts), av_ts2timestr(msg.pkt.dts, &ost->mux_timebase));
+    }
+
+    frame_size = msg.pkt.size;
+    output_packet(of, &msg.pkt, ost, 0);
+
+    if (type == AVMEDIA_TYPE_VIDEO && vstats_filename && frame_size)
+        do_video_stats(ost, frame_size);
+
+    return 0;
+}
+
+/*
+ * Queue a new reference to frame, or NULL to flush, for the encoder thread of
+ * ost, waiting for it to make room in the queue if necessary, and mux all
+ * packets it has produced so far.
+ */
+static int encoder_thread_send(OutputFile *of, OutputStream *ost,
+                               AVFrame *frame)
+{
+    AVFrame *tmp = NULL;
+    int ret;
+
+    if (frame && !(tmp = av_frame_clone(frame)))
+        return AVERROR(ENOMEM);
+
+    while ((ret = av_thread_message_queue_send(ost->enc_in_queue, &tmp,
+                                               AV_THREAD_MESSAGE_NONBLOCK)) == AVERROR(EAGAIN)) {
+        /* every frame taken off the input queue is acknowledged, so this
+         * cannot block forever */
+        ret = encoder_thread_receive(of, ost, 0);
+        if (ret < 0)
+            break;
+    }
+    if (ret < 0) {
+        av_frame_free(&tmp);
+        return ret;
+    }
+
+    while ((ret = encoder_thread_receive(of, ost, AV_THREAD_MESSAGE_NONBLOCK)) >= 0)
+        ;
+    return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ? 0 : ret;
+}
+
 static int init_output_stream(OutputStream *ost, AVFrame *frame,
                               char *error, int error_len);
 
@@ -1026,11 +1235,14 @@ static void do_audio_out(OutputFile *of, OutputStream *ost,
                enc->time_base.num, enc->time_base.den);
     }
 
-    ret = avcodec_send_frame(enc, frame);
+    if (ost->enc_in_queue)
+        ret = encoder_thread_send(of, ost, frame);
+    else
+        ret = avcodec_send_frame(enc, frame);
     if (ret < 0)
         goto error;
 
-    while (1) {
+    while (!ost->enc_in_queue) {
         ret = avcodec_receive_packet(enc, &pkt);
         if (ret == AVERROR(EAGAIN))
             break;
@@ -1365,13 +1577,16 @@ static void do_video_out(OutputFile *of,
 
         ost->frames_encoded++;
 
-        ret = avcodec_send_frame(enc, in_picture);
+        if (ost->enc_in_queue)
+            ret = encoder_thread_send(of, ost, in_picture);
+        else
+            ret = avcodec_send_frame(enc, in_picture);
         if (ret < 0)
             goto error;
         // Make sure Closed Captions will not be duplicated
         av_frame_remove_side_data(in_picture, AV_FRAME_DATA_A53_CC);
 
-        while (1) {
+        while (!ost->enc_in_queue) {
             ret = avcodec_receive_packet(enc, &pkt);
             update_benchmark("encode_video %d.%d", ost->file_index, ost->index);
             if (ret == AVERROR(EAGAIN))
@@ -1439,7 +1654,7 @@ static double psnr(double d)
 
 static void do_video_stats(OutputStream *ost, int frame_size)
 {
-    AVCodecContext *enc;
+    const AVCodecParameters *par = ost->st->codecpar;
     int frame_number;
     double ti1, bitrate, avg_bitrate;
 
@@ -1452,8 +1667,7 @@ static void do_video_stats(OutputStream *ost, int frame_size)
         }
     }
 
-    enc = ost->enc_ctx;
-    if (enc->codec_type == AVMEDIA_TYPE_VIDEO) {
+    if (par->codec_type == AVMEDIA_TYPE_VIDEO) {
         frame_number = ost->st->nb_frames;
         if (vstats_version <= 1) {
             fprintf(vstats_file, "frame= %5d q= %2.1f ", frame_number,
@@ -1463,8 +1677,8 @@ static void do_video_stats(OutputStream *ost, int frame_size)
                     ost->quality / (float)FF_QP2LAMBDA);
         }
 
-        if (ost->error[0]>=0 && (enc->flags & AV_CODEC_FLAG_PSNR))
-            fprintf(vstats_file, "PSNR= %6.2f ", psnr(ost->error[0] / (enc->width * enc->height * 255.0 * 255.0)));
+        if (ost->error[0]>=0 && (ost->enc_flags & AV_CODEC_FLAG_PSNR))
+            fprintf(vstats_file, "PSNR= %6.2f ", psnr(ost->error[0] / (par->width * par->height * 255.0 * 255.0)));
 
         fprintf(vstats_file,"f_size= %6d ", frame_size);
         /* compute pts value */
@@ -1472,7 +1686,7 @@ static void do_video_stats(OutputStream *ost, int frame_size)
         if (ti1 < 0.01)
             ti1 = 0.01;
 
-        bitrate     = (frame_size * 8) / av_q2d(enc->time_base) / 1000.0;
+        bitrate     = (frame_size * 8) / av_q2d(ost->enc_time_base) / 1000.0;
         avg_bitrate = (double)(ost->data_size * 8) / ti1 / 1000.0;
         fprintf(vstats_file, "s_size= %8.0fkB time= %0.3f br= %7.1fkbits/s avg_br= %7.1fkbits/s ",
                (double)ost->data_size / 1024, ti1, bitrate, avg_bitrate);
@@ -1553,7 +1767,8 @@ static int reap_filters(int flush)
 
             switch (av_buffersink_get_type(filter)) {
             case AVMEDIA_TYPE_VIDEO:
-                if (!ost->frame_aspect_ratio.num)
+                /* the encoder thread takes it from the queued frame */
+                if (!ost->frame_aspect_ratio.num && !ost->enc_in_queue)
                     enc->sample_aspect_ratio = filtered_frame->sample_aspect_ratio;
 
                 do_video_out(of, ost, filtered_frame);
@@ -1696,6 +1911,38 @@ static void print_final_stats(int64_t total_size)
     }
 }
 
+static void print_filtergraph_stats(void)
+{
+    int i, j;
+
+    for (i = 0; i < nb_filtergraphs; i++) {
+        AVFilterGraph *graph = filtergraphs[i]->graph;
+
+        if (!graph)
+            continue;
+
+        av_log(NULL, AV_LOG_INFO, "Filtergraph #%d statistics (times in ms):\n", i);
+        av_log(NULL, AV_LOG_INFO, "  %-28s %8s %8s %8s %8s %9s %9s %8s %9s %9s %6s\n",
+               "filter", "runs", "in", "out", "copies", "wall", "cpu",
+               "jobs", "jobs max", "idle", "queue");
+        for (j = 0; j < graph->nb_filters; j++) {
+            AVFilterContext *f = graph->filters[j];
+            AVFilterStats *st = avfilter_get_stats(f);
+
+            if (!st)
+                continue;
+            av_log(NULL, AV_LOG_INFO, "  %-28s %8"PRId64" %8"PRId64" %8"PRId64" %8"PRId64
+                   " %9.1f %9.1f %8"PRId64" %9.1f %9.1f %6d\n",
+                   f->name, st->nb_activations, st->frames_in, st->frames_out,
+                   st->copied_frames,
+                   st->time / 1000.0, st->cpu_time / 1000.0, st->nb_jobs,
+                   st->job_time_max / 1000.0, st->idle_time / 1000.0,
+                   st->max_queued);
+            av_free(st);
+        }
+    }
+}
+
 static void print_report(int is_last_report, int64_t timer_start, int64_t cur_time)
 {
     AVBPrint buf, buf_script;
@@ -1966,6 +2213,25 @@ static void flush_encoders(void)
         if (enc->codec_type != AVMEDIA_TYPE_VIDEO && enc->codec_type != AVMEDIA_TYPE_AUDIO)
             continue;
 
+        if (ost->enc_in_queue) {
+            AVPacket pkt = { 0 };
+
+            ret = encoder_thread_send(of, ost, NULL);
+            while (ret >= 0)
+                ret = encoder_thread_receive(of, ost, 0);
+            if (ret < 0 && ret != AVERROR_EOF) {
+                av_log(NULL, AV_LOG_FATAL, "%s encoding failed: %s\n",
+                       av_get_media_type_string(enc->codec_type),
+                       av_err2str(ret));
+                exit_program(1);
+            }
+            output_packet(of, &pkt, ost, 1);
+#if HAVE_THREADS
+            free_encoder_thread(ost);
+#endif
+            continue;
+        }
+
         for (;;) {
             const char *desc = NULL;
             AVPacket pkt;
@@ -3600,6 +3866,8 @@ static int init_output_stream(OutputStream *ost, AVFrame *frame,
                    "Error initializing the output stream codec context.\n");
             exit_program(1);
         }
+        ost->enc_time_base = ost->enc_ctx->time_base;
+        ost->enc_flags     = ost->enc_ctx->flags;
 
         if (ost->enc_ctx->nb_coded_side_data) {
             int i;
@@ -3644,6 +3912,19 @@ static int init_output_stream(OutputStream *ost, AVFrame *frame,
         // copy estimated duration as a hint to the muxer
         if (ost->st->duration <= 0 && ist && ist->st->duration > 0)
             ost->st->duration = av_rescale_q(ist->st->duration, ist->st->time_base, ost->st->time_base);
+
+#if HAVE_THREADS
+        if (ost->enc_thread_queue_size > 0 &&
+            (ost->enc->type == AVMEDIA_TYPE_VIDEO ||
+             ost->enc->type == AVMEDIA_TYPE_AUDIO)) {
+            ret = init_encoder_thread(ost);
+            if (ret < 0) {
+                snprintf(error, error_len, "Error starting the encoder thread "
+                         "for output stream #%d:%d", ost->file_index, ost->index);
+                return ret;
+            }
+        }
+#endif
     } else if (ost->stream_copy) {
         ret = init_output_stream_streamcopy(ost);
         if (ret < 0)
@@ -4821,6 +5102,8 @@ static int transcode(void)
 
     /* dump report by using the first video and audio streams */
     print_report(1, timer_start, av_gettime_relative());
+    if (filter_stats)
+        print_filtergraph_stats();
 
     /* close each encoder */
     for (i = 0; i < nb_output_streams; i++) {
@@ -4861,6 +5144,12 @@ static int transcode(void)
 #endif
 
     if (output_streams) {
+#if HAVE_THREADS
+        /* the encoder threads may still write to the pass logfiles */
+        for (i = 0; i < nb_output_streams; i++)
+            if (output_streams[i])
+                free_encoder_thread(output_streams[i]);
+#endif
         for (i = 0; i < nb_output_streams; i++) {
             ost = output_streams[i];
             if (ost) {
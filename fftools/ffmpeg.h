@@ -219,6 +219,8 @@ typedef struct OptionsContext {
     int        nb_max_muxing_queue_size;
     SpecifierOpt *muxing_queue_data_threshold;
     int        nb_muxing_queue_data_threshold;
+    SpecifierOpt *enc_thread_queue_size;
+    int        nb_enc_thread_queue_size;
     SpecifierOpt *guess_layout_max;
     int        nb_guess_layout_max;
     SpecifierOpt *apad;
@@ -566,6 +568,19 @@ typedef struct OutputStream {
 
     /* frame encode sum of squared error values */
     int64_t error[4];
+
+    /* maximum number of frames queued for the encoder thread, 0 to encode
+     * from the main thread */
+    int enc_thread_queue_size;
+    AVThreadMessageQueue *enc_in_queue;  /* frames sent to the encoder thread */
+    AVThreadMessageQueue *enc_out_queue; /* packets received from it */
+#if HAVE_THREADS
+    pthread_t enc_thread;                /* thread running the encoder */
+#endif
+    /* encoder parameters read from the main thread, copied once the encoder
+     * is opened so that enc_ctx is only used by the thread running it */
+    AVRational enc_time_base;
+    int        enc_flags;
 } OutputStream;
 
 typedef struct OutputFile {
@@ -627,6 +642,9 @@ extern char *videotoolbox_pixfmt;
 
 extern int filter_nbthreads;
 extern int filter_complex_nbthreads;
+extern int filter_stats;
+extern char *filter_affinity;
+extern int filter_shared_threads;
 extern int vstats_version;
 extern int auto_conversion_filters;
 
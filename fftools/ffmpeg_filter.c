@@ -990,6 +990,7 @@ int configure_filtergraph(FilterGraph *fg)
     cleanup_filtergraph(fg);
     if (!(fg->graph = avfilter_graph_alloc()))
         return AVERROR(ENOMEM);
+    fg->graph->collect_stats = filter_stats;
 
     if (simple) {
         OutputStream *ost = fg->outputs[0]->ost;
@@ -1030,6 +1031,10 @@ int configure_filtergraph(FilterGraph *fg)
     } else {
         fg->graph->nb_threads = filter_complex_nbthreads;
     }
+    if (filter_affinity &&
+        (ret = av_opt_set(fg->graph, "thread_affinity", filter_affinity, 0)) < 0)
+        goto fail;
+    fg->graph->shared_threads = filter_shared_threads;
 
     if ((ret = avfilter_graph_parse2(fg->graph, graph_desc, &inputs, &outputs)) < 0)
         goto fail;
@@ -550,6 +550,108 @@ static void copy_input_samples(AACEncContext *s, const AVFrame *frame)
     }
 }
 
+/**
+ * Search the coding parameters of one channel element, i.e. run the
+ * quantizer search and the stereo and prediction tools. Every element is
+ * searched with its own coder context, so the elements of a frame can be
+ * processed in parallel.
+ */
+static int search_element(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    AACEncContext *s  = avctx->priv_data;
+    AACEncContext *ec = s->elements ? &s->elements[jobnr] : s;
+    ChannelElement *cpe = &s->cpe[jobnr];
+    FFPsyWindowInfo *wi = arg;
+    SingleChannelElement *sce;
+    int i, ch, w, chans, tag, start_ch = 0;
+
+    for (i = 0; i < jobnr; i++)
+        start_ch += s->chan_map[i+1] == TYPE_CPE ? 2 : 1;
+    wi      += start_ch;
+    tag      = s->chan_map[jobnr+1];
+    chans    = tag == TYPE_CPE ? 2 : 1;
+
+    ec->tns_mode = ec->is_mode = ec->pred_mode = 0;
+    ec->cur_type = tag;
+    for (ch = 0; ch < chans; ch++) {
+        ec->cur_channel = start_ch + ch;
+        if (ec->options.pns && ec->coder->mark_pns)
+            ec->coder->mark_pns(ec, avctx, &cpe->ch[ch]);
+        ec->coder->search_for_quantizers(avctx, ec, &cpe->ch[ch], ec->lambda);
+    }
+    if (chans > 1
+        && wi[0].window_type[0] == wi[1].window_type[0]
+        && wi[0].window_shape   == wi[1].window_shape) {
+
+        cpe->common_window = 1;
+        for (w = 0; w < wi[0].num_windows; w++) {
+            if (wi[0].grouping[w] != wi[1].grouping[w]) {
+                cpe->common_window = 0;
+                break;
+            }
+        }
+    }
+    for (ch = 0; ch < chans; ch++) { /* TNS and PNS */
+        sce = &cpe->ch[ch];
+        ec->cur_channel = start_ch + ch;
+        if (ec->options.tns && ec->coder->search_for_tns)
+            ec->coder->search_for_tns(ec, sce);
+        if (ec->options.tns && ec->coder->apply_tns_filt)
+            ec->coder->apply_tns_filt(ec, sce);
+        if (sce->tns.present)
+            ec->tns_mode = 1;
+        if (ec->options.pns && ec->coder->search_for_pns)
+            ec->coder->search_for_pns(ec, avctx, sce);
+    }
+    ec->cur_channel = start_ch;
+    if (ec->options.intensity_stereo) { /* Intensity Stereo */
+        if (ec->coder->search_for_is)
+            ec->coder->search_for_is(ec, avctx, cpe);
+        if (cpe->is_mode) ec->is_mode = 1;
+        apply_intensity_stereo(cpe);
+    }
+    if (ec->options.pred) { /* Prediction */
+        for (ch = 0; ch < chans; ch++) {
+            sce = &cpe->ch[ch];
+            ec->cur_channel = start_ch + ch;
+            if (ec->options.pred && ec->coder->search_for_pred)
+                ec->coder->search_for_pred(ec, sce);
+            if (cpe->ch[ch].ics.predictor_present) ec->pred_mode = 1;
+        }
+        if (ec->coder->adjust_common_pred)
+            ec->coder->adjust_common_pred(ec, cpe);
+        for (ch = 0; ch < chans; ch++) {
+            sce = &cpe->ch[ch];
+            ec->cur_channel = start_ch + ch;
+            if (ec->options.pred && ec->coder->apply_main_pred)
+                ec->coder->apply_main_pred(ec, sce);
+        }
+        ec->cur_channel = start_ch;
+    }
+    if (ec->options.mid_side) { /* Mid/Side stereo */
+        if (ec->options.mid_side == -1 && ec->coder->search_for_ms)
+            ec->coder->search_for_ms(ec, cpe);
+        else if (cpe->common_window)
+            memset(cpe->ms_mask, 1, sizeof(cpe->ms_mask));
+        apply_mid_side_stereo(cpe);
+    }
+    adjust_frame_information(cpe, chans);
+    if (ec->options.ltp) { /* LTP */
+        for (ch = 0; ch < chans; ch++) {
+            sce = &cpe->ch[ch];
+            ec->cur_channel = start_ch + ch;
+            if (ec->coder->search_for_ltp)
+                ec->coder->search_for_ltp(ec, sce, cpe->common_window);
+            if (sce->ics.ltp.present) ec->pred_mode = 1;
+        }
+        ec->cur_channel = start_ch;
+        if (ec->coder->adjust_common_ltp)
+            ec->coder->adjust_common_ltp(ec, cpe);
+    }
+
+    return 0;
+}
+
 static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                             const AVFrame *frame, int *got_packet_ptr)
 {
@@ -679,14 +781,10 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
         return ret;
     frame_bits = its = 0;
     do {
-        init_put_bits(&s->pb, avpkt->data, avpkt->size);
-
-        if ((avctx->frame_number & 0xFF)==1 && !(avctx->flags & AV_CODEC_FLAG_BITEXACT))
-            put_bitstream_info(s, LIBAVCODEC_IDENT);
         start_ch = 0;
         target_bits = 0;
-        memset(chan_el_counter, 0, sizeof(chan_el_counter));
         for (i = 0; i < s->chan_map[0]; i++) {
+            AACEncContext *ec = s->elements ? &s->elements[i] : s;
             FFPsyWindowInfo* wi = windows + start_ch;
             const float *coeffs[2];
             tag      = s->chan_map[i+1];
@@ -695,8 +793,6 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
             cpe->common_window = 0;
             memset(cpe->is_mask, 0, sizeof(cpe->is_mask));
             memset(cpe->ms_mask, 0, sizeof(cpe->ms_mask));
-            put_bits(&s->pb, 3, tag);
-            put_bits(&s->pb, 4, chan_el_counter[tag]++);
             for (ch = 0; ch < chans; ch++) {
                 sce = &cpe->ch[ch];
                 coeffs[ch] = sce->coeffs;
@@ -709,6 +805,9 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                     if (sce->band_type[w] > RESERVED_BT)
                         sce->band_type[w] = 0;
             }
+            /* the psy model keeps state across channels, so it runs in order,
+             * with the bandwidth the twoloop coder last chose for the element */
+            s->psy.cutoff = ec->psy.cutoff;
             s->psy.bitres.alloc = -1;
             s->psy.bitres.bits = s->last_frame_pb_count / s->channels;
             s->psy.model->analyze(&s->psy, start_ch, coeffs, wi);
@@ -718,82 +817,29 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                     * (s->lambda / (avctx->global_quality ? avctx->global_quality : 120));
                 s->psy.bitres.alloc /= chans;
             }
-            s->cur_type = tag;
-            for (ch = 0; ch < chans; ch++) {
-                s->cur_channel = start_ch + ch;
-                if (s->options.pns && s->coder->mark_pns)
-                    s->coder->mark_pns(s, avctx, &cpe->ch[ch]);
-                s->coder->search_for_quantizers(avctx, s, &cpe->ch[ch], s->lambda);
-            }
-            if (chans > 1
-                && wi[0].window_type[0] == wi[1].window_type[0]
-                && wi[0].window_shape   == wi[1].window_shape) {
-
-                cpe->common_window = 1;
-                for (w = 0; w < wi[0].num_windows; w++) {
-                    if (wi[0].grouping[w] != wi[1].grouping[w]) {
-                        cpe->common_window = 0;
-                        break;
-                    }
-                }
-            }
-            for (ch = 0; ch < chans; ch++) { /* TNS and PNS */
-                sce = &cpe->ch[ch];
-                s->cur_channel = start_ch + ch;
-                if (s->options.tns && s->coder->search_for_tns)
-                    s->coder->search_for_tns(s, sce);
-                if (s->options.tns && s->coder->apply_tns_filt)
-                    s->coder->apply_tns_filt(s, sce);
-                if (sce->tns.present)
-                    tns_mode = 1;
-                if (s->options.pns && s->coder->search_for_pns)
-                    s->coder->search_for_pns(s, avctx, sce);
-            }
-            s->cur_channel = start_ch;
-            if (s->options.intensity_stereo) { /* Intensity Stereo */
-                if (s->coder->search_for_is)
-                    s->coder->search_for_is(s, avctx, cpe);
-                if (cpe->is_mode) is_mode = 1;
-                apply_intensity_stereo(cpe);
-            }
-            if (s->options.pred) { /* Prediction */
-                for (ch = 0; ch < chans; ch++) {
-                    sce = &cpe->ch[ch];
-                    s->cur_channel = start_ch + ch;
-                    if (s->options.pred && s->coder->search_for_pred)
-                        s->coder->search_for_pred(s, sce);
-                    if (cpe->ch[ch].ics.predictor_present) pred_mode = 1;
-                }
-                if (s->coder->adjust_common_pred)
-                    s->coder->adjust_common_pred(s, cpe);
-                for (ch = 0; ch < chans; ch++) {
-                    sce = &cpe->ch[ch];
-                    s->cur_channel = start_ch + ch;
-                    if (s->options.pred && s->coder->apply_main_pred)
-                        s->coder->apply_main_pred(s, sce);
-                }
-                s->cur_channel = start_ch;
-            }
-            if (s->options.mid_side) { /* Mid/Side stereo */
-                if (s->options.mid_side == -1 && s->coder->search_for_ms)
-                    s->coder->search_for_ms(s, cpe);
-                else if (cpe->common_window)
-                    memset(cpe->ms_mask, 1, sizeof(cpe->ms_mask));
-                apply_mid_side_stereo(cpe);
-            }
-            adjust_frame_information(cpe, chans);
-            if (s->options.ltp) { /* LTP */
-                for (ch = 0; ch < chans; ch++) {
-                    sce = &cpe->ch[ch];
-                    s->cur_channel = start_ch + ch;
-                    if (s->coder->search_for_ltp)
-                        s->coder->search_for_ltp(s, sce, cpe->common_window);
-                    if (sce->ics.ltp.present) pred_mode = 1;
-                }
-                s->cur_channel = start_ch;
-                if (s->coder->adjust_common_ltp)
-                    s->coder->adjust_common_ltp(s, cpe);
-            }
+            ec->psy.bitres = s->psy.bitres;
+            ec->lambda     = s->lambda;
+            start_ch += chans;
+        }
+
+        avctx->execute2(avctx, search_element, windows, NULL, s->chan_map[0]);
+
+        init_put_bits(&s->pb, avpkt->data, avpkt->size);
+
+        if ((avctx->frame_number & 0xFF)==1 && !(avctx->flags & AV_CODEC_FLAG_BITEXACT))
+            put_bitstream_info(s, LIBAVCODEC_IDENT);
+        start_ch = 0;
+        memset(chan_el_counter, 0, sizeof(chan_el_counter));
+        for (i = 0; i < s->chan_map[0]; i++) {
+            AACEncContext *ec = s->elements ? &s->elements[i] : s;
+            tag      = s->chan_map[i+1];
+            chans    = tag == TYPE_CPE ? 2 : 1;
+            cpe      = &s->cpe[i];
+            tns_mode  |= ec->tns_mode;
+            is_mode   |= ec->is_mode;
+            pred_mode |= ec->pred_mode;
+            put_bits(&s->pb, 3, tag);
+            put_bits(&s->pb, 4, chan_el_counter[tag]++);
             if (chans == 2) {
                 put_bits(&s->pb, 1, cpe->common_window);
                 if (cpe->common_window) {
@@ -896,6 +942,7 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
 static av_cold int aac_encode_end(AVCodecContext *avctx)
 {
     AACEncContext *s = avctx->priv_data;
+    int i;
 
     av_log(avctx, AV_LOG_INFO, "Qavg: %.3f\n", s->lambda_sum / s->lambda_count);
 
@@ -903,6 +950,9 @@ static av_cold int aac_encode_end(AVCodecContext *avctx)
     ff_mdct_end(&s->mdct128);
     ff_psy_end(&s->psy);
     ff_lpc_end(&s->lpc);
+    for (i = 0; s->elements && i < s->chan_map[0]; i++)
+        ff_lpc_end(&s->elements[i].lpc);
+    av_freep(&s->elements);
     if (s->psypp)
         ff_psy_preprocess_end(s->psypp);
     av_freep(&s->buffer.samples);
@@ -944,6 +994,35 @@ static av_cold int alloc_buffers(AVCodecContext *avctx, AACEncContext *s)
     return 0;
 }
 
+/**
+ * Set up one coder context per channel element. The coders keep scratch
+ * buffers and state in the encoder context, so each element gets its own
+ * copy, which lets the elements be searched in parallel. The output does
+ * not depend on the number of threads.
+ */
+static av_cold int init_elements(AVCodecContext *avctx, AACEncContext *s)
+{
+    int i, ret;
+
+    if (!FF_ALLOCZ_TYPED_ARRAY(s->elements, s->chan_map[0]))
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < s->chan_map[0]; i++) {
+        AACEncContext *ec = &s->elements[i];
+
+        memcpy(ec, s, sizeof(*ec));
+        memset(&ec->lpc, 0, sizeof(ec->lpc));
+        ec->elements = NULL;
+        /* do not use the same PNS noise for all elements */
+        ec->random_state = s->random_state + i;
+        if ((ret = ff_lpc_init(&ec->lpc, 2*avctx->frame_size, TNS_MAX_ORDER,
+                               FF_LPC_TYPE_LEVINSON)) < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
 static av_cold int aac_encode_init(AVCodecContext *avctx)
 {
     AACEncContext *s = avctx->priv_data;
@@ -1098,6 +1177,9 @@ static av_cold int aac_encode_init(AVCodecContext *avctx)
     ff_af_queue_init(avctx, &s->afq);
     ff_aac_tableinit();
 
+    if (s->chan_map[0] > 1 && (ret = init_elements(avctx, s)) < 0)
+        return ret;
+
     return 0;
 }
 
@@ -1142,7 +1224,8 @@ AVCodec ff_aac_encoder = {
     .defaults       = aac_encode_defaults,
     .supported_samplerates = mpeg4audio_sample_rates,
     .caps_internal  = FF_CODEC_CAP_INIT_THREADSAFE | FF_CODEC_CAP_INIT_CLEANUP,
-    .capabilities   = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY,
+    .capabilities   = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY |
+                      AV_CODEC_CAP_SLICE_THREADS,
     .sample_fmts    = (const enum AVSampleFormat[]){ AV_SAMPLE_FMT_FLTP,
                                                      AV_SAMPLE_FMT_NONE },
     .priv_class     = &aacenc_class,
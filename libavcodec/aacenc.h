@@ -420,6 +420,11 @@ typedef struct AACEncContext {
     struct {
         float *samples;
     } buffer;
+
+    struct AACEncContext *elements;              ///< per channel element coder contexts, used to search the elements in parallel
+    int tns_mode;                                ///< set if TNS is used by the element
+    int is_mode;                                 ///< set if intensity stereo is used by the element
+    int pred_mode;                               ///< set if prediction or LTP is used by the element
 } AACEncContext;
 
 void ff_aac_dsp_init_x86(AACEncContext *s);
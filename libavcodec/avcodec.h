@@ -2335,6 +2335,28 @@ typedef struct AVCodecContext {
      * - encoding: set by user
      */
     int export_side_data;
+
+    /**
+     * List of CPUs the codec threads are pinned to, e.g. "0-7,16-23".
+     * Thread n is pinned to the n-th CPU of the list. Only the CPU affinity
+     * of the threads is set, buffers are allocated as without it.
+     *
+     * - decoding: set by user
+     * - encoding: set by user
+     */
+    char *thread_affinity;
+
+    /**
+     * If nonzero, slice threading jobs are run on the thread pool shared by
+     * all codec contexts and filtergraphs of the process which set this
+     * option, instead of threads of the context's own. thread_count then
+     * limits how many threads work on the context at once.
+     * Frame threads are not affected.
+     *
+     * - decoding: set by user
+     * - encoding: set by user
+     */
+    int shared_threads;
 } AVCodecContext;
 
 #if FF_API_CODEC_GET_SET
@@ -126,6 +126,16 @@ typedef struct FlacEncodeContext {
 
     int flushed;
     int64_t next_pts;
+
+    /* frame-parallel encoding */
+    struct FlacEncodeContext *jobs; ///< one context per frame of a batch
+    AVPacket **job_pkts;            ///< output packets of the batch, in order
+    int *job_rets;
+    int nb_jobs;
+    int nb_queued;                  ///< frames copied into jobs, not yet encoded
+    int nb_ready;                   ///< encoded packets of the last batch
+    int next_ready;                 ///< next packet to return from job_pkts
+    int64_t job_pts;                ///< pts of the frame held by a job context
 } FlacEncodeContext;
 
 
@@ -236,6 +246,49 @@ static av_cold void dprint_compression_options(FlacEncodeContext *s)
 }
 
 
+/**
+ * Set up the contexts used to encode a batch of frames in parallel.
+ * FLAC frames are independent, only the frame number and the stream
+ * statistics depend on the previous frames, and those are handled
+ * serially, so the output is the same as with a single thread.
+ */
+static av_cold int init_jobs(FlacEncodeContext *s)
+{
+    AVCodecContext *avctx = s->avctx;
+    int i, ret;
+
+    s->nb_jobs  = avctx->thread_count;
+    s->jobs     = av_calloc(s->nb_jobs, sizeof(*s->jobs));
+    s->job_pkts = av_calloc(s->nb_jobs, sizeof(*s->job_pkts));
+    s->job_rets = av_calloc(s->nb_jobs, sizeof(*s->job_rets));
+    if (!s->jobs || !s->job_pkts || !s->job_rets)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < s->nb_jobs; i++) {
+        FlacEncodeContext *job = &s->jobs[i];
+
+        memcpy(job, s, sizeof(*job));
+        memset(&job->lpc_ctx, 0, sizeof(job->lpc_ctx));
+        job->md5ctx      = NULL;
+        job->md5_buffer  = NULL;
+        job->jobs        = NULL;
+        job->job_pkts    = NULL;
+        job->job_rets    = NULL;
+        job->nb_jobs     = 0;
+
+        ret = ff_lpc_init(&job->lpc_ctx, avctx->frame_size,
+                          s->options.max_prediction_order, FF_LPC_TYPE_LEVINSON);
+        if (ret < 0)
+            return ret;
+
+        s->job_pkts[i] = av_packet_alloc();
+        if (!s->job_pkts[i])
+            return AVERROR(ENOMEM);
+    }
+
+    return 0;
+}
+
 static av_cold int flac_encode_init(AVCodecContext *avctx)
 {
     int freq = avctx->sample_rate;
@@ -463,6 +516,10 @@ FF_ENABLE_DEPRECATION_WARNINGS
 
     dprint_compression_options(s);
 
+    if (ret >= 0 && avctx->active_thread_type & FF_THREAD_SLICE &&
+        avctx->thread_count > 1)
+        ret = init_jobs(s);
+
     return ret;
 }
 
@@ -1356,6 +1413,145 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
 }
 
 
+/**
+ * Encode the samples of the current frame, falling back on verbatim mode
+ * if the compressed frame is larger than it would be if encoded
+ * uncompressed.
+ *
+ * @return the size of the encoded frame in bytes or a negative error code
+ */
+static int encode_frame_samples(FlacEncodeContext *s)
+{
+    int frame_bytes;
+
+    channel_decorrelation(s);
+
+    remove_wasted_bits(s);
+
+    frame_bytes = encode_frame(s);
+
+    if (frame_bytes < 0 || frame_bytes > s->max_framesize) {
+        s->frame.verbatim_only = 1;
+        frame_bytes = encode_frame(s);
+        if (frame_bytes < 0)
+            av_log(s->avctx, AV_LOG_ERROR, "Bad frame count\n");
+    }
+
+    return frame_bytes;
+}
+
+static void update_framesize_stats(FlacEncodeContext *s, int out_bytes)
+{
+    if (out_bytes > s->max_encoded_framesize)
+        s->max_encoded_framesize = out_bytes;
+    if (out_bytes < s->min_framesize)
+        s->min_framesize = out_bytes;
+}
+
+static int encode_job(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    FlacEncodeContext *s   = avctx->priv_data;
+    FlacEncodeContext *job = &s->jobs[jobnr];
+    AVPacket *pkt          = s->job_pkts[jobnr];
+    int frame_bytes, ret;
+
+    frame_bytes = encode_frame_samples(job);
+    if (frame_bytes < 0)
+        return frame_bytes;
+
+    if ((ret = av_new_packet(pkt, frame_bytes)) < 0)
+        return ret;
+    pkt->size = write_frame(job, pkt);
+
+    return 0;
+}
+
+/**
+ * Queue the frame in the next job context. Everything that depends on
+ * the previous frames is done here, in stream order.
+ */
+static int queue_frame(FlacEncodeContext *s, const AVFrame *frame)
+{
+    FlacEncodeContext *job = &s->jobs[s->nb_queued++];
+    int ret;
+
+    /* change max_framesize for small final frame */
+    if (frame->nb_samples < s->frame.blocksize) {
+        s->max_framesize = ff_flac_get_max_frame_size(frame->nb_samples,
+                                                      s->channels,
+                                                      s->avctx->bits_per_raw_sample);
+    }
+    s->frame.blocksize = frame->nb_samples;
+
+    job->frame_count   = s->frame_count;
+    job->max_framesize = s->max_framesize;
+    job->job_pts       = frame->pts;
+
+    init_frame(job, frame->nb_samples);
+
+    copy_samples(job, frame->data[0]);
+
+    s->frame_count++;
+    s->sample_count += frame->nb_samples;
+    if ((ret = update_md5_sum(s, frame->data[0])) < 0) {
+        av_log(s->avctx, AV_LOG_ERROR, "Error updating MD5 checksum\n");
+        return ret;
+    }
+
+    return 0;
+}
+
+static int encode_jobs(AVCodecContext *avctx, FlacEncodeContext *s)
+{
+    int i;
+
+    avctx->execute2(avctx, encode_job, NULL, s->job_rets, s->nb_queued);
+
+    for (i = 0; i < s->nb_queued; i++) {
+        AVPacket *pkt = s->job_pkts[i];
+
+        if (s->job_rets[i] < 0)
+            return s->job_rets[i];
+
+        pkt->pts      = s->jobs[i].job_pts;
+        pkt->duration = ff_samples_to_time_base(avctx, s->jobs[i].frame.blocksize);
+        update_framesize_stats(s, pkt->size);
+    }
+
+    s->nb_ready   = s->nb_queued;
+    s->next_ready = 0;
+    s->nb_queued  = 0;
+
+    return 0;
+}
+
+/**
+ * Frames are collected until there is one for each thread, then they are
+ * encoded in parallel and the packets are returned one by one.
+ */
+static int encode_frame_batched(AVCodecContext *avctx, AVPacket *avpkt,
+                                const AVFrame *frame, int *got_packet_ptr)
+{
+    FlacEncodeContext *s = avctx->priv_data;
+    int ret;
+
+    if (frame && (ret = queue_frame(s, frame)) < 0)
+        return ret;
+
+    if (s->next_ready == s->nb_ready &&
+        (s->nb_queued == s->nb_jobs || !frame && s->nb_queued) &&
+        (ret = encode_jobs(avctx, s)) < 0)
+        return ret;
+
+    if (s->next_ready < s->nb_ready) {
+        av_packet_move_ref(avpkt, s->job_pkts[s->next_ready++]);
+        s->next_pts = avpkt->pts + avpkt->duration;
+        *got_packet_ptr = 1;
+    }
+
+    return 0;
+}
+
 static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                              const AVFrame *frame, int *got_packet_ptr)
 {
@@ -1364,6 +1560,12 @@ static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
 
     s = avctx->priv_data;
 
+    if (s->nb_jobs) {
+        ret = encode_frame_batched(avctx, avpkt, frame, got_packet_ptr);
+        if (ret < 0 || *got_packet_ptr || frame)
+            return ret;
+    }
+
     /* when the last block is reached, update the header in extradata */
     if (!frame) {
         s->max_framesize = s->max_encoded_framesize;
@@ -1403,22 +1605,9 @@ FF_ENABLE_DEPRECATION_WARNINGS
 
     copy_samples(s, frame->data[0]);
 
-    channel_decorrelation(s);
-
-    remove_wasted_bits(s);
-
-    frame_bytes = encode_frame(s);
-
-    /* Fall back on verbatim mode if the compressed frame is larger than it
-       would be if encoded uncompressed. */
-    if (frame_bytes < 0 || frame_bytes > s->max_framesize) {
-        s->frame.verbatim_only = 1;
-        frame_bytes = encode_frame(s);
-        if (frame_bytes < 0) {
-            av_log(avctx, AV_LOG_ERROR, "Bad frame count\n");
-            return frame_bytes;
-        }
-    }
+    frame_bytes = encode_frame_samples(s);
+    if (frame_bytes < 0)
+        return frame_bytes;
 
     if ((ret = ff_alloc_packet2(avctx, avpkt, frame_bytes, 0)) < 0)
         return ret;
@@ -1431,10 +1620,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
         av_log(avctx, AV_LOG_ERROR, "Error updating MD5 checksum\n");
         return ret;
     }
-    if (out_bytes > s->max_encoded_framesize)
-        s->max_encoded_framesize = out_bytes;
-    if (out_bytes < s->min_framesize)
-        s->min_framesize = out_bytes;
+    update_framesize_stats(s, out_bytes);
 
     avpkt->pts      = frame->pts;
     avpkt->duration = ff_samples_to_time_base(avctx, frame->nb_samples);
@@ -1449,11 +1635,21 @@ FF_ENABLE_DEPRECATION_WARNINGS
 
 static av_cold int flac_encode_close(AVCodecContext *avctx)
 {
+    int i;
+
     if (avctx->priv_data) {
         FlacEncodeContext *s = avctx->priv_data;
         av_freep(&s->md5ctx);
         av_freep(&s->md5_buffer);
         ff_lpc_end(&s->lpc_ctx);
+        for (i = 0; s->jobs && i < s->nb_jobs; i++) {
+            ff_lpc_end(&s->jobs[i].lpc_ctx);
+            if (s->job_pkts)
+                av_packet_free(&s->job_pkts[i]);
+        }
+        av_freep(&s->jobs);
+        av_freep(&s->job_pkts);
+        av_freep(&s->job_rets);
     }
     av_freep(&avctx->extradata);
     avctx->extradata_size = 0;
@@ -1508,9 +1704,11 @@ AVCodec ff_flac_encoder = {
     .init           = flac_encode_init,
     .encode2        = flac_encode_frame,
     .close          = flac_encode_close,
-    .capabilities   = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY,
+    .capabilities   = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY |
+                      AV_CODEC_CAP_SLICE_THREADS,
     .sample_fmts    = (const enum AVSampleFormat[]){ AV_SAMPLE_FMT_S16,
                                                      AV_SAMPLE_FMT_S32,
                                                      AV_SAMPLE_FMT_NONE },
     .priv_class     = &flac_encoder_class,
+    .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP,
 };
@@ -42,6 +42,14 @@ typedef struct{
     AVPacket *outdata;
     int       return_code;
     int       finished;
+
+    /* GOP-parallel mode: a task is a whole GOP */
+    AVFrame  **gop_frames;
+    AVPacket **gop_pkts;
+    int        nb_frames;
+    int        nb_pkts;
+    int        next_pkt;      ///< next packet to be returned by the main thread
+    int64_t    first_frame;   ///< index of the GOP's first frame in the stream
 } Task;
 
 typedef struct{
@@ -62,8 +70,96 @@ typedef struct{
 
     pthread_t worker[MAX_THREADS];
     atomic_int exit;
+
+    int gop_size;            ///< frames per task in GOP-parallel mode, 0 otherwise
+    unsigned max_gops;       ///< number of GOPs in flight before the main thread waits
+    int64_t nb_gops;         ///< number of GOPs submitted, guarded by task_fifo_mutex
+    int nb_gop_threads;      ///< guarded by task_fifo_mutex
 } ThreadContext;
 
+static int encode_gop(AVCodecContext *avctx, Task *task)
+{
+    int got_packet, ret;
+
+    for (int i = 0; i <= task->nb_frames; i++) {
+        AVFrame *frame = i < task->nb_frames ? task->gop_frames[i] : NULL;
+
+        avctx->frame_number = task->first_frame + i;
+        /* The encoder is flushed at the end of each GOP, which turns the
+         * next one into a new independent sequence. */
+        do {
+            AVPacket *pkt;
+
+            /* There is no packet left once the flushing call returns none. */
+            if (task->nb_pkts > task->nb_frames)
+                return AVERROR_BUG;
+            pkt = task->gop_pkts[task->nb_pkts];
+
+            got_packet = 0;
+            ret = avctx->codec->encode2(avctx, pkt, frame, &got_packet);
+            if (ret < 0) {
+                av_packet_unref(pkt);
+                return ret;
+            }
+            if (got_packet) {
+                ret = av_packet_make_refcounted(pkt);
+                if (ret < 0)
+                    return ret;
+                task->nb_pkts++;
+            } else
+                av_packet_unref(pkt);
+        } while (!frame && got_packet);
+    }
+
+    return 0;
+}
+
+/* Each thread encodes every thread_count-th GOP with its own encoder,
+ * so that the output does not depend on the scheduling. */
+static void * attribute_align_arg gop_worker(void *v){
+    AVCodecContext *avctx = v;
+    ThreadContext *c = avctx->internal->frame_thread_encoder;
+    int64_t gop;
+
+    pthread_mutex_lock(&c->task_fifo_mutex);
+    gop = c->nb_gop_threads++;
+    pthread_mutex_unlock(&c->task_fifo_mutex);
+
+    while (!atomic_load(&c->exit)) {
+        Task *task;
+        int ret;
+
+        pthread_mutex_lock(&c->task_fifo_mutex);
+        while (c->nb_gops <= gop || atomic_load(&c->exit)) {
+            if (atomic_load(&c->exit)) {
+                pthread_mutex_unlock(&c->task_fifo_mutex);
+                goto end;
+            }
+            pthread_cond_wait(&c->task_fifo_cond, &c->task_fifo_mutex);
+        }
+        pthread_mutex_unlock(&c->task_fifo_mutex);
+        task = &c->tasks[gop % c->max_tasks];
+        gop += c->parent_avctx->thread_count;
+
+        ret = encode_gop(avctx, task);
+        pthread_mutex_lock(&c->buffer_mutex);
+        for (int i = 0; i < task->nb_frames; i++)
+            av_frame_unref(task->gop_frames[i]);
+        pthread_mutex_unlock(&c->buffer_mutex);
+        pthread_mutex_lock(&c->finished_task_mutex);
+        task->return_code = ret;
+        task->finished    = 1;
+        pthread_cond_signal(&c->finished_task_cond);
+        pthread_mutex_unlock(&c->finished_task_mutex);
+    }
+end:
+    pthread_mutex_lock(&c->buffer_mutex);
+    avcodec_close(avctx);
+    pthread_mutex_unlock(&c->buffer_mutex);
+    av_freep(&avctx);
+    return NULL;
+}
+
 static void * attribute_align_arg worker(void *v){
     AVCodecContext *avctx = v;
     ThreadContext *c = avctx->internal->frame_thread_encoder;
@@ -124,10 +220,13 @@ end:
 int ff_frame_thread_encoder_init(AVCodecContext *avctx, AVDictionary *options){
     int i=0;
     ThreadContext *c;
+    int64_t gop_lookahead = 0;
 
+    if (avctx->codec->caps_internal & FF_CODEC_CAP_GOP_THREADS)
+        av_opt_get_int(avctx->priv_data, "gop_lookahead", 0, &gop_lookahead);
 
     if(   !(avctx->thread_type & FF_THREAD_FRAME)
-       || !(avctx->codec->capabilities & AV_CODEC_CAP_FRAME_THREADS))
+       || !(avctx->codec->capabilities & AV_CODEC_CAP_FRAME_THREADS || gop_lookahead))
         return 0;
 
     if(   !avctx->thread_count
@@ -180,6 +279,18 @@ int ff_frame_thread_encoder_init(AVCodecContext *avctx, AVDictionary *options){
     if(avctx->thread_count > MAX_THREADS)
         return AVERROR(EINVAL);
 
+    if (gop_lookahead) {
+        if (avctx->flags & (AV_CODEC_FLAG_PASS1 | AV_CODEC_FLAG_PASS2)) {
+            av_log(avctx, AV_LOG_WARNING,
+                   "GOP-parallel encoding does not support two-pass encoding, disabling it\n");
+            return 0;
+        }
+        if (!(avctx->flags & AV_CODEC_FLAG_QSCALE))
+            av_log(avctx, AV_LOG_WARNING,
+                   "Rate control works on each GOP separately with GOP-parallel encoding, "
+                   "consider using a constant quantizer.\n");
+    }
+
     av_assert0(!avctx->internal->frame_thread_encoder);
     c = avctx->internal->frame_thread_encoder = av_mallocz(sizeof(ThreadContext));
     if(!c)
@@ -194,11 +305,23 @@ int ff_frame_thread_encoder_init(AVCodecContext *avctx, AVDictionary *options){
     pthread_cond_init(&c->finished_task_cond, NULL);
     atomic_init(&c->exit, 0);
 
-    c->max_tasks = avctx->thread_count + 2;
+    if (gop_lookahead) {
+        /* Up to two more GOPs than max_gops can be outstanding: the one whose
+         * packets are being returned and the last one, submitted when
+         * flushing. The frames and packets are allocated when needed. */
+        c->gop_size  = FFMAX(avctx->gop_size, 1);
+        c->max_gops  = FFMIN(avctx->thread_count + gop_lookahead, BUFFER_SIZE - 3);
+        c->max_tasks = c->max_gops + 3;
+    } else
+        c->max_tasks = avctx->thread_count + 2;
     for (unsigned i = 0; i < c->max_tasks; i++) {
         if (!(c->tasks[i].indata  = av_frame_alloc()) ||
             !(c->tasks[i].outdata = av_packet_alloc()))
             goto fail;
+        if (c->gop_size &&
+            (!(c->tasks[i].gop_frames = av_calloc(c->gop_size, sizeof(*c->tasks[i].gop_frames))) ||
+             !(c->tasks[i].gop_pkts   = av_calloc(c->gop_size + 1, sizeof(*c->tasks[i].gop_pkts)))))
+            goto fail;
     }
 
     for(i=0; i<avctx->thread_count ; i++){
@@ -234,7 +357,7 @@ int ff_frame_thread_encoder_init(AVCodecContext *avctx, AVDictionary *options){
         av_dict_free(&tmp);
         av_assert0(!thread_avctx->internal->frame_thread_encoder);
         thread_avctx->internal->frame_thread_encoder = c;
-        if(pthread_create(&c->worker[i], NULL, worker, thread_avctx)) {
+        if(pthread_create(&c->worker[i], NULL, c->gop_size ? gop_worker : worker, thread_avctx)) {
             goto fail;
         }
     }
@@ -263,8 +386,18 @@ void ff_frame_thread_encoder_free(AVCodecContext *avctx){
     }
 
     for (unsigned i = 0; i < c->max_tasks; i++) {
-        av_frame_free(&c->tasks[i].indata);
-        av_packet_free(&c->tasks[i].outdata);
+        Task *task = &c->tasks[i];
+
+        av_frame_free(&task->indata);
+        av_packet_free(&task->outdata);
+        for (int j = 0; j <= c->gop_size; j++) {
+            if (task->gop_frames && j < c->gop_size)
+                av_frame_free(&task->gop_frames[j]);
+            if (task->gop_pkts)
+                av_packet_free(&task->gop_pkts[j]);
+        }
+        av_freep(&task->gop_frames);
+        av_freep(&task->gop_pkts);
     }
 
     pthread_mutex_destroy(&c->task_fifo_mutex);
@@ -275,6 +408,77 @@ void ff_frame_thread_encoder_free(AVCodecContext *avctx){
     av_freep(&avctx->internal->frame_thread_encoder);
 }
 
+static void release_gop(ThreadContext *c, Task *task)
+{
+    for (int i = task->next_pkt; i < task->nb_pkts; i++)
+        av_packet_unref(task->gop_pkts[i]);
+    task->finished  = 0;
+    task->nb_frames = task->nb_pkts = task->next_pkt = 0;
+    c->finished_task_index = (c->finished_task_index + 1) % c->max_tasks;
+}
+
+static int gop_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
+                            AVFrame *frame, int *got_packet_ptr)
+{
+    ThreadContext *c = avctx->internal->frame_thread_encoder;
+    Task *task = &c->tasks[c->task_index];
+
+    if (frame) {
+        AVFrame **dst = &task->gop_frames[task->nb_frames];
+
+        if (!*dst && !(*dst = av_frame_alloc()))
+            return AVERROR(ENOMEM);
+        if (!task->nb_frames)
+            task->first_frame = avctx->frame_number;
+        av_frame_move_ref(*dst, frame);
+        task->nb_frames++;
+    }
+
+    if (task->nb_frames == c->gop_size || (!frame && task->nb_frames)) {
+        for (int i = 0; i <= task->nb_frames; i++)
+            if (!task->gop_pkts[i] && !(task->gop_pkts[i] = av_packet_alloc()))
+                return AVERROR(ENOMEM);
+        pthread_mutex_lock(&c->task_fifo_mutex);
+        c->task_index = (c->task_index + 1) % c->max_tasks;
+        av_assert0(c->task_index != c->finished_task_index);
+        c->nb_gops++;
+        pthread_cond_broadcast(&c->task_fifo_cond);
+        pthread_mutex_unlock(&c->task_fifo_mutex);
+    }
+
+    /* Return the packets of the oldest GOP in order, only waiting for it
+     * when enough GOPs are queued or when flushing. */
+    while (c->task_index != c->finished_task_index) {
+        unsigned outstanding = (c->task_index - c->finished_task_index + c->max_tasks) % c->max_tasks;
+        Task *outtask = &c->tasks[c->finished_task_index];
+
+        pthread_mutex_lock(&c->finished_task_mutex);
+        if (!outtask->finished && frame && outstanding <= c->max_gops) {
+            pthread_mutex_unlock(&c->finished_task_mutex);
+            return 0;
+        }
+        while (!outtask->finished)
+            pthread_cond_wait(&c->finished_task_cond, &c->finished_task_mutex);
+        pthread_mutex_unlock(&c->finished_task_mutex);
+
+        if (outtask->return_code < 0) {
+            int ret = outtask->return_code;
+            release_gop(c, outtask);
+            return ret;
+        }
+        if (outtask->next_pkt < outtask->nb_pkts) {
+            av_packet_move_ref(pkt, outtask->gop_pkts[outtask->next_pkt++]);
+            *got_packet_ptr = 1;
+            if (outtask->next_pkt == outtask->nb_pkts)
+                release_gop(c, outtask);
+            return 0;
+        }
+        release_gop(c, outtask);
+    }
+
+    return 0;
+}
+
 int ff_thread_video_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
                                  AVFrame *frame, int *got_packet_ptr)
 {
@@ -283,6 +487,9 @@ int ff_thread_video_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
 
     av_assert1(!*got_packet_ptr);
 
+    if (c->gop_size)
+        return gop_encode_frame(avctx, pkt, frame, got_packet_ptr);
+
     if(frame){
         av_frame_move_ref(c->tasks[c->task_index].indata, frame);
 
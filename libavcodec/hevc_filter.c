@@ -839,9 +839,31 @@ void ff_hevc_deblocking_boundary_strengths(HEVCContext *s, int x0, int y0,
 #undef CB
 #undef CR
 
+static void report_row_progress(HEVCContext *s, int y, int progress)
+{
+    int ctb_height = s->ps.sps->ctb_height;
+    int rows = atomic_load(&s->rows_filtered);
+
+    atomic_store(&s->row_progress[y >> s->ps.sps->log2_ctb_size], progress);
+
+    /* advance past the rows filtered so far, each row is only passed once;
+     * a failed exchange reloads the count advanced by another thread */
+    while (rows < ctb_height && atomic_load(&s->row_progress[rows]) >= 0)
+        if (atomic_compare_exchange_weak(&s->rows_filtered, &rows, rows + 1))
+            rows++;
+
+    if (rows > 0) {
+        int done = atomic_load(&s->row_progress[rows - 1]);
+        if (done > 0)
+            ff_thread_report_progress(&s->ref->tf, done, 0);
+    }
+}
+
 void ff_hevc_hls_filter(HEVCContext *s, int x, int y, int ctb_size)
 {
     int x_end = x >= s->ps.sps->width  - ctb_size;
+    int y_end = y >= s->ps.sps->height - ctb_size;
+    int progress;
     int skip = 0;
     if (s->avctx->skip_loop_filter >= AVDISCARD_ALL ||
         (s->avctx->skip_loop_filter >= AVDISCARD_NONKEY && !IS_IDR(s)) ||
@@ -856,23 +878,20 @@ void ff_hevc_hls_filter(HEVCContext *s, int x, int y, int ctb_size)
     if (!skip)
         deblocking_filter_CTB(s, x, y);
     if (s->ps.sps->sao_enabled && !skip) {
-        int y_end = y >= s->ps.sps->height - ctb_size;
         if (y && x)
             sao_filter_CTB(s, x - ctb_size, y - ctb_size);
         if (x && y_end)
             sao_filter_CTB(s, x - ctb_size, y);
-        if (y && x_end) {
+        if (y && x_end)
             sao_filter_CTB(s, x, y - ctb_size);
-            if (s->threads_type & FF_THREAD_FRAME )
-                ff_thread_report_progress(&s->ref->tf, y, 0);
-        }
-        if (x_end && y_end) {
+        if (x_end && y_end)
             sao_filter_CTB(s, x , y);
-            if (s->threads_type & FF_THREAD_FRAME )
-                ff_thread_report_progress(&s->ref->tf, y + ctb_size, 0);
-        }
-    } else if (s->threads_type & FF_THREAD_FRAME && x_end)
-        ff_thread_report_progress(&s->ref->tf, y + ctb_size - 4, 0);
+        progress = y_end ? y + ctb_size : y;
+    } else
+        progress = y + ctb_size - 4;
+
+    if (s->threads_type & FF_THREAD_FRAME && x_end)
+        report_row_progress(s, y, progress);
 }
 
 void ff_hevc_hls_filters(HEVCContext *s, int x_ctb, int y_ctb, int ctb_size)
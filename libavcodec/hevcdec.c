@@ -72,6 +72,7 @@ static void pic_arrays_free(HEVCContext *s)
     av_freep(&s->qp_y_tab);
     av_freep(&s->tab_slice_address);
     av_freep(&s->filter_slice_edges);
+    av_freep(&s->row_progress);
 
     av_freep(&s->horizontal_bs);
     av_freep(&s->vertical_bs);
@@ -122,6 +123,10 @@ static int pic_arrays_init(HEVCContext *s, const HEVCSPS *sps)
     if (!s->qp_y_tab || !s->filter_slice_edges || !s->tab_slice_address)
         goto fail;
 
+    s->row_progress = av_malloc_array(sps->ctb_height, sizeof(*s->row_progress));
+    if (!s->row_progress)
+        goto fail;
+
     s->horizontal_bs = av_mallocz_array(s->bs_width, s->bs_height);
     s->vertical_bs   = av_mallocz_array(s->bs_width, s->bs_height);
     if (!s->horizontal_bs || !s->vertical_bs)
@@ -916,15 +921,24 @@ static int hls_slice_header(HEVCContext *s)
                 unsigned val = get_bits_long(gb, offset_len);
                 sh->entry_point_offset[i] = val + 1; // +1; // +1 to get the size
             }
-            if (s->threads_number > 1 && (s->ps.pps->num_tile_rows > 1 || s->ps.pps->num_tile_columns > 1)) {
-                s->enable_parallel_tiles = 0; // TODO: you can enable tiles in parallel here
-                s->threads_number = 1;
-            } else
-                s->enable_parallel_tiles = 0;
+            // The loop filters of tiles decoded in parallel are run over the
+            // whole picture afterwards, so this must be its only slice segment.
+            // The boundary strengths of tile edges which are filtered would
+            // depend on the neighbouring tiles, so those are decoded serially.
+            s->enable_parallel_tiles = s->threads_number > 1 &&
+                                       !s->ps.pps->entropy_coding_sync_enabled_flag &&
+                                       !s->ps.pps->loop_filter_across_tiles_enabled_flag &&
+                                       sh->first_slice_in_pic_flag && s->nb_slice_nals == 1 &&
+                                       sh->num_entry_point_offsets + 1 == s->ps.pps->num_tile_rows * s->ps.pps->num_tile_columns;
         } else
             s->enable_parallel_tiles = 0;
     }
 
+    s->parallel_substreams = s->threads_number > 1 && sh->num_entry_point_offsets > 0 &&
+                             (s->enable_parallel_tiles ||
+                              (s->ps.pps->entropy_coding_sync_enabled_flag &&
+                               s->ps.pps->num_tile_rows == 1 && s->ps.pps->num_tile_columns == 1));
+
     if (s->ps.pps->slice_header_extension_present_flag) {
         unsigned int length = get_ue_golomb_long(gb);
         if (length*8LL > get_bits_left(gb)) {
@@ -2562,6 +2576,11 @@ static int hls_decode_entry_wpp(AVCodecContext *avctxt, void *input_ctb_row, int
         if (ret < 0)
             goto error;
         hls_sao_param(s, x_ctb >> s->ps.sps->log2_ctb_size, y_ctb >> s->ps.sps->log2_ctb_size);
+
+        s->deblock[ctb_addr_rs].beta_offset = s->sh.beta_offset;
+        s->deblock[ctb_addr_rs].tc_offset   = s->sh.tc_offset;
+        s->filter_slice_edges[ctb_addr_rs]  = s->sh.slice_loop_filter_across_slices_enabled_flag;
+
         more_data = hls_coding_quadtree(s, x_ctb, y_ctb, s->ps.sps->log2_ctb_size, 0);
 
         if (more_data < 0) {
@@ -2603,6 +2622,78 @@ error:
     return ret;
 }
 
+static int hls_decode_entry_tile(AVCodecContext *avctxt, void *arg, int tile, int self_id)
+{
+    HEVCContext *s1 = avctxt->priv_data;
+    HEVCContext *s  = s1->sList[self_id];
+    HEVCLocalContext *lc = s->HEVClc;
+    const HEVCSPS *sps = s->ps.sps;
+    const HEVCPPS *pps = s->ps.pps;
+    int ctb_addr_ts  = pps->ctb_addr_rs_to_ts[pps->tile_pos_rs[tile]];
+    int ctb_addr_end = tile < s->sh.num_entry_point_offsets ?
+                       pps->ctb_addr_rs_to_ts[pps->tile_pos_rs[tile + 1]] : sps->ctb_size;
+    int ctb_addr_rs  = pps->ctb_addr_ts_to_rs[ctb_addr_ts];
+    int more_data    = 1;
+    int ret;
+
+    if (tile) {
+        ret = init_get_bits8(&lc->gb, s->data + s->sh.offset[tile - 1], s->sh.size[tile - 1]);
+        if (ret < 0)
+            goto error;
+        ff_init_cabac_decoder(&lc->cc, s->data + s->sh.offset[tile - 1], s->sh.size[tile - 1]);
+    }
+
+    while (more_data && ctb_addr_ts < ctb_addr_end) {
+        int x_ctb = (ctb_addr_rs % sps->ctb_width) << sps->log2_ctb_size;
+        int y_ctb = (ctb_addr_rs / sps->ctb_width) << sps->log2_ctb_size;
+
+        hls_decode_neighbour(s, x_ctb, y_ctb, ctb_addr_ts);
+
+        ret = ff_hevc_cabac_init(s, ctb_addr_ts, 0);
+        if (ret < 0)
+            goto error;
+
+        hls_sao_param(s, x_ctb >> sps->log2_ctb_size, y_ctb >> sps->log2_ctb_size);
+
+        s->deblock[ctb_addr_rs].beta_offset = s->sh.beta_offset;
+        s->deblock[ctb_addr_rs].tc_offset   = s->sh.tc_offset;
+        s->filter_slice_edges[ctb_addr_rs]  = s->sh.slice_loop_filter_across_slices_enabled_flag;
+
+        more_data = hls_coding_quadtree(s, x_ctb, y_ctb, sps->log2_ctb_size, 0);
+        if (more_data < 0) {
+            ret = more_data;
+            goto error;
+        }
+
+        ctb_addr_ts++;
+        if (ctb_addr_ts < sps->ctb_size)
+            ctb_addr_rs = pps->ctb_addr_ts_to_rs[ctb_addr_ts];
+    }
+
+    // like hls_decode_entry_wpp(), only the job finishing the picture returns its end
+    return ctb_addr_ts == sps->ctb_size ? ctb_addr_ts : 0;
+error:
+    s->tab_slice_address[ctb_addr_rs] = -1;
+    return ret;
+}
+
+/**
+ * Run the in-loop filters over the whole picture in raster order, once all
+ * of its tiles have been decoded in parallel.
+ */
+static void hls_filter_picture(HEVCContext *s)
+{
+    int ctb_size = 1 << s->ps.sps->log2_ctb_size;
+    int x_ctb, y_ctb;
+
+    for (y_ctb = 0; y_ctb < s->ps.sps->height; y_ctb += ctb_size)
+        for (x_ctb = 0; x_ctb < s->ps.sps->width; x_ctb += ctb_size)
+            ff_hevc_hls_filters(s, x_ctb, y_ctb, ctb_size);
+
+    ff_hevc_hls_filter(s, (s->ps.sps->ctb_width  - 1) << s->ps.sps->log2_ctb_size,
+                          (s->ps.sps->ctb_height - 1) << s->ps.sps->log2_ctb_size, ctb_size);
+}
+
 static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
 {
     const uint8_t *data = nal->data;
@@ -2620,7 +2711,8 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
         return AVERROR(ENOMEM);
     }
 
-    if (s->sh.slice_ctb_addr_rs + s->sh.num_entry_point_offsets * s->ps.sps->ctb_width >= s->ps.sps->ctb_width * s->ps.sps->ctb_height) {
+    if (s->ps.pps->entropy_coding_sync_enabled_flag &&
+        s->sh.slice_ctb_addr_rs + s->sh.num_entry_point_offsets * s->ps.sps->ctb_width >= s->ps.sps->ctb_width * s->ps.sps->ctb_height) {
         av_log(s->avctx, AV_LOG_ERROR, "WPP ctb addresses are wrong (%d %d %d %d)\n",
             s->sh.slice_ctb_addr_rs, s->sh.num_entry_point_offsets,
             s->ps.sps->ctb_width, s->ps.sps->ctb_height
@@ -2696,11 +2788,21 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
         ret[i] = 0;
     }
 
-    if (s->ps.pps->entropy_coding_sync_enabled_flag)
+    if (s->ps.pps->entropy_coding_sync_enabled_flag) {
         s->avctx->execute2(s->avctx, hls_decode_entry_wpp, arg, ret, s->sh.num_entry_point_offsets + 1);
+    } else {
+        // The neighbour availability of a CTB depends on the slice address
+        // of CTBs in other tiles, which may not be decoded yet.
+        for (i = 0; i < s->ps.sps->ctb_size; i++)
+            s->tab_slice_address[i] = s->sh.slice_addr;
+        s->avctx->execute2(s->avctx, hls_decode_entry_tile, arg, ret, s->sh.num_entry_point_offsets + 1);
+    }
 
     for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
         res += ret[i];
+
+    if (s->enable_parallel_tiles && res == s->ps.sps->ctb_size)
+        hls_filter_picture(s);
 error:
     av_free(ret);
     av_free(arg);
@@ -2899,13 +3001,16 @@ static int hevc_frame_start(HEVCContext *s)
     HEVCLocalContext *lc = s->HEVClc;
     int pic_size_in_ctb  = ((s->ps.sps->width  >> s->ps.sps->log2_min_cb_size) + 1) *
                            ((s->ps.sps->height >> s->ps.sps->log2_min_cb_size) + 1);
-    int ret;
+    int i, ret;
 
     memset(s->horizontal_bs, 0, s->bs_width * s->bs_height);
     memset(s->vertical_bs,   0, s->bs_width * s->bs_height);
     memset(s->cbf_luma,      0, s->ps.sps->min_tb_width * s->ps.sps->min_tb_height);
     memset(s->is_pcm,        0, (s->ps.sps->min_pu_width + 1) * (s->ps.sps->min_pu_height + 1));
     memset(s->tab_slice_address, -1, pic_size_in_ctb * sizeof(*s->tab_slice_address));
+    for (i = 0; i < s->ps.sps->ctb_height; i++)
+        atomic_init(&s->row_progress[i], -1);
+    atomic_init(&s->rows_filtered, 0);
 
     s->is_decoded        = 0;
     s->first_nal_type    = s->nal_unit_type;
@@ -3106,7 +3211,7 @@ static int decode_nal_unit(HEVCContext *s, const H2645NAL *nal)
             if (ret < 0)
                 goto fail;
         } else {
-            if (s->threads_number > 1 && s->sh.num_entry_point_offsets > 0)
+            if (s->parallel_substreams)
                 ctb_addr_ts = hls_slice_data_wpp(s, nal);
             else
                 ctb_addr_ts = hls_slice_data(s);
@@ -3160,7 +3265,10 @@ static int decode_nal_units(HEVCContext *s, const uint8_t *buf, int length)
         return ret;
     }
 
+    s->nb_slice_nals = 0;
     for (i = 0; i < s->pkt.nb_nals; i++) {
+        if (s->pkt.nals[i].type <= HEVC_NAL_CRA_NUT)
+            s->nb_slice_nals++;
         if (s->pkt.nals[i].type == HEVC_NAL_EOB_NUT ||
             s->pkt.nals[i].type == HEVC_NAL_EOS_NUT) {
             if (eos_at_start) {
@@ -3554,7 +3662,6 @@ static int hevc_update_thread_context(AVCodecContext *dst,
     s->is_nalff        = s0->is_nalff;
     s->nal_length_size = s0->nal_length_size;
 
-    s->threads_number      = s0->threads_number;
     s->threads_type        = s0->threads_type;
 
     if (s0->eos) {
@@ -3610,7 +3717,12 @@ static av_cold int hevc_decode_init(AVCodecContext *avctx)
 
     if(avctx->active_thread_type & FF_THREAD_SLICE)
         s->threads_number = avctx->thread_count;
-    else
+    else if (avctx->active_thread_type & FF_THREAD_FRAME && s->slice_threads != 1) {
+        ret = ff_slice_thread_init_frame_thread(avctx, s->slice_threads);
+        if (ret < 0)
+            return ret;
+        s->threads_number = ret;
+    } else
         s->threads_number = 1;
 
     if((avctx->active_thread_type & FF_THREAD_FRAME) && avctx->thread_count > 1)
@@ -3657,6 +3769,8 @@ static const AVOption options[] = {
         AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, PAR },
     { "strict-displaywin", "stricly apply default display window size", OFFSET(apply_defdispwin),
         AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, PAR },
+    { "slice_threads", "WPP and tile decoding threads per frame thread (0 for automatic)", OFFSET(slice_threads),
+        AV_OPT_TYPE_INT, {.i64 = 1}, 0, 64, PAR },
     { NULL },
 };
 
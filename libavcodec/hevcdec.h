@@ -543,6 +543,14 @@ typedef struct HEVCContext {
     // CTB-level flags affecting loop filter operation
     uint8_t *filter_slice_edges;
 
+    /**
+     * Frame progress reached once each CTB row is filtered, -1 until then.
+     * WPP rows are filtered out of order, so the progress of a row is only
+     * reported once all rows above it are filtered as well.
+     */
+    atomic_int *row_progress;
+    atomic_int rows_filtered; ///< number of leading rows in row_progress which are filtered
+
     /** used on BE to byteswap the lines for checksumming */
     uint8_t *checksum_buf;
     int      checksum_buf_size;
@@ -555,11 +563,18 @@ typedef struct HEVCContext {
     uint16_t seq_output;
 
     int enable_parallel_tiles;
+    /**
+     * The substreams of the current slice segment are decoded by separate
+     * jobs, each starting at its own entry point
+     */
+    int parallel_substreams;
     atomic_int wpp_err;
 
     const uint8_t *data;
 
     H2645Packet pkt;
+    // number of slice segment NAL units in the current packet
+    int nb_slice_nals;
     // type of the first VCL NAL of the current frame
     enum HEVCNALUnitType first_nal_type;
 
@@ -567,6 +582,7 @@ typedef struct HEVCContext {
     int is_nalff;           ///< this flag is != 0 if bitstream is encapsulated
                             ///< as a format defined in 14496-15
     int apply_defdispwin;
+    int slice_threads;      ///< slice threads per frame thread
 
     int nal_length_size;    ///< Number of bytes used for nal length (1, 2 or 4)
     int nuh_layer_id;
@@ -73,6 +73,14 @@
  * uses ff_thread_report/await_progress().
  */
 #define FF_CODEC_CAP_ALLOCATE_PROGRESS      (1 << 6)
+/**
+ * The encoder can be fed frames again after it has been completely flushed,
+ * and then encodes them as a new independent sequence starting with a closed
+ * GOP, numbered from AVCodecContext.frame_number on. It has a "gop_lookahead"
+ * private option; when it is set, the frame thread encoder hands whole GOPs
+ * to its threads instead of single frames.
+ */
+#define FF_CODEC_CAP_GOP_THREADS            (1 << 7)
 
 /**
  * AVCodec.codec_tags termination value
@@ -139,6 +147,12 @@ typedef struct AVCodecInternal {
 
     void *thread_ctx;
 
+    /**
+     * Slice threading context of a frame thread, for decoders which also
+     * slice thread each frame, see ff_slice_thread_init_frame_thread().
+     */
+    void *slice_thread_ctx;
+
     DecodeSimpleContext ds;
     AVBSFContext *bsf;
 
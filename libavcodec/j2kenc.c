@@ -105,6 +105,20 @@ typedef struct {
    double *layer_rates;
 } Jpeg2000Tile;
 
+/**
+ * A code-block together with the position of its coefficients in the
+ * DWT output of its tile-component, for tier-1 coding.
+ */
+typedef struct {
+    Jpeg2000Component *comp;
+    Jpeg2000Band *band;
+    Jpeg2000Cblk *cblk;
+    int x0, y0;         ///< top left coefficient in comp->i_data
+    int width, height;
+    int bandpos;
+    int lev;
+} Jpeg2000CblkJob;
+
 typedef struct {
     AVClass *class;
     AVCodecContext *avctx;
@@ -129,6 +143,10 @@ typedef struct {
     Jpeg2000QuantStyle  qntsty;
 
     Jpeg2000Tile *tile;
+    Jpeg2000CblkJob *cblk_jobs;
+    int nb_cblk_jobs;
+    Jpeg2000T1Context *t1; ///< one tier-1 context per thread
+    int nb_t1;
     int layer_rates[100];
     uint8_t compression_rate_enc; ///< Is compression done using compression ratio?
 
@@ -502,6 +520,94 @@ static int init_tiles(Jpeg2000EncoderContext *s)
     return 0;
 }
 
+/**
+ * collect the code-blocks of all tiles, so that tier-1 coding can be
+ * distributed over threads independently of the tile layout
+ */
+static int init_cblk_jobs(Jpeg2000EncoderContext *s)
+{
+    int tileno, compno, reslevelno, bandno, pass;
+    Jpeg2000CodingStyle *codsty = &s->codsty;
+
+    /* the first pass counts the code-blocks, the second one fills the jobs */
+    for (pass = 0; pass < 2; pass++) {
+        int nb_jobs = 0;
+
+        for (tileno = 0; tileno < s->numXtiles * s->numYtiles; tileno++){
+            for (compno = 0; compno < s->ncomponents; compno++){
+                Jpeg2000Component *comp = s->tile[tileno].comp + compno;
+
+                for (reslevelno = 0; reslevelno < codsty->nreslevels; reslevelno++){
+                    Jpeg2000ResLevel *reslevel = comp->reslevel + reslevelno;
+
+                    for (bandno = 0; bandno < reslevel->nbands ; bandno++){
+                        Jpeg2000Band *band = reslevel->band + bandno;
+                        Jpeg2000Prec *prec = band->prec; // we support only 1 precinct per band ATM in the encoder
+                        int cblkx, cblky, cblkno=0, xx0, x0, xx1, y0, yy0, yy1, bandpos;
+
+                        if (band->coord[0][0] == band->coord[0][1] || band->coord[1][0] == band->coord[1][1])
+                            continue;
+
+                        if (!pass) {
+                            nb_jobs += prec->nb_codeblocks_width * prec->nb_codeblocks_height;
+                            continue;
+                        }
+
+                        yy0 = bandno == 0 ? 0 : comp->reslevel[reslevelno-1].coord[1][1] - comp->reslevel[reslevelno-1].coord[1][0];
+                        y0 = yy0;
+                        yy1 = FFMIN(ff_jpeg2000_ceildivpow2(band->coord[1][0] + 1, band->log2_cblk_height) << band->log2_cblk_height,
+                                    band->coord[1][1]) - band->coord[1][0] + yy0;
+                        bandpos = bandno + (reslevelno > 0);
+
+                        for (cblky = 0; cblky < prec->nb_codeblocks_height; cblky++){
+                            if (reslevelno == 0 || bandno == 1)
+                                xx0 = 0;
+                            else
+                                xx0 = comp->reslevel[reslevelno-1].coord[0][1] - comp->reslevel[reslevelno-1].coord[0][0];
+                            x0 = xx0;
+                            xx1 = FFMIN(ff_jpeg2000_ceildivpow2(band->coord[0][0] + 1, band->log2_cblk_width) << band->log2_cblk_width,
+                                        band->coord[0][1]) - band->coord[0][0] + xx0;
+
+                            for (cblkx = 0; cblkx < prec->nb_codeblocks_width; cblkx++, cblkno++){
+                                Jpeg2000CblkJob *job = s->cblk_jobs + nb_jobs++;
+                                Jpeg2000Cblk *cblk   = prec->cblk + cblkno;
+
+                                cblk->data   = av_malloc(1 + 8192);
+                                cblk->passes = av_malloc_array(JPEG2000_MAX_PASSES, sizeof(*cblk->passes));
+                                if (!cblk->data || !cblk->passes)
+                                    return AVERROR(ENOMEM);
+
+                                job->comp    = comp;
+                                job->band    = band;
+                                job->cblk    = cblk;
+                                job->x0      = xx0;
+                                job->y0      = yy0;
+                                job->width   = xx1 - xx0;
+                                job->height  = yy1 - yy0;
+                                job->bandpos = bandpos;
+                                job->lev     = codsty->nreslevels - reslevelno - 1;
+
+                                xx0 = xx1;
+                                xx1 = FFMIN(xx1 + (1 << band->log2_cblk_width), band->coord[0][1] - band->coord[0][0] + x0);
+                            }
+                            yy0 = yy1;
+                            yy1 = FFMIN(yy1 + (1 << band->log2_cblk_height), band->coord[1][1] - band->coord[1][0] + y0);
+                        }
+                    }
+                }
+            }
+        }
+
+        if (!pass) {
+            s->cblk_jobs = av_mallocz_array(nb_jobs, sizeof(*s->cblk_jobs));
+            if (!s->cblk_jobs)
+                return AVERROR(ENOMEM);
+        }
+        s->nb_cblk_jobs = nb_jobs;
+    }
+    return 0;
+}
+
 #define COPY_FRAME(D, PIXEL)                                                                                                \
     static void copy_frame_ ##D(Jpeg2000EncoderContext *s)                                                                  \
     {                                                                                                                       \
@@ -699,7 +805,7 @@ static void encode_clnpass(Jpeg2000T1Context *t1, int width, int height, int ban
         }
 }
 
-static void encode_cblk(Jpeg2000EncoderContext *s, Jpeg2000T1Context *t1, Jpeg2000Cblk *cblk, Jpeg2000Tile *tile,
+static void encode_cblk(Jpeg2000EncoderContext *s, Jpeg2000T1Context *t1, Jpeg2000Cblk *cblk,
                         int width, int height, int bandpos, int lev)
 {
     int pass_t = 2, passno, x, y, max=0, nmsedec, bpno;
@@ -1399,84 +1505,81 @@ static void truncpasses(Jpeg2000EncoderContext *s, Jpeg2000Tile *tile)
     }
 }
 
-static int encode_tile(Jpeg2000EncoderContext *s, Jpeg2000Tile *tile, int tileno)
+static int dwt_job(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
 {
-    int compno, reslevelno, bandno, ret;
-    Jpeg2000T1Context t1;
-    Jpeg2000CodingStyle *codsty = &s->codsty;
-    for (compno = 0; compno < s->ncomponents; compno++){
-        Jpeg2000Component *comp = s->tile[tileno].comp + compno;
-
-        t1.stride = (1<<codsty->log2_cblk_width) + 2;
-
-        av_log(s->avctx, AV_LOG_DEBUG,"dwt\n");
-        if ((ret = ff_dwt_encode(&comp->dwt, comp->i_data)) < 0)
-            return ret;
-        av_log(s->avctx, AV_LOG_DEBUG,"after dwt -> tier1\n");
-
-        for (reslevelno = 0; reslevelno < codsty->nreslevels; reslevelno++){
-            Jpeg2000ResLevel *reslevel = comp->reslevel + reslevelno;
-
-            for (bandno = 0; bandno < reslevel->nbands ; bandno++){
-                Jpeg2000Band *band = reslevel->band + bandno;
-                Jpeg2000Prec *prec = band->prec; // we support only 1 precinct per band ATM in the encoder
-                int cblkx, cblky, cblkno=0, xx0, x0, xx1, y0, yy0, yy1, bandpos;
-                yy0 = bandno == 0 ? 0 : comp->reslevel[reslevelno-1].coord[1][1] - comp->reslevel[reslevelno-1].coord[1][0];
-                y0 = yy0;
-                yy1 = FFMIN(ff_jpeg2000_ceildivpow2(band->coord[1][0] + 1, band->log2_cblk_height) << band->log2_cblk_height,
-                            band->coord[1][1]) - band->coord[1][0] + yy0;
+    Jpeg2000EncoderContext *s = avctx->priv_data;
+    Jpeg2000Component *comp = s->tile[jobnr / s->ncomponents].comp + jobnr % s->ncomponents;
 
-                if (band->coord[0][0] == band->coord[0][1] || band->coord[1][0] == band->coord[1][1])
-                    continue;
+    return ff_dwt_encode(&comp->dwt, comp->i_data);
+}
 
-                bandpos = bandno + (reslevelno > 0);
-
-                for (cblky = 0; cblky < prec->nb_codeblocks_height; cblky++){
-                    if (reslevelno == 0 || bandno == 1)
-                        xx0 = 0;
-                    else
-                        xx0 = comp->reslevel[reslevelno-1].coord[0][1] - comp->reslevel[reslevelno-1].coord[0][0];
-                    x0 = xx0;
-                    xx1 = FFMIN(ff_jpeg2000_ceildivpow2(band->coord[0][0] + 1, band->log2_cblk_width) << band->log2_cblk_width,
-                                band->coord[0][1]) - band->coord[0][0] + xx0;
-
-                    for (cblkx = 0; cblkx < prec->nb_codeblocks_width; cblkx++, cblkno++){
-                        int y, x;
-                        if (codsty->transform == FF_DWT53){
-                            for (y = yy0; y < yy1; y++){
-                                int *ptr = t1.data + (y-yy0)*t1.stride;
-                                for (x = xx0; x < xx1; x++){
-                                    *ptr++ = comp->i_data[(comp->coord[0][1] - comp->coord[0][0]) * y + x] * (1 << NMSEDEC_FRACBITS);
-                                }
-                            }
-                        } else{
-                            for (y = yy0; y < yy1; y++){
-                                int *ptr = t1.data + (y-yy0)*t1.stride;
-                                for (x = xx0; x < xx1; x++){
-                                    *ptr = (comp->i_data[(comp->coord[0][1] - comp->coord[0][0]) * y + x]);
-                                    *ptr = (int64_t)*ptr * (int64_t)(16384 * 65536 / band->i_stepsize) >> 15 - NMSEDEC_FRACBITS;
-                                    ptr++;
-                                }
-                            }
-                        }
-                        if (!prec->cblk[cblkno].data)
-                            prec->cblk[cblkno].data = av_malloc(1 + 8192);
-                        if (!prec->cblk[cblkno].passes)
-                            prec->cblk[cblkno].passes = av_malloc_array(JPEG2000_MAX_PASSES, sizeof (*prec->cblk[cblkno].passes));
-                        if (!prec->cblk[cblkno].data || !prec->cblk[cblkno].passes)
-                            return AVERROR(ENOMEM);
-                        encode_cblk(s, &t1, prec->cblk + cblkno, tile, xx1 - xx0, yy1 - yy0,
-                                    bandpos, codsty->nreslevels - reslevelno - 1);
-                        xx0 = xx1;
-                        xx1 = FFMIN(xx1 + (1 << band->log2_cblk_width), band->coord[0][1] - band->coord[0][0] + x0);
-                    }
-                    yy0 = yy1;
-                    yy1 = FFMIN(yy1 + (1 << band->log2_cblk_height), band->coord[1][1] - band->coord[1][0] + y0);
+static int tier1_job(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    Jpeg2000EncoderContext *s = avctx->priv_data;
+    Jpeg2000CodingStyle *codsty = &s->codsty;
+    Jpeg2000T1Context *t1 = s->t1 + threadnr;
+    int nb_jobs = *(int *)arg;
+    int start   = (int64_t) jobnr      * s->nb_cblk_jobs / nb_jobs;
+    int end     = (int64_t)(jobnr + 1) * s->nb_cblk_jobs / nb_jobs;
+    int i, x, y;
+
+    t1->stride = (1<<codsty->log2_cblk_width) + 2;
+
+    for (i = start; i < end; i++) {
+        Jpeg2000CblkJob *job = s->cblk_jobs + i;
+        Jpeg2000Component *comp = job->comp;
+        int w = comp->coord[0][1] - comp->coord[0][0];
+
+        if (codsty->transform == FF_DWT53){
+            for (y = 0; y < job->height; y++){
+                int *ptr = t1->data + y*t1->stride;
+                int *src = comp->i_data + w * (job->y0 + y) + job->x0;
+                for (x = 0; x < job->width; x++)
+                    *ptr++ = src[x] * (1 << NMSEDEC_FRACBITS);
+            }
+        } else{
+            for (y = 0; y < job->height; y++){
+                int *ptr = t1->data + y*t1->stride;
+                int *src = comp->i_data + w * (job->y0 + y) + job->x0;
+                for (x = 0; x < job->width; x++){
+                    *ptr = src[x];
+                    *ptr = (int64_t)*ptr * (int64_t)(16384 * 65536 / job->band->i_stepsize) >> 15 - NMSEDEC_FRACBITS;
+                    ptr++;
                 }
             }
         }
-        av_log(s->avctx, AV_LOG_DEBUG, "after tier1\n");
+        encode_cblk(s, t1, job->cblk, job->width, job->height,
+                    job->bandpos, job->lev);
     }
+    return 0;
+}
+
+/**
+ * Run the DWT and tier-1 coding of all tiles. Every tile-component and
+ * code-block is coded independently into its own buffers, so the result
+ * does not depend on the number of threads.
+ */
+static int encode_tiles_tier1(Jpeg2000EncoderContext *s)
+{
+    AVCodecContext *avctx = s->avctx;
+    int nb_comps = s->numXtiles * s->numYtiles * s->ncomponents;
+    int nb_jobs  = FFMIN(s->nb_cblk_jobs, s->nb_t1 * 16);
+    int ret;
+
+    av_log(s->avctx, AV_LOG_DEBUG, "dwt\n");
+    if ((ret = avctx->execute2(avctx, dwt_job, NULL, NULL, nb_comps)) < 0)
+        return ret;
+    av_log(s->avctx, AV_LOG_DEBUG, "after dwt -> tier1\n");
+
+    if (nb_jobs > 0 && (ret = avctx->execute2(avctx, tier1_job, &nb_jobs, NULL, nb_jobs)) < 0)
+        return ret;
+    av_log(s->avctx, AV_LOG_DEBUG, "after tier1\n");
+    return 0;
+}
+
+static int encode_tile(Jpeg2000EncoderContext *s, Jpeg2000Tile *tile, int tileno)
+{
+    int ret;
 
     av_log(s->avctx, AV_LOG_DEBUG, "rate control\n");
     if (s->compression_rate_enc)
@@ -1495,6 +1598,8 @@ static void cleanup(Jpeg2000EncoderContext *s)
     int tileno, compno;
     Jpeg2000CodingStyle *codsty = &s->codsty;
 
+    av_freep(&s->cblk_jobs);
+    av_freep(&s->t1);
     if (!s->tile)
         return;
     for (tileno = 0; tileno < s->numXtiles * s->numYtiles; tileno++){
@@ -1550,6 +1655,9 @@ static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
 
     reinit(s);
 
+    if ((ret = encode_tiles_tier1(s)) < 0)
+        return ret;
+
     if (s->format == CODEC_JP2) {
         av_assert0(s->buf == pkt->data);
 
@@ -1793,6 +1901,13 @@ FF_ENABLE_DEPRECATION_WARNINGS
     init_quantization(s);
     if ((ret=init_tiles(s)) < 0)
         return ret;
+    if ((ret = init_cblk_jobs(s)) < 0)
+        return ret;
+
+    s->nb_t1 = FFMAX(avctx->thread_count, 1);
+    s->t1 = av_malloc_array(s->nb_t1, sizeof(*s->t1));
+    if (!s->t1)
+        return AVERROR(ENOMEM);
 
     av_log(s->avctx, AV_LOG_DEBUG, "after init\n");
 
@@ -1848,6 +1963,7 @@ AVCodec ff_jpeg2000_encoder = {
     .init           = j2kenc_init,
     .encode2        = encode_frame,
     .close          = j2kenc_destroy,
+    .capabilities   = AV_CODEC_CAP_SLICE_THREADS,
     .pix_fmts       = (const enum AVPixelFormat[]) {
         AV_PIX_FMT_RGB24, AV_PIX_FMT_YUV444P, AV_PIX_FMT_GRAY8,
         AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV422P,
@@ -30,6 +30,8 @@
  * MJPEG decoder.
  */
 
+#include <stdatomic.h>
+
 #include "libavutil/imgutils.h"
 #include "libavutil/avassert.h"
 #include "libavutil/opt.h"
@@ -776,10 +778,11 @@ int ff_mjpeg_decode_sof(MJpegDecodeContext *s)
     return 0;
 }
 
-static inline int mjpeg_decode_dc(MJpegDecodeContext *s, int dc_index)
+static inline int mjpeg_decode_dc(MJpegDecodeContext *s, GetBitContext *gb,
+                                  int dc_index)
 {
     int code;
-    code = get_vlc2(&s->gb, s->vlcs[0][dc_index].table, 9, 2);
+    code = get_vlc2(gb, s->vlcs[0][dc_index].table, 9, 2);
     if (code < 0 || code > 16) {
         av_log(s->avctx, AV_LOG_WARNING,
                "mjpeg_decode_dc: bad vlc: %d:%d (%p)\n",
@@ -788,47 +791,48 @@ static inline int mjpeg_decode_dc(MJpegDecodeContext *s, int dc_index)
     }
 
     if (code)
-        return get_xbits(&s->gb, code);
+        return get_xbits(gb, code);
     else
         return 0;
 }
 
 /* decode block and dequantize */
-static int decode_block(MJpegDecodeContext *s, int16_t *block, int component,
+static int decode_block(MJpegDecodeContext *s, GetBitContext *gb, int *last_dc,
+                        int16_t *block, int component,
                         int dc_index, int ac_index, uint16_t *quant_matrix)
 {
     int code, i, j, level, val;
 
     /* DC coef */
-    val = mjpeg_decode_dc(s, dc_index);
+    val = mjpeg_decode_dc(s, gb, dc_index);
     if (val == 0xfffff) {
         av_log(s->avctx, AV_LOG_ERROR, "error dc\n");
         return AVERROR_INVALIDDATA;
     }
-    val = val * (unsigned)quant_matrix[0] + s->last_dc[component];
+    val = val * (unsigned)quant_matrix[0] + last_dc[component];
     val = av_clip_int16(val);
-    s->last_dc[component] = val;
+    last_dc[component] = val;
     block[0] = val;
     /* AC coefs */
     i = 0;
-    {OPEN_READER(re, &s->gb);
+    {OPEN_READER(re, gb);
     do {
-        UPDATE_CACHE(re, &s->gb);
-        GET_VLC(code, re, &s->gb, s->vlcs[1][ac_index].table, 9, 2);
+        UPDATE_CACHE(re, gb);
+        GET_VLC(code, re, gb, s->vlcs[1][ac_index].table, 9, 2);
 
         i += ((unsigned)code) >> 4;
             code &= 0xf;
         if (code) {
             if (code > MIN_CACHE_BITS - 16)
-                UPDATE_CACHE(re, &s->gb);
+                UPDATE_CACHE(re, gb);
 
             {
-                int cache = GET_CACHE(re, &s->gb);
+                int cache = GET_CACHE(re, gb);
                 int sign  = (~cache) >> 31;
                 level     = (NEG_USR32(sign ^ cache,code) ^ sign) - sign;
             }
 
-            LAST_SKIP_BITS(re, &s->gb, code);
+            LAST_SKIP_BITS(re, gb, code);
 
             if (i > 63) {
                 av_log(s->avctx, AV_LOG_ERROR, "error count: %d\n", i);
@@ -838,7 +842,7 @@ static int decode_block(MJpegDecodeContext *s, int16_t *block, int component,
             block[j] = level * quant_matrix[i];
         }
     } while (i < 63);
-    CLOSE_READER(re, &s->gb);}
+    CLOSE_READER(re, gb);}
 
     return 0;
 }
@@ -849,7 +853,7 @@ static int decode_dc_progressive(MJpegDecodeContext *s, int16_t *block,
 {
     unsigned val;
     s->bdsp.clear_block(block);
-    val = mjpeg_decode_dc(s, dc_index);
+    val = mjpeg_decode_dc(s, &s->gb, dc_index);
     if (val == 0xfffff) {
         av_log(s->avctx, AV_LOG_ERROR, "error dc\n");
         return AVERROR_INVALIDDATA;
@@ -1139,7 +1143,7 @@ static int ljpeg_decode_rgb_scan(MJpegDecodeContext *s, int nb_components, int p
                 topleft[i] = top[i];
                 top[i]     = buffer[mb_x][i];
 
-                dc = mjpeg_decode_dc(s, s->dc_index[i]);
+                dc = mjpeg_decode_dc(s, &s->gb, s->dc_index[i]);
                 if(dc == 0xFFFFF)
                     return -1;
 
@@ -1271,7 +1275,7 @@ static int ljpeg_decode_yuv_scan(MJpegDecodeContext *s, int predictor,
                     for(j=0; j<n; j++) {
                         int pred, dc;
 
-                        dc = mjpeg_decode_dc(s, s->dc_index[i]);
+                        dc = mjpeg_decode_dc(s, &s->gb, s->dc_index[i]);
                         if(dc == 0xFFFFF)
                             return -1;
                         if (   h * mb_x + x >= s->width
@@ -1342,7 +1346,7 @@ static int ljpeg_decode_yuv_scan(MJpegDecodeContext *s, int predictor,
                     for (j = 0; j < n; j++) {
                         int pred;
 
-                        dc = mjpeg_decode_dc(s, s->dc_index[i]);
+                        dc = mjpeg_decode_dc(s, &s->gb, s->dc_index[i]);
                         if(dc == 0xFFFFF)
                             return -1;
                         if (   h * mb_x + x >= s->width
@@ -1487,7 +1491,7 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
 
                         } else {
                             s->bdsp.clear_block(s->block);
-                            if (decode_block(s, s->block, i,
+                            if (decode_block(s, &s->gb, s->last_dc, s->block, i,
                                              s->dc_index[i], s->ac_index[i],
                                              s->quant_matrixes[s->quant_sindex[i]]) < 0) {
                                 av_log(s->avctx, AV_LOG_ERROR,
@@ -1532,6 +1536,142 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
     return 0;
 }
 
+/* A baseline scan whose restart intervals are decoded by slice threads. */
+typedef struct MJpegRstScan {
+    const uint8_t *start;       ///< scan data of the first restart interval
+    int nb_components;
+    int nb_intervals;
+    int nb_jobs;
+    int chroma_width, chroma_height;
+    int end_bits;               ///< position in buffer after the last interval
+    atomic_int error;
+} MJpegRstScan;
+
+static int decode_rst_intervals(AVCodecContext *avctx, void *arg,
+                                int jobnr, int threadnr)
+{
+    MJpegDecodeContext *s = avctx->priv_data;
+    MJpegRstScan *scan = arg;
+    const uint8_t *buf_end = s->gb.buffer_end;
+    int first = (int64_t)jobnr      * scan->nb_intervals / scan->nb_jobs;
+    int last  = (int64_t)(jobnr + 1) * scan->nb_intervals / scan->nb_jobs;
+    int bytes_per_pixel = 1 + (s->bits > 8);
+    int nb_mbs = s->mb_width * s->mb_height;
+    LOCAL_ALIGNED_32(int16_t, block, [64]);
+    int interval;
+
+    for (interval = first; interval < last; interval++) {
+        const uint8_t *start = interval ? s->buffer + s->rst_pos[interval - 1]
+                                        : scan->start;
+        int mb     = interval * s->restart_interval;
+        int mb_end = FFMIN(mb + s->restart_interval, nb_mbs);
+        int last_dc[MAX_COMPONENTS];
+        GetBitContext gb;
+        int i;
+
+        init_get_bits8(&gb, start, buf_end - start);
+        for (i = 0; i < scan->nb_components; i++)
+            last_dc[i] = 4 << s->bits;
+
+        for (; mb < mb_end; mb++) {
+            int mb_x = mb % s->mb_width;
+            int mb_y = mb / s->mb_width;
+
+            if (get_bits_left(&gb) < 0) {
+                av_log(avctx, AV_LOG_ERROR, "overread %d\n", -get_bits_left(&gb));
+                atomic_store(&scan->error, AVERROR_INVALIDDATA);
+                return AVERROR_INVALIDDATA;
+            }
+            for (i = 0; i < scan->nb_components; i++) {
+                int c = s->comp_index[i];
+                int h = s->h_scount[i];
+                int v = s->v_scount[i];
+                int x = 0, y = 0, j;
+
+                for (j = 0; j < s->nb_blocks[i]; j++) {
+                    int block_offset = (((s->linesize[c] * (v * mb_y + y) * 8) +
+                                         (h * mb_x + x) * 8 * bytes_per_pixel) >> avctx->lowres);
+                    uint8_t *ptr = NULL;
+
+                    if (   8*(h * mb_x + x) < ((c == 1) || (c == 2) ? scan->chroma_width  : s->width)
+                        && 8*(v * mb_y + y) < ((c == 1) || (c == 2) ? scan->chroma_height : s->height))
+                        ptr = s->picture_ptr->data[c] + block_offset;
+
+                    s->bdsp.clear_block(block);
+                    if (decode_block(s, &gb, last_dc, block, i,
+                                     s->dc_index[i], s->ac_index[i],
+                                     s->quant_matrixes[s->quant_sindex[i]]) < 0) {
+                        av_log(avctx, AV_LOG_ERROR,
+                               "error y=%d x=%d\n", mb_y, mb_x);
+                        atomic_store(&scan->error, AVERROR_INVALIDDATA);
+                        return AVERROR_INVALIDDATA;
+                    }
+                    if (ptr) {
+                        s->idsp.idct_put(ptr, s->linesize[c], block);
+                        if (s->bits & 7)
+                            shift_output(s, ptr, s->linesize[c]);
+                    }
+                    if (++x == h) {
+                        x = 0;
+                        y++;
+                    }
+                }
+            }
+        }
+
+        if (interval == scan->nb_intervals - 1)
+            scan->end_bits = (gb.buffer - s->buffer) * 8 + get_bits_count(&gb);
+    }
+    return 0;
+}
+
+/**
+ * Decode a baseline scan with slice threads, one restart interval being
+ * the smallest unit of work.
+ *
+ * @return 0 on success, AVERROR(EAGAIN) if the scan is not suitable and has
+ *         to be decoded with mjpeg_decode_scan(), another negative error code
+ *         on failure
+ */
+static int mjpeg_decode_scan_threaded(MJpegDecodeContext *s, int nb_components,
+                                      const uint8_t *mb_bitmask,
+                                      const AVFrame *reference)
+{
+    AVCodecContext *avctx = s->avctx;
+    MJpegRstScan scan = { 0 };
+    int chroma_h_shift, chroma_v_shift, nb_mbs, pos;
+
+    if (!(avctx->active_thread_type & FF_THREAD_SLICE) ||
+        avctx->thread_count <= 1 || !s->restart_interval ||
+        s->progressive || s->interlaced || mb_bitmask || reference ||
+        avctx->codec_id == AV_CODEC_ID_THP ||
+        s->gb.buffer != s->buffer || get_bits_count(&s->gb) & 7)
+        return AVERROR(EAGAIN);
+
+    /* every restart interval must start after its own RSTn marker */
+    nb_mbs            = s->mb_width * s->mb_height;
+    scan.nb_intervals = (nb_mbs + s->restart_interval - 1) / s->restart_interval;
+    pos               = get_bits_count(&s->gb) >> 3;
+    if (scan.nb_intervals < 2 || s->nb_rst < scan.nb_intervals - 1 ||
+        s->rst_pos[0] <= pos)
+        return AVERROR(EAGAIN);
+
+    av_pix_fmt_get_chroma_sub_sample(avctx->pix_fmt, &chroma_h_shift,
+                                     &chroma_v_shift);
+    scan.chroma_width  = AV_CEIL_RSHIFT(s->width,  chroma_h_shift);
+    scan.chroma_height = AV_CEIL_RSHIFT(s->height, chroma_v_shift);
+    scan.start         = s->buffer + pos;
+    scan.nb_components = nb_components;
+    scan.nb_jobs       = FFMIN(scan.nb_intervals, 4 * avctx->thread_count);
+    scan.end_bits      = get_bits_count(&s->gb);
+    atomic_init(&scan.error, 0);
+
+    avctx->execute2(avctx, decode_rst_intervals, &scan, NULL, scan.nb_jobs);
+
+    skip_bits_long(&s->gb, scan.end_bits - get_bits_count(&s->gb));
+    return atomic_load(&scan.error);
+}
+
 static int mjpeg_decode_scan_progressive_ac(MJpegDecodeContext *s, int ss,
                                             int se, int Ah, int Al)
 {
@@ -1768,9 +1908,12 @@ next_field:
                                                         point_transform)) < 0)
                 return ret;
         } else {
-            if ((ret = mjpeg_decode_scan(s, nb_components,
-                                         prev_shift, point_transform,
-                                         mb_bitmask, mb_bitmask_size, reference)) < 0)
+            ret = mjpeg_decode_scan_threaded(s, nb_components, mb_bitmask, reference);
+            if (ret == AVERROR(EAGAIN))
+                ret = mjpeg_decode_scan(s, nb_components,
+                                        prev_shift, point_transform,
+                                        mb_bitmask, mb_bitmask_size, reference);
+            if (ret < 0)
                 return ret;
         }
     }
@@ -2218,6 +2361,8 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
             }                                         \
         } while (0)
 
+        s->nb_rst = 0;
+
         if (s->avctx->codec_id == AV_CODEC_ID_THP) {
             ptr = buf_end;
             copy_data_segment(0);
@@ -2246,6 +2391,14 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
                         copy_data_segment(1);
                         if (x)
                             break;
+                    } else if (s->avctx->active_thread_type & FF_THREAD_SLICE) {
+                        /* entry point of the next restart interval */
+                        int *rst_pos = av_fast_realloc(s->rst_pos, &s->rst_pos_size,
+                                                       (s->nb_rst + 1) * sizeof(*s->rst_pos));
+                        if (!rst_pos)
+                            return AVERROR(ENOMEM);
+                        s->rst_pos = rst_pos;
+                        s->rst_pos[s->nb_rst++] = (dst - s->buffer) + (ptr - src);
                     }
                 }
             }
@@ -2898,6 +3051,7 @@ av_cold int ff_mjpeg_decode_end(AVCodecContext *avctx)
     av_frame_free(&s->smv_frame);
 
     av_freep(&s->buffer);
+    av_freep(&s->rst_pos);
     av_freep(&s->stereo3d);
     av_freep(&s->ljpeg_buffer);
     s->ljpeg_buffer_size = 0;
@@ -2954,7 +3108,7 @@ AVCodec ff_mjpeg_decoder = {
     .close          = ff_mjpeg_decode_end,
     .receive_frame  = ff_mjpeg_receive_frame,
     .flush          = decode_flush,
-    .capabilities   = AV_CODEC_CAP_DR1,
+    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_SLICE_THREADS,
     .max_lowres     = 3,
     .priv_class     = &mjpegdec_class,
     .profiles       = NULL_IF_CONFIG_SMALL(ff_mjpeg_profiles),
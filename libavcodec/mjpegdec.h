@@ -117,6 +117,9 @@ typedef struct MJpegDecodeContext {
 
     int restart_interval;
     int restart_count;
+    int *rst_pos;               ///< offsets in buffer of the scan data following each RSTn marker
+    unsigned int rst_pos_size;
+    int nb_rst;
 
     int buggy_avid;
     int cs_itu601;
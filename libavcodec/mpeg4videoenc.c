@@ -1373,6 +1373,8 @@ void ff_mpeg4_encode_video_packet_header(MpegEncContext *s)
 static const AVOption options[] = {
     { "data_partitioning", "Use data partitioning.",      OFFSET(data_partitioning), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, VE },
     { "alternate_scan",    "Enable alternate scantable.", OFFSET(alternate_scan),    AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, VE },
+    { "gop_lookahead",     "Encode whole GOPs in parallel with frame threading, queueing this many GOPs ahead (0 disables).",
+      OFFSET(gop_lookahead), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 16, VE },
     FF_MPV_COMMON_OPTS
     FF_MPEG4_PROFILE_OPTS
     { NULL },
@@ -1396,6 +1398,6 @@ AVCodec ff_mpeg4_encoder = {
     .close          = ff_mpv_encode_end,
     .pix_fmts       = (const enum AVPixelFormat[]) { AV_PIX_FMT_YUV420P, AV_PIX_FMT_NONE },
     .capabilities   = AV_CODEC_CAP_DELAY | AV_CODEC_CAP_SLICE_THREADS,
-    .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP,
+    .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP | FF_CODEC_CAP_GOP_THREADS,
     .priv_class     = &mpeg4enc_class,
 };
@@ -146,6 +146,12 @@ typedef struct MpegEncContext {
      * reordered pts to be used as dts for the next output frame when there's
      * a delay */
     int64_t reordered_pts;
+    /**
+     * set once all pictures have been output while flushing; the next input
+     * frame then starts a new, independent sequence (GOP-parallel threading) */
+    int flushed;
+    int64_t first_frame_number; ///< avctx->frame_number of the first frame of the current sequence
+    int gop_lookahead;          ///< number of GOPs queued ahead of the encoding threads, 0 disables GOP-parallel threading
 
     /** bit output */
     PutBitContext pb;
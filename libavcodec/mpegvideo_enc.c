@@ -1852,6 +1852,20 @@ int ff_mpv_encode_picture(AVCodecContext *avctx, AVPacket *pkt,
 
     s->vbv_ignore_qmax = 0;
 
+    if (pic_arg && s->flushed) {
+        /* Start a new sequence after having been flushed, like a freshly
+         * opened encoder would. */
+        ff_mpeg_flush(avctx);
+        s->flushed               = 0;
+        s->input_picture_number  = 0;
+        s->coded_picture_number  = 0;
+        s->picture_in_gop_number = 0;
+        s->user_specified_pts    = AV_NOPTS_VALUE;
+        s->total_bits            = 0;
+    }
+    if (pic_arg && !s->input_picture_number)
+        s->first_frame_number = avctx->frame_number;
+
     s->picture_in_gop_number++;
 
     if (load_input_picture(s, pic_arg) < 0)
@@ -2089,6 +2103,8 @@ FF_ENABLE_DEPRECATION_WARNINGS
             av_packet_shrink_side_data(pkt, AV_PKT_DATA_H263_MB_INFO, s->mb_info_size);
     } else {
         s->frame_bits = 0;
+        if (!pic_arg)
+            s->flushed = 1;
     }
 
     /* release non-reference frames */
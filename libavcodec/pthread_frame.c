@@ -43,6 +43,7 @@
 #include "libavutil/log.h"
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
+#include "libavutil/slicethread.h"
 #include "libavutil/thread.h"
 
 enum {
@@ -175,6 +176,9 @@ static attribute_align_arg void *frame_worker_thread(void *arg)
     AVCodecContext *avctx = p->avctx;
     const AVCodec *codec = avctx->codec;
 
+    if (avctx->thread_affinity)
+        avpriv_thread_set_affinity(avctx->thread_affinity, p - p->parent->threads);
+
     pthread_mutex_lock(&p->mutex);
     while (1) {
         while (atomic_load(&p->state) == STATE_INPUT_READY && !p->die)
@@ -596,7 +600,9 @@ void ff_thread_report_progress(ThreadFrame *f, int n, int field)
 
     pthread_mutex_lock(&p->progress_mutex);
 
-    atomic_store_explicit(&progress[field], n, memory_order_release);
+    // slice threads of the owner may report concurrently, never go back
+    if (atomic_load_explicit(&progress[field], memory_order_relaxed) < n)
+        atomic_store_explicit(&progress[field], n, memory_order_release);
 
     pthread_cond_broadcast(&p->progress_cond);
     pthread_mutex_unlock(&p->progress_mutex);
@@ -710,6 +716,8 @@ void ff_frame_thread_free(AVCodecContext *avctx, int thread_count)
 
         if (codec->close && p->avctx)
             codec->close(p->avctx);
+        if (p->avctx && p->avctx->internal && p->avctx->internal->slice_thread_ctx)
+            ff_slice_thread_free(p->avctx);
 
 #if FF_API_THREAD_SAFE_CALLBACKS
         release_delayed_buffers(p);
@@ -42,6 +42,7 @@ typedef int (main_func)(AVCodecContext *c);
 
 typedef struct SliceThreadContext {
     AVSliceThread *thread;
+    int nb_threads;
     action_func *func;
     action_func2 *func2;
     main_func *mainfunc;
@@ -56,16 +57,23 @@ typedef struct SliceThreadContext {
     pthread_mutex_t *progress_mutex;
 } SliceThreadContext;
 
+static SliceThreadContext *get_slice_thread_ctx(const AVCodecContext *avctx)
+{
+    /* Frame threads use their thread_ctx for the PerThreadContext. */
+    return avctx->internal->slice_thread_ctx ? avctx->internal->slice_thread_ctx
+                                             : avctx->internal->thread_ctx;
+}
+
 static void main_function(void *priv) {
     AVCodecContext *avctx = priv;
-    SliceThreadContext *c = avctx->internal->thread_ctx;
+    SliceThreadContext *c = get_slice_thread_ctx(avctx);
     c->mainfunc(avctx);
 }
 
 static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
 {
     AVCodecContext *avctx = priv;
-    SliceThreadContext *c = avctx->internal->thread_ctx;
+    SliceThreadContext *c = get_slice_thread_ctx(avctx);
     int ret;
 
     ret = c->func ? c->func(avctx, (char *)c->args + c->job_size * jobnr)
@@ -76,7 +84,7 @@ static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb
 
 void ff_slice_thread_free(AVCodecContext *avctx)
 {
-    SliceThreadContext *c = avctx->internal->thread_ctx;
+    SliceThreadContext *c = get_slice_thread_ctx(avctx);
     int i;
 
     avpriv_slicethread_free(&c->thread);
@@ -89,14 +97,17 @@ void ff_slice_thread_free(AVCodecContext *avctx)
     av_freep(&c->entries);
     av_freep(&c->progress_mutex);
     av_freep(&c->progress_cond);
-    av_freep(&avctx->internal->thread_ctx);
+    if (avctx->internal->slice_thread_ctx)
+        av_freep(&avctx->internal->slice_thread_ctx);
+    else
+        av_freep(&avctx->internal->thread_ctx);
 }
 
 static int thread_execute(AVCodecContext *avctx, action_func* func, void *arg, int *ret, int job_count, int job_size)
 {
-    SliceThreadContext *c = avctx->internal->thread_ctx;
+    SliceThreadContext *c = get_slice_thread_ctx(avctx);
 
-    if (!(avctx->active_thread_type&FF_THREAD_SLICE) || avctx->thread_count <= 1)
+    if (!(avctx->active_thread_type&FF_THREAD_SLICE) || c->nb_threads <= 1)
         return avcodec_default_execute(avctx, func, arg, ret, job_count, job_size);
 
     if (job_count <= 0)
@@ -113,14 +124,14 @@ static int thread_execute(AVCodecContext *avctx, action_func* func, void *arg, i
 
 static int thread_execute2(AVCodecContext *avctx, action_func2* func2, void *arg, int *ret, int job_count)
 {
-    SliceThreadContext *c = avctx->internal->thread_ctx;
+    SliceThreadContext *c = get_slice_thread_ctx(avctx);
     c->func2 = func2;
     return thread_execute(avctx, NULL, arg, ret, job_count, 0);
 }
 
 int ff_slice_thread_execute_with_mainfunc(AVCodecContext *avctx, action_func2* func2, main_func *mainfunc, void *arg, int *ret, int job_count)
 {
-    SliceThreadContext *c = avctx->internal->thread_ctx;
+    SliceThreadContext *c = get_slice_thread_ctx(avctx);
     c->func2 = func2;
     c->mainfunc = mainfunc;
     return thread_execute(avctx, NULL, arg, ret, job_count, 0);
@@ -156,7 +167,11 @@ int ff_slice_thread_init(AVCodecContext *avctx)
 
     avctx->internal->thread_ctx = c = av_mallocz(sizeof(*c));
     mainfunc = avctx->codec->caps_internal & FF_CODEC_CAP_SLICE_THREAD_HAS_MF ? &main_function : NULL;
-    if (!c || (thread_count = avpriv_slicethread_create(&c->thread, avctx, worker_func, mainfunc, thread_count)) <= 1) {
+    if (c && avctx->shared_threads && !mainfunc)
+        thread_count = avpriv_slicethread_create_shared(&c->thread, avctx, worker_func, thread_count);
+    else if (c)
+        thread_count = avpriv_slicethread_create(&c->thread, avctx, worker_func, mainfunc, thread_count);
+    if (!c || thread_count <= 1) {
         if (c)
             avpriv_slicethread_free(&c->thread);
         av_freep(&avctx->internal->thread_ctx);
@@ -164,16 +179,60 @@ int ff_slice_thread_init(AVCodecContext *avctx)
         avctx->active_thread_type = 0;
         return 0;
     }
-    avctx->thread_count = thread_count;
+    avctx->thread_count = c->nb_threads = thread_count;
+
+    if (avctx->thread_affinity) {
+        int ret = avpriv_slicethread_set_affinity(c->thread, avctx->thread_affinity);
+        if (ret < 0)
+            av_log(avctx, AV_LOG_WARNING, "Cannot set thread affinity '%s': %s\n",
+                   avctx->thread_affinity, av_err2str(ret));
+    }
 
     avctx->execute = thread_execute;
     avctx->execute2 = thread_execute2;
     return 0;
 }
 
+int ff_slice_thread_init_frame_thread(AVCodecContext *avctx, int thread_count)
+{
+    SliceThreadContext *c;
+
+    av_assert0(avctx->active_thread_type & FF_THREAD_FRAME);
+
+    if (!thread_count) {
+        int nb_cpus = av_cpu_count();
+        if (avctx->height)
+            nb_cpus = FFMIN(nb_cpus, (avctx->height + 15) / 16);
+        thread_count = nb_cpus > 1 ? FFMIN(nb_cpus + 1, MAX_AUTO_THREADS) : 1;
+    }
+
+    if (thread_count <= 1)
+        return 1;
+
+    avctx->internal->slice_thread_ctx = c = av_mallocz(sizeof(*c));
+    if (!c)
+        return AVERROR(ENOMEM);
+
+    if (avctx->shared_threads)
+        thread_count = avpriv_slicethread_create_shared(&c->thread, avctx, worker_func, thread_count);
+    else
+        thread_count = avpriv_slicethread_create(&c->thread, avctx, worker_func, NULL, thread_count);
+    if (thread_count <= 1) {
+        avpriv_slicethread_free(&c->thread);
+        av_freep(&avctx->internal->slice_thread_ctx);
+        return thread_count < 0 ? thread_count : 1;
+    }
+    c->nb_threads = thread_count;
+
+    avctx->active_thread_type |= FF_THREAD_SLICE;
+    avctx->execute  = thread_execute;
+    avctx->execute2 = thread_execute2;
+    return thread_count;
+}
+
 void ff_thread_report_progress2(AVCodecContext *avctx, int field, int thread, int n)
 {
-    SliceThreadContext *p = avctx->internal->thread_ctx;
+    SliceThreadContext *p = get_slice_thread_ctx(avctx);
     int *entries = p->entries;
 
     pthread_mutex_lock(&p->progress_mutex[thread]);
@@ -184,7 +243,7 @@ void ff_thread_report_progress2(AVCodecContext *avctx, int field, int thread, in
 
 void ff_thread_await_progress2(AVCodecContext *avctx, int field, int thread, int shift)
 {
-    SliceThreadContext *p  = avctx->internal->thread_ctx;
+    SliceThreadContext *p  = get_slice_thread_ctx(avctx);
     int *entries      = p->entries;
 
     if (!entries || !field) return;
@@ -203,14 +262,14 @@ int ff_alloc_entries(AVCodecContext *avctx, int count)
     int i;
 
     if (avctx->active_thread_type & FF_THREAD_SLICE)  {
-        SliceThreadContext *p = avctx->internal->thread_ctx;
+        SliceThreadContext *p = get_slice_thread_ctx(avctx);
 
         if (p->entries) {
-            av_assert0(p->thread_count == avctx->thread_count);
+            av_assert0(p->thread_count == p->nb_threads);
             av_freep(&p->entries);
         }
 
-        p->thread_count  = avctx->thread_count;
+        p->thread_count  = p->nb_threads;
         p->entries       = av_mallocz_array(count, sizeof(int));
 
         if (!p->progress_mutex) {
@@ -237,6 +296,6 @@ int ff_alloc_entries(AVCodecContext *avctx, int count)
 
 void ff_reset_entries(AVCodecContext *avctx)
 {
-    SliceThreadContext *p = avctx->internal->thread_ctx;
+    SliceThreadContext *p = get_slice_thread_ctx(avctx);
     memset(p->entries, 0, p->entries_count * sizeof(int));
 }
@@ -140,6 +140,20 @@ int ff_slice_thread_execute_with_mainfunc(AVCodecContext *avctx,
         int (*action_func2)(AVCodecContext *c, void *arg, int jobnr, int threadnr),
         int (*main_func)(AVCodecContext *c), void *arg, int *ret, int job_count);
 void ff_thread_free(AVCodecContext *s);
+
+/**
+ * Set up slice threading inside a frame thread, so that execute() and
+ * execute2() run their jobs in parallel as well.
+ * To be called from the init function of a frame threaded decoder, which
+ * is run once for every frame thread.
+ *
+ * @param avctx the context of the frame thread
+ * @param thread_count number of threads, 0 for automatic
+ * @return the number of slice threads, 1 if slice threading is not used,
+ *         or a negative AVERROR on failure
+ */
+int ff_slice_thread_init_frame_thread(AVCodecContext *avctx, int thread_count);
+
 int ff_alloc_entries(AVCodecContext *avctx, int count);
 void ff_reset_entries(AVCodecContext *avctx);
 void ff_thread_report_progress2(AVCodecContext *avctx, int field, int thread, int n);
@@ -1962,6 +1962,11 @@ int ff_thread_can_start_frame(AVCodecContext *avctx)
     return 1;
 }
 
+int ff_slice_thread_init_frame_thread(AVCodecContext *avctx, int thread_count)
+{
+    return 1;
+}
+
 int ff_alloc_entries(AVCodecContext *avctx, int count)
 {
     return 0;
@@ -33,6 +33,7 @@
 #include "libavutil/rational.h"
 #include "libavutil/samplefmt.h"
 #include "libavutil/thread.h"
+#include "libavutil/time.h"
 
 #define FF_INTERNAL_FIELDS 1
 #include "framequeue.h"
@@ -649,13 +650,28 @@ static const AVClass avfilter_class = {
 static int default_execute(AVFilterContext *ctx, avfilter_action_func *func, void *arg,
                            int *ret, int nb_jobs)
 {
+    int64_t start = 0;
     int i;
 
+    if (ctx->graph->collect_stats)
+        start = av_gettime_relative();
+
     for (i = 0; i < nb_jobs; i++) {
         int r = func(ctx, arg, i, nb_jobs);
         if (ret)
             ret[i] = r;
     }
+
+    if (ctx->graph->collect_stats && nb_jobs > 0) {
+        AVFilterStats *stats = &ctx->internal->stats;
+        int64_t elapsed = av_gettime_relative() - start;
+
+        stats->nb_executes++;
+        stats->nb_jobs      += nb_jobs;
+        stats->execute_time += elapsed;
+        stats->job_time     += elapsed;
+        stats->job_time_max += elapsed;
+    }
     return 0;
 }
 
@@ -770,7 +786,12 @@ void avfilter_free(AVFilterContext *filter)
         filter->filter->uninit(filter);
 
     for (i = 0; i < filter->nb_inputs; i++) {
-        free_link(filter->inputs[i]);
+        AVFilterLink *link = filter->inputs[i];
+        if (link && link->copied_frames)
+            av_log(filter, AV_LOG_VERBOSE,
+                   "%"PRId64" frames (%"PRId64" bytes) copied on input '%s' to make them writable\n",
+                   link->copied_frames, link->copied_bytes, link->dstpad->name);
+        free_link(link);
     }
     for (i = 0; i < filter->nb_outputs; i++) {
         free_link(filter->outputs[i]);
@@ -1428,21 +1449,66 @@ static int ff_filter_activate_default(AVFilterContext *filter)
      [buffersrc1][testsrc1][buffersrc2][testsrc2]concat=v=2).
  */
 
+static int filter_queued_frames(const AVFilterContext *filter)
+{
+    int i, queued = 0;
+
+    for (i = 0; i < filter->nb_inputs; i++)
+        if (filter->inputs[i])
+            queued += ff_framequeue_queued_frames(&filter->inputs[i]->fifo);
+    return queued;
+}
+
 int ff_filter_activate(AVFilterContext *filter)
 {
+    AVFilterStats *stats = &filter->internal->stats;
+    int64_t start = 0;
     int ret;
 
     /* Generic timeline support is not yet implemented but should be easy */
     av_assert1(!(filter->filter->flags & AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC &&
                  filter->filter->activate));
+    if (filter->graph->collect_stats) {
+        stats->max_queued = FFMAX(stats->max_queued, filter_queued_frames(filter));
+        start = av_gettime_relative();
+    }
     filter->ready = 0;
     ret = filter->filter->activate ? filter->filter->activate(filter) :
           ff_filter_activate_default(filter);
+    if (filter->graph->collect_stats) {
+        stats->nb_activations++;
+        stats->time += av_gettime_relative() - start;
+    }
     if (ret == FFERROR_NOT_READY)
         ret = 0;
     return ret;
 }
 
+AVFilterStats *avfilter_get_stats(const AVFilterContext *filter)
+{
+    AVFilterStats *stats = av_memdup(&filter->internal->stats, sizeof(*stats));
+    int i;
+
+    if (!stats)
+        return NULL;
+    stats->cpu_time = stats->time - stats->execute_time + stats->job_time;
+    stats->frames_in = stats->frames_out = 0;
+    stats->copied_frames = stats->copied_bytes = 0;
+    for (i = 0; i < filter->nb_inputs; i++) {
+        AVFilterLink *link = filter->inputs[i];
+        if (!link)
+            continue;
+        stats->frames_in     += link->frame_count_out;
+        stats->copied_frames += link->copied_frames;
+        stats->copied_bytes  += link->copied_bytes;
+    }
+    for (i = 0; i < filter->nb_outputs; i++)
+        if (filter->outputs[i])
+            stats->frames_out += filter->outputs[i]->frame_count_in;
+    stats->queued = filter_queued_frames(filter);
+    return stats;
+}
+
 int ff_inlink_acknowledge_status(AVFilterLink *link, int *rstatus, int64_t *rpts)
 {
     *rpts = link->current_pts;
@@ -1536,7 +1602,7 @@ int ff_inlink_make_frame_writable(AVFilterLink *link, AVFrame **rframe)
 {
     AVFrame *frame = *rframe;
     AVFrame *out;
-    int ret;
+    int ret, size = 0;
 
     if (av_frame_is_writable(frame))
         return 0;
@@ -1565,17 +1631,24 @@ int ff_inlink_make_frame_writable(AVFilterLink *link, AVFrame **rframe)
     case AVMEDIA_TYPE_VIDEO:
         av_image_copy(out->data, out->linesize, (const uint8_t **)frame->data, frame->linesize,
                       frame->format, frame->width, frame->height);
+        size = av_image_get_buffer_size(frame->format, frame->width, frame->height, 1);
         break;
     case AVMEDIA_TYPE_AUDIO:
         av_samples_copy(out->extended_data, frame->extended_data,
                         0, 0, frame->nb_samples,
                         frame->channels,
                         frame->format);
+        size = av_samples_get_buffer_size(NULL, frame->channels, frame->nb_samples,
+                                          frame->format, 1);
         break;
     default:
         av_assert0(!"reached");
     }
 
+    link->copied_frames++;
+    if (size > 0)
+        link->copied_bytes += size;
+
     av_frame_free(&frame);
     *rframe = out;
     return 0;
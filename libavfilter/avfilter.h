@@ -652,6 +652,12 @@ struct AVFilterLink {
      */
     int status_out;
 
+    /**
+     * Number of frames, and of bytes of frame data, that had to be copied
+     * because a frame was not writable when the destination needed it to be.
+     */
+    int64_t copied_frames, copied_bytes;
+
 #endif /* FF_INTERNAL_FIELDS */
 
 };
@@ -906,6 +912,37 @@ typedef struct AVFilterGraph {
 
     char *aresample_swr_opts; ///< swr options to use for the auto-inserted aresample filters, Access ONLY through AVOptions
 
+    /**
+     * If nonzero, processing statistics are collected for every filter of
+     * the graph, see avfilter_get_stats().
+     *
+     * May be set by the caller at any time, statistics are collected from
+     * then on.
+     */
+    int collect_stats;
+
+    /**
+     * List of CPUs the slice threads of the graph are pinned to, e.g.
+     * "0-7,16-23". Thread n is pinned to the n-th CPU of the list. Only the
+     * CPU affinity of the threads is set, frames are allocated as without
+     * it. The threads of the swscale contexts of scale filters are not
+     * pinned.
+     *
+     * Must be set before the first filter is added to the graph.
+     * Access ONLY through AVOptions.
+     */
+    char *thread_affinity;
+
+    /**
+     * If nonzero, the slice threading jobs of the graph are run on the
+     * thread pool shared by all graphs and codec contexts of the process
+     * which set this option, instead of threads of the graph's own.
+     * nb_threads then limits how many threads work on the graph at once.
+     *
+     * Must be set before the first filter is added to the graph.
+     */
+    int shared_threads;
+
     /**
      * Private fields
      *
@@ -954,6 +991,73 @@ AVFilterContext *avfilter_graph_alloc_filter(AVFilterGraph *graph,
  */
 AVFilterContext *avfilter_graph_get_filter(AVFilterGraph *graph, const char *name);
 
+/**
+ * Processing statistics of a filter instance.
+ *
+ * All times are in microseconds. With slice threading, the execute_*,
+ * job_* and idle_time fields describe how well the work of the filter is
+ * spread over the threads of the graph.
+ *
+ * sizeof(AVFilterStats) is not a part of the public ABI, new fields may be
+ * added to the end with a minor version bump. Instances are only allocated
+ * by avfilter_get_stats().
+ */
+typedef struct AVFilterStats {
+    int64_t nb_activations; ///< number of times the filter was run
+    int64_t frames_in;      ///< frames consumed on all inputs
+    int64_t frames_out;     ///< frames sent on all outputs
+
+    /**
+     * Wall clock time spent running the filter, including the slice
+     * threaded parts.
+     */
+    int64_t time;
+
+    /**
+     * Processing time of all threads: time, with the wall clock time of
+     * the slice threaded parts replaced by the job time of all threads.
+     */
+    int64_t cpu_time;
+
+    int64_t nb_executes;    ///< number of slice threaded execute() calls
+    int64_t nb_jobs;        ///< number of jobs run by these calls
+    int64_t execute_time;   ///< wall clock time spent in execute() calls
+    int64_t job_time;       ///< time spent in jobs, summed over all threads
+
+    /**
+     * Time spent in jobs by the busiest thread, summed over all execute()
+     * calls. This equals execute_time for a perfectly balanced workload.
+     */
+    int64_t job_time_max;
+
+    /**
+     * Time that threads taking part in execute() calls spent waiting for
+     * the others to finish.
+     */
+    int64_t idle_time;
+
+    int queued;             ///< frames currently queued on all inputs
+    int max_queued;         ///< maximum of queued seen when running the filter
+
+    /**
+     * Frames, and bytes of frame data, copied on all inputs because a frame
+     * was not writable when the filter needed it to be.
+     */
+    int64_t copied_frames;
+    int64_t copied_bytes;
+} AVFilterStats;
+
+/**
+ * Get the processing statistics of a filter instance.
+ *
+ * The statistics are only collected while AVFilterGraph.collect_stats is
+ * set, all fields except the frame, copy and queue counts are zero otherwise.
+ *
+ * @return a newly allocated snapshot of the statistics, which must be freed
+ *         with av_free(), or NULL on allocation failure
+ */
+AVFilterStats *avfilter_get_stats(const AVFilterContext *ctx);
+
 /**
  * Create and add a filter instance into an existing graph.
  * The filter instance is created from the filter filt and inited
@@ -56,6 +56,12 @@ static const AVOption filtergraph_options[] = {
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, F|V },
     {"aresample_swr_opts"   , "default aresample filter options"    , OFFSET(aresample_swr_opts)    ,
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, F|A },
+    { "collect_stats", "collect per-filter processing statistics", OFFSET(collect_stats),
+        AV_OPT_TYPE_BOOL,  { .i64 = 0 }, 0, 1, F|V|A },
+    { "thread_affinity", "list of CPUs to pin the threads to", OFFSET(thread_affinity),
+        AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, F|V|A },
+    { "shared_threads", "run jobs on the process-wide shared thread pool", OFFSET(shared_threads),
+        AV_OPT_TYPE_BOOL,  { .i64 = 0 }, 0, 1, F|V|A },
     { NULL },
 };
 
@@ -131,6 +137,7 @@ void avfilter_graph_free(AVFilterGraph **graph)
 
     av_freep(&(*graph)->scale_sws_opts);
     av_freep(&(*graph)->aresample_swr_opts);
+    av_freep(&(*graph)->thread_affinity);
 #if FF_API_LAVR_OPTS
     av_freep(&(*graph)->resample_lavr_opts);
 #endif
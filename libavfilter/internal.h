@@ -134,6 +134,12 @@ struct AVFilterGraphInternal {
 
 struct AVFilterInternal {
     avfilter_execute_func *execute;
+
+    /**
+     * Processing statistics, only updated if AVFilterGraph.collect_stats
+     * is set. Frame and queue counts are filled in by avfilter_get_stats().
+     */
+    AVFilterStats stats;
 };
 
 /**
@@ -27,6 +27,7 @@
 #include "libavutil/cpu.h"
 #include "libavutil/mem.h"
 #include "libavutil/thread.h"
+#include "libavutil/time.h"
 #include "libavutil/slicethread.h"
 
 #include "avfilter.h"
@@ -37,24 +38,52 @@ typedef struct ThreadContext {
     AVFilterGraph *graph;
     AVSliceThread *thread;
     avfilter_action_func *func;
+    int nb_threads;
+    int64_t *job_time;  ///< per thread, only used when collecting stats
 
     /* per-execute parameters */
     AVFilterContext *ctx;
     void *arg;
     int   *rets;
+    int collect_stats;
 } ThreadContext;
 
 static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
 {
     ThreadContext *c = priv;
+    int64_t start = c->collect_stats ? av_gettime_relative() : 0;
     int ret = c->func(c->ctx, c->arg, jobnr, nb_jobs);
     if (c->rets)
         c->rets[jobnr] = ret;
+    if (c->collect_stats)
+        c->job_time[threadnr] += av_gettime_relative() - start;
 }
 
 static void slice_thread_uninit(ThreadContext *c)
 {
     avpriv_slicethread_free(&c->thread);
+    av_freep(&c->job_time);
+}
+
+static void update_stats(ThreadContext *c, int nb_jobs, int64_t elapsed)
+{
+    AVFilterStats *stats = &c->ctx->internal->stats;
+    int nb_active = FFMIN(nb_jobs, c->nb_threads);
+    int64_t sum = 0, max = 0;
+    int i;
+
+    for (i = 0; i < nb_active; i++) {
+        sum  += c->job_time[i];
+        max   = FFMAX(max, c->job_time[i]);
+        c->job_time[i] = 0;
+    }
+
+    stats->nb_executes++;
+    stats->nb_jobs      += nb_jobs;
+    stats->execute_time += elapsed;
+    stats->job_time     += sum;
+    stats->job_time_max += max;
+    stats->idle_time    += FFMAX(elapsed * nb_active - sum, 0);
 }
 
 static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
@@ -68,17 +97,36 @@ static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
     c->arg         = arg;
     c->func        = func;
     c->rets        = ret;
-
-    avpriv_slicethread_execute(c->thread, nb_jobs, 0);
+    c->collect_stats = ctx->graph->collect_stats;
+
+    if (c->collect_stats) {
+        int64_t start = av_gettime_relative();
+        avpriv_slicethread_execute(c->thread, nb_jobs, 0);
+        update_stats(c, nb_jobs, av_gettime_relative() - start);
+    } else {
+        avpriv_slicethread_execute(c->thread, nb_jobs, 0);
+    }
     return 0;
 }
 
-static int thread_init_internal(ThreadContext *c, int nb_threads)
+static int thread_init_internal(ThreadContext *c, int nb_threads, int shared)
 {
-    nb_threads = avpriv_slicethread_create(&c->thread, c, worker_func, NULL, nb_threads);
-    if (nb_threads <= 1)
+    if (shared)
+        nb_threads = avpriv_slicethread_create_shared(&c->thread, c, worker_func, nb_threads);
+    else
+        nb_threads = avpriv_slicethread_create(&c->thread, c, worker_func, NULL, nb_threads);
+    if (nb_threads <= 1) {
         avpriv_slicethread_free(&c->thread);
-    return FFMAX(nb_threads, 1);
+        return FFMAX(nb_threads, 1);
+    }
+
+    c->job_time = av_mallocz_array(nb_threads, sizeof(*c->job_time));
+    if (!c->job_time) {
+        avpriv_slicethread_free(&c->thread);
+        return AVERROR(ENOMEM);
+    }
+    c->nb_threads = nb_threads;
+    return nb_threads;
 }
 
 int ff_graph_thread_init(AVFilterGraph *graph)
@@ -94,7 +142,8 @@ int ff_graph_thread_init(AVFilterGraph *graph)
     if (!graph->internal->thread)
         return AVERROR(ENOMEM);
 
-    ret = thread_init_internal(graph->internal->thread, graph->nb_threads);
+    ret = thread_init_internal(graph->internal->thread, graph->nb_threads,
+                               graph->shared_threads);
     if (ret <= 1) {
         av_freep(&graph->internal->thread);
         graph->thread_type = 0;
@@ -103,6 +152,14 @@ int ff_graph_thread_init(AVFilterGraph *graph)
     }
     graph->nb_threads = ret;
 
+    if (graph->thread_affinity) {
+        ThreadContext *c = graph->internal->thread;
+        ret = avpriv_slicethread_set_affinity(c->thread, graph->thread_affinity);
+        if (ret < 0)
+            av_log(graph, AV_LOG_WARNING, "Cannot set thread affinity '%s': %s\n",
+                   graph->thread_affinity, av_err2str(ret));
+    }
+
     graph->internal->thread_execute = thread_execute;
 
     return 0;
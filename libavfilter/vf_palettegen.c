@@ -60,6 +60,7 @@ enum {
 
 #define NBITS 5
 #define HIST_SIZE (1<<(3*NBITS))
+#define MAX_THREADS 64
 
 typedef struct PaletteGenContext {
     const AVClass *class;
@@ -76,8 +77,16 @@ typedef struct PaletteGenContext {
     int nb_boxes;                           // number of boxes (increase will segmenting them)
     int palette_pushed;                     // if the palette frame is pushed into the outlink or not
     uint8_t transparency_color[4];          // background color for transparency
+    int nb_threads;                         // number of slice jobs for the histogram
+    struct hist_node *slice_hist[MAX_THREADS]; // per slice histograms, merged into histogram
+    int jobs_ret[MAX_THREADS];
 } PaletteGenContext;
 
+typedef struct ThreadData {
+    const AVFrame *f1, *f2;
+    int nb_jobs;
+} ThreadData;
+
 #define OFFSET(x) offsetof(PaletteGenContext, x)
 #define FLAGS AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_VIDEO_PARAM
 static const AVOption palettegen_options[] = {
@@ -403,19 +412,17 @@ static inline unsigned color_hash(uint32_t color)
 }
 
 /**
- * Locate the color in the hash table and increment its counter.
+ * Locate the color in the hash table node and add count to its counter.
  */
-static int color_inc(struct hist_node *hist, uint32_t color)
+static av_always_inline int color_add(struct hist_node *node, uint32_t color, uint64_t count)
 {
     int i;
-    const unsigned hash = color_hash(color);
-    struct hist_node *node = &hist[hash];
     struct color_ref *e;
 
     for (i = 0; i < node->nb_entries; i++) {
         e = &node->entries[i];
         if (e->color == color) {
-            e->count++;
+            e->count += count;
             return 0;
         }
     }
@@ -425,19 +432,28 @@ static int color_inc(struct hist_node *hist, uint32_t color)
     if (!e)
         return AVERROR(ENOMEM);
     e->color = color;
-    e->count = 1;
+    e->count = count;
     return 1;
 }
 
+/**
+ * Locate the color in the hash table and increment its counter.
+ */
+static int color_inc(struct hist_node *hist, uint32_t color)
+{
+    return color_add(&hist[color_hash(color)], color, 1);
+}
+
 /**
  * Update histogram when pixels differ from previous frame.
  */
 static int update_histogram_diff(struct hist_node *hist,
-                                 const AVFrame *f1, const AVFrame *f2)
+                                 const AVFrame *f1, const AVFrame *f2,
+                                 int slice_start, int slice_end)
 {
     int x, y, ret, nb_diff_colors = 0;
 
-    for (y = 0; y < f1->height; y++) {
+    for (y = slice_start; y < slice_end; y++) {
         const uint32_t *p = (const uint32_t *)(f1->data[0] + y*f1->linesize[0]);
         const uint32_t *q = (const uint32_t *)(f2->data[0] + y*f2->linesize[0]);
 
@@ -456,11 +472,12 @@ static int update_histogram_diff(struct hist_node *hist,
 /**
  * Simple histogram of the frame.
  */
-static int update_histogram_frame(struct hist_node *hist, const AVFrame *f)
+static int update_histogram_frame(struct hist_node *hist, const AVFrame *f,
+                                  int slice_start, int slice_end)
 {
     int x, y, ret, nb_diff_colors = 0;
 
-    for (y = 0; y < f->height; y++) {
+    for (y = slice_start; y < slice_end; y++) {
         const uint32_t *p = (const uint32_t *)(f->data[0] + y*f->linesize[0]);
 
         for (x = 0; x < f->width; x++) {
@@ -473,6 +490,69 @@ static int update_histogram_frame(struct hist_node *hist, const AVFrame *f)
     return nb_diff_colors;
 }
 
+static int histogram_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    PaletteGenContext *s = ctx->priv;
+    ThreadData *td = arg;
+    const int slice_start = (td->f2->height *  jobnr     ) / nb_jobs;
+    const int slice_end   = (td->f2->height * (jobnr + 1)) / nb_jobs;
+    int ret = td->f1 ? update_histogram_diff(s->slice_hist[jobnr], td->f1, td->f2, slice_start, slice_end)
+                     : update_histogram_frame(s->slice_hist[jobnr], td->f2, slice_start, slice_end);
+
+    return FFMIN(ret, 0);
+}
+
+/**
+ * Merge the slice histograms into the main one. The slices are merged in
+ * order, so every hash table node ends up listing its colors in the same
+ * order as a single threaded scan would have. Returns the number of new
+ * colors.
+ */
+static int merge_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    PaletteGenContext *s = ctx->priv;
+    ThreadData *td = arg;
+    const int start = (HIST_SIZE *  jobnr     ) / nb_jobs;
+    const int end   = (HIST_SIZE * (jobnr + 1)) / nb_jobs;
+    int i, j, k, ret, nb_new_colors = 0;
+
+    for (i = start; i < end; i++) {
+        for (j = 0; j < td->nb_jobs; j++) {
+            struct hist_node *node = &s->slice_hist[j][i];
+
+            for (k = 0; k < node->nb_entries; k++) {
+                ret = color_add(&s->histogram[i], node->entries[k].color, node->entries[k].count);
+                if (ret < 0)
+                    return ret;
+                nb_new_colors += ret;
+            }
+            node->nb_entries = 0;
+        }
+    }
+    return nb_new_colors;
+}
+
+static int update_histogram_threaded(AVFilterContext *ctx, const AVFrame *prev, const AVFrame *in)
+{
+    PaletteGenContext *s = ctx->priv;
+    ThreadData td = { .f1 = prev, .f2 = in };
+    int i, nb_diff_colors = 0;
+
+    td.nb_jobs = FFMIN(s->nb_threads, in->height);
+    ctx->internal->execute(ctx, histogram_slice, &td, s->jobs_ret, td.nb_jobs);
+    for (i = 0; i < td.nb_jobs; i++)
+        if (s->jobs_ret[i] < 0)
+            return s->jobs_ret[i];
+
+    ctx->internal->execute(ctx, merge_slice, &td, s->jobs_ret, s->nb_threads);
+    for (i = 0; i < s->nb_threads; i++) {
+        if (s->jobs_ret[i] < 0)
+            return s->jobs_ret[i];
+        nb_diff_colors += s->jobs_ret[i];
+    }
+    return nb_diff_colors;
+}
+
 /**
  * Update the histogram for each passing frame. No frame will be pushed here.
  */
@@ -480,8 +560,9 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
 {
     AVFilterContext *ctx = inlink->dst;
     PaletteGenContext *s = ctx->priv;
-    int ret = s->prev_frame ? update_histogram_diff(s->histogram, s->prev_frame, in)
-                            : update_histogram_frame(s->histogram, in);
+    int ret = s->nb_threads > 1 ? update_histogram_threaded(ctx, s->prev_frame, in) :
+              s->prev_frame     ? update_histogram_diff(s->histogram, s->prev_frame, in, 0, in->height)
+                                : update_histogram_frame(s->histogram, in, 0, in->height);
 
     if (ret > 0)
         s->nb_refs += ret;
@@ -530,6 +611,23 @@ static int request_frame(AVFilterLink *outlink)
     return r;
 }
 
+static int config_input(AVFilterLink *inlink)
+{
+    AVFilterContext *ctx = inlink->dst;
+    PaletteGenContext *s = ctx->priv;
+    int i;
+
+    s->nb_threads = FFMIN(ff_filter_get_nb_threads(ctx), MAX_THREADS);
+    for (i = 0; i < s->nb_threads && s->nb_threads > 1; i++) {
+        if (!s->slice_hist[i]) {
+            s->slice_hist[i] = av_calloc(HIST_SIZE, sizeof(*s->slice_hist[i]));
+            if (!s->slice_hist[i])
+                return AVERROR(ENOMEM);
+        }
+    }
+    return 0;
+}
+
 /**
  * The output is one simple 16x16 squared-pixels palette.
  */
@@ -547,6 +645,14 @@ static av_cold void uninit(AVFilterContext *ctx)
 
     for (i = 0; i < HIST_SIZE; i++)
         av_freep(&s->histogram[i].entries);
+    for (i = 0; i < MAX_THREADS; i++) {
+        if (s->slice_hist[i]) {
+            int j;
+            for (j = 0; j < HIST_SIZE; j++)
+                av_freep(&s->slice_hist[i][j].entries);
+        }
+        av_freep(&s->slice_hist[i]);
+    }
     av_freep(&s->refs);
     av_frame_free(&s->prev_frame);
 }
@@ -556,6 +662,7 @@ static const AVFilterPad palettegen_inputs[] = {
         .name         = "default",
         .type         = AVMEDIA_TYPE_VIDEO,
         .filter_frame = filter_frame,
+        .config_props = config_input,
     },
     { NULL }
 };
@@ -579,4 +686,5 @@ AVFilter ff_vf_palettegen = {
     .inputs        = palettegen_inputs,
     .outputs       = palettegen_outputs,
     .priv_class    = &palettegen_class,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
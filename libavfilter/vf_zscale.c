@@ -45,6 +45,7 @@
 #include "libavutil/avassert.h"
 
 #define ZIMG_ALIGNMENT 32
+#define MAX_THREADS 64
 
 static const char *const var_names[] = {
     "in_w",   "iw",
@@ -114,13 +115,20 @@ typedef struct ZScaleContext {
 
     int force_original_aspect_ratio;
 
-    void *tmp;
-    size_t tmp_size;
+    int nb_threads;
+    int jobs_ret[MAX_THREADS];
+    int out_slice_start[MAX_THREADS];
+    int out_slice_end[MAX_THREADS];
+    double in_slice_start[MAX_THREADS];
+    double in_slice_end[MAX_THREADS];
+
+    void *tmp[MAX_THREADS];     ///< per slice scratch memory, sized for one band
+    size_t tmp_size[MAX_THREADS];
 
     zimg_image_format src_format, dst_format;
     zimg_image_format alpha_src_format, alpha_dst_format;
     zimg_graph_builder_params alpha_params, params;
-    zimg_filter_graph *alpha_graph, *graph;
+    zimg_filter_graph *alpha_graph[MAX_THREADS], *graph[MAX_THREADS];
 
     enum AVColorSpace in_colorspace, out_colorspace;
     enum AVColorTransferCharacteristic in_trc, out_trc;
@@ -506,6 +514,103 @@ static int graph_build(zimg_filter_graph **graph, zimg_graph_builder_params *par
     return 0;
 }
 
+/**
+ * Split the output frame into horizontal bands, one per slice graph. The
+ * bands are aligned to the chroma subsampling and each one maps to the
+ * corresponding (possibly fractional) band of the input.
+ */
+static void slice_params(ZScaleContext *s, const AVPixFmtDescriptor *desc,
+                         const AVPixFmtDescriptor *odesc, int out_h, int in_h)
+{
+    int i, align = 1 << FFMAX(desc->log2_chroma_h, odesc->log2_chroma_h);
+
+    s->out_slice_start[0] = 0;
+    for (i = 1; i < s->nb_threads; i++) {
+        int slice_end = FFALIGN(out_h * i / s->nb_threads, align);
+        s->out_slice_end[i - 1] = s->out_slice_start[i] = slice_end;
+    }
+    s->out_slice_end[s->nb_threads - 1] = out_h;
+
+    for (i = 0; i < s->nb_threads; i++) {
+        s->in_slice_start[i] = s->out_slice_start[i] * in_h / (double)out_h;
+        s->in_slice_end[i]   = s->out_slice_end[i]   * in_h / (double)out_h;
+    }
+}
+
+/**
+ * Build the graph of one band from the formats of the whole frame.
+ */
+static int slice_graph_build(ZScaleContext *s, int job, zimg_filter_graph **graph,
+                             zimg_graph_builder_params *params,
+                             const zimg_image_format *src_format,
+                             const zimg_image_format *dst_format)
+{
+    zimg_image_format src = *src_format;
+    zimg_image_format dst = *dst_format;
+
+    src.active_region.left   = 0;
+    src.active_region.top    = s->in_slice_start[job];
+    src.active_region.width  = src_format->width;
+    src.active_region.height = s->in_slice_end[job] - s->in_slice_start[job];
+
+    dst.height = s->out_slice_end[job] - s->out_slice_start[job];
+
+    return graph_build(graph, params, &src, &dst,
+                       &s->tmp[job], &s->tmp_size[job]);
+}
+
+typedef struct ThreadData {
+    const AVPixFmtDescriptor *desc, *odesc;
+    AVFrame *in, *out;
+} ThreadData;
+
+static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ZScaleContext *s = ctx->priv;
+    ThreadData *td = arg;
+    const AVPixFmtDescriptor *desc  = td->desc;
+    const AVPixFmtDescriptor *odesc = td->odesc;
+    zimg_image_buffer_const src_buf = { ZIMG_API_VERSION };
+    zimg_image_buffer dst_buf = { ZIMG_API_VERSION };
+    int ret, plane;
+
+    for (plane = 0; plane < 3; plane++) {
+        const int vsub = plane ? odesc->log2_chroma_h : 0;
+        int p = desc->comp[plane].plane;
+
+        src_buf.plane[plane].data   = td->in->data[p];
+        src_buf.plane[plane].stride = td->in->linesize[p];
+        src_buf.plane[plane].mask   = -1;
+
+        p = odesc->comp[plane].plane;
+        dst_buf.plane[plane].data   = td->out->data[p] +
+                                      (s->out_slice_start[jobnr] >> vsub) * td->out->linesize[p];
+        dst_buf.plane[plane].stride = td->out->linesize[p];
+        dst_buf.plane[plane].mask   = -1;
+    }
+
+    ret = zimg_filter_graph_process(s->graph[jobnr], &src_buf, &dst_buf, s->tmp[jobnr], 0, 0, 0, 0);
+    if (ret)
+        return print_zimg_error(ctx);
+
+    if (desc->flags & AV_PIX_FMT_FLAG_ALPHA && odesc->flags & AV_PIX_FMT_FLAG_ALPHA) {
+        src_buf.plane[0].data   = td->in->data[3];
+        src_buf.plane[0].stride = td->in->linesize[3];
+        src_buf.plane[0].mask   = -1;
+
+        dst_buf.plane[0].data   = td->out->data[3] +
+                                  s->out_slice_start[jobnr] * td->out->linesize[3];
+        dst_buf.plane[0].stride = td->out->linesize[3];
+        dst_buf.plane[0].mask   = -1;
+
+        ret = zimg_filter_graph_process(s->alpha_graph[jobnr], &src_buf, &dst_buf, s->tmp[jobnr], 0, 0, 0, 0);
+        if (ret)
+            return print_zimg_error(ctx);
+    }
+
+    return 0;
+}
+
 static int realign_frame(const AVPixFmtDescriptor *desc, AVFrame **frame)
 {
     AVFrame *aligned = NULL;
@@ -546,14 +651,14 @@ fail:
 
 static int filter_frame(AVFilterLink *link, AVFrame *in)
 {
-    ZScaleContext *s = link->dst->priv;
-    AVFilterLink *outlink = link->dst->outputs[0];
+    AVFilterContext *ctx = link->dst;
+    ZScaleContext *s = ctx->priv;
+    AVFilterLink *outlink = ctx->outputs[0];
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(link->format);
     const AVPixFmtDescriptor *odesc = av_pix_fmt_desc_get(outlink->format);
-    zimg_image_buffer_const src_buf = { ZIMG_API_VERSION };
-    zimg_image_buffer dst_buf = { ZIMG_API_VERSION };
+    ThreadData td;
     char buf[32];
-    int ret = 0, plane;
+    int ret = 0, i;
     AVFrame *out = NULL;
 
     if ((ret = realign_frame(desc, &in)) < 0)
@@ -626,10 +731,29 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
         if (s->chromal != -1)
             out->chroma_location = (int)s->dst_format.chroma_location - 1;
 
-        ret = graph_build(&s->graph, &s->params, &s->src_format, &s->dst_format,
-                          &s->tmp, &s->tmp_size);
-        if (ret < 0)
-            goto fail;
+        /* keep every band at least a few chroma rows high; the dither
+         * patterns and the error diffusion would restart at every band */
+        if (s->dither == ZIMG_DITHER_NONE)
+            s->nb_threads = av_clip(FFMIN(ff_filter_get_nb_threads(ctx),
+                                          out->height / (8 << odesc->log2_chroma_h)),
+                                    1, MAX_THREADS);
+        else
+            s->nb_threads = 1;
+        slice_params(s, desc, odesc, out->height, in->height);
+
+        for (i = 0; i < s->nb_threads; i++) {
+            ret = slice_graph_build(s, i, &s->graph[i], &s->params,
+                                    &s->src_format, &s->dst_format);
+            if (ret < 0)
+                goto fail;
+        }
+        for (; i < MAX_THREADS; i++) {
+            zimg_filter_graph_free(s->graph[i]);
+            zimg_filter_graph_free(s->alpha_graph[i]);
+            s->graph[i] = s->alpha_graph[i] = NULL;
+            av_freep(&s->tmp[i]);
+            s->tmp_size[i] = 0;
+        }
 
         s->in_colorspace  = in->colorspace;
         s->in_trc         = in->color_trc;
@@ -661,11 +785,11 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
             s->alpha_dst_format.pixel_type = (odesc->flags & AV_PIX_FMT_FLAG_FLOAT) ? ZIMG_PIXEL_FLOAT : odesc->comp[0].depth > 8 ? ZIMG_PIXEL_WORD : ZIMG_PIXEL_BYTE;
             s->alpha_dst_format.color_family = ZIMG_COLOR_GREY;
 
-            zimg_filter_graph_free(s->alpha_graph);
-            s->alpha_graph = zimg_filter_graph_build(&s->alpha_src_format, &s->alpha_dst_format, &s->alpha_params);
-            if (!s->alpha_graph) {
-                ret = print_zimg_error(link->dst);
-                goto fail;
+            for (i = 0; i < s->nb_threads; i++) {
+                ret = slice_graph_build(s, i, &s->alpha_graph[i], &s->alpha_params,
+                                        &s->alpha_src_format, &s->alpha_dst_format);
+                if (ret < 0)
+                    goto fail;
             }
         }
     }
@@ -687,39 +811,19 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
               (int64_t)in->sample_aspect_ratio.den * outlink->w * link->h,
               INT_MAX);
 
-    for (plane = 0; plane < 3; plane++) {
-        int p = desc->comp[plane].plane;
-        src_buf.plane[plane].data   = in->data[p];
-        src_buf.plane[plane].stride = in->linesize[p];
-        src_buf.plane[plane].mask   = -1;
-
-        p = odesc->comp[plane].plane;
-        dst_buf.plane[plane].data   = out->data[p];
-        dst_buf.plane[plane].stride = out->linesize[p];
-        dst_buf.plane[plane].mask   = -1;
-    }
-
-    ret = zimg_filter_graph_process(s->graph, &src_buf, &dst_buf, s->tmp, 0, 0, 0, 0);
-    if (ret) {
-        ret = print_zimg_error(link->dst);
-        goto fail;
-    }
-
-    if (desc->flags & AV_PIX_FMT_FLAG_ALPHA && odesc->flags & AV_PIX_FMT_FLAG_ALPHA) {
-        src_buf.plane[0].data   = in->data[3];
-        src_buf.plane[0].stride = in->linesize[3];
-        src_buf.plane[0].mask   = -1;
-
-        dst_buf.plane[0].data   = out->data[3];
-        dst_buf.plane[0].stride = out->linesize[3];
-        dst_buf.plane[0].mask   = -1;
-
-        ret = zimg_filter_graph_process(s->alpha_graph, &src_buf, &dst_buf, s->tmp, 0, 0, 0, 0);
-        if (ret) {
-            ret = print_zimg_error(link->dst);
+    td.desc  = desc;
+    td.odesc = odesc;
+    td.in    = in;
+    td.out   = out;
+    ctx->internal->execute(ctx, filter_slice, &td, s->jobs_ret, s->nb_threads);
+    for (i = 0; i < s->nb_threads; i++) {
+        if (s->jobs_ret[i] < 0) {
+            ret = s->jobs_ret[i];
             goto fail;
         }
-    } else if (odesc->flags & AV_PIX_FMT_FLAG_ALPHA) {
+    }
+
+    if (!(desc->flags & AV_PIX_FMT_FLAG_ALPHA) && odesc->flags & AV_PIX_FMT_FLAG_ALPHA) {
         int x, y;
 
         if (odesc->flags & AV_PIX_FMT_FLAG_FLOAT) {
@@ -748,11 +852,15 @@ fail:
 static av_cold void uninit(AVFilterContext *ctx)
 {
     ZScaleContext *s = ctx->priv;
-
-    zimg_filter_graph_free(s->graph);
-    zimg_filter_graph_free(s->alpha_graph);
-    av_freep(&s->tmp);
-    s->tmp_size = 0;
+    int i;
+
+    for (i = 0; i < MAX_THREADS; i++) {
+        zimg_filter_graph_free(s->graph[i]);
+        zimg_filter_graph_free(s->alpha_graph[i]);
+        s->graph[i] = s->alpha_graph[i] = NULL;
+        av_freep(&s->tmp[i]);
+        s->tmp_size[i] = 0;
+    }
 }
 
 static int process_command(AVFilterContext *ctx, const char *cmd, const char *args,
@@ -938,4 +1046,5 @@ AVFilter ff_vf_zscale = {
     .inputs          = avfilter_vf_zscale_inputs,
     .outputs         = avfilter_vf_zscale_outputs,
     .process_command = process_command,
+    .flags           = AVFILTER_FLAG_SLICE_THREADS,
 };
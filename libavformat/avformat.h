@@ -1855,6 +1855,42 @@ typedef struct AVFormatContext {
      * - decoding: set by user
      */
     int max_probe_packets;
+
+    /**
+     * Size in bytes of the buffer filled ahead of the demuxer by a
+     * background thread for each AVIOContext opened through io_open.
+     * 0 disables read-ahead.
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    int prefetch_size;
+
+    /**
+     * Path of a sidecar file caching the stream parameters and keyframe
+     * index of the input. If it matches the input, avformat_find_stream_info()
+     * returns the cached parameters without probing; it is (re)written by
+     * avformat_close_input() when it was missing, stale or incomplete.
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    char *index_cache;
+
+    /**
+     * Number of threads used to decode packets of different streams in
+     * parallel in avformat_find_stream_info(), 0 for one per CPU.
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    int probe_threads;
+
+    /**
+     * Maximum wall-clock time in microseconds that
+     * avformat_find_stream_info() spends reading and decoding packets,
+     * 0 for no limit.
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    int64_t max_probe_latency;
 } AVFormatContext;
 
 #if FF_API_FORMAT_GET_SET
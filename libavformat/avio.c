@@ -649,6 +649,13 @@ int ffurl_get_short_seek(URLContext *h)
     return h->prot->url_get_short_seek(h);
 }
 
+int ffurl_read_ref(URLContext *h, int64_t pos, int size, AVBufferRef **buf)
+{
+    if (!h || !h->prot || !h->prot->url_read_ref || !(h->flags & AVIO_FLAG_READ))
+        return AVERROR(ENOSYS);
+    return h->prot->url_read_ref(h, pos, size, buf);
+}
+
 int ffurl_shutdown(URLContext *h, int flags)
 {
     if (!h || !h->prot || !h->prot->url_shutdown)
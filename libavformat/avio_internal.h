@@ -53,6 +53,18 @@ int ffio_init_context(AVIOContext *s,
  */
 int ffio_read_indirect(AVIOContext *s, unsigned char *buf, int size, const unsigned char **data);
 
+/**
+ * Read size bytes from AVIOContext as a reference into memory owned by
+ * the protocol (see ffurl_read_ref()), avoiding any copy.
+ *
+ * On failure nothing is consumed and the caller is expected to fall back
+ * to avio_read().
+ *
+ * @param buf set to a read-only reference to the data on success
+ * @return size on success, a negative AVERROR code otherwise
+ */
+int ffio_read_ref(AVIOContext *s, AVBufferRef **buf, int size);
+
 void ffio_fill(AVIOContext *s, int b, int count);
 
 static av_always_inline void ffio_wfourcc(AVIOContext *pb, const uint8_t *s)
@@ -108,6 +120,24 @@ int ffio_ensure_seekback(AVIOContext *s, int64_t buf_size);
 
 int ffio_limit(AVIOContext *s, int size);
 
+/**
+ * Read ahead up to size bytes in a background thread.
+ *
+ * Only applies to read-only contexts opened on a URLContext. As the
+ * URLContext is then used by the background thread, it is no longer
+ * accessible through ffio_geturlcontext() or as AVOptions child.
+ *
+ * @return 0 on success, AVERROR(ENOSYS) if the context does not support it,
+ *         another negative AVERROR code on failure
+ */
+int ffio_prefetch_init(AVIOContext *s, int size);
+
+/**
+ * Stop reading ahead and restore the URLContext based callbacks.
+ * Does nothing if ffio_prefetch_init() was not called on s.
+ */
+void ffio_prefetch_uninit(AVIOContext *s);
+
 void ffio_init_checksum(AVIOContext *s,
                         unsigned long (*update_checksum)(unsigned long c, const uint8_t *p, unsigned int len),
                         unsigned long checksum);
@@ -45,7 +45,7 @@
 static void *ff_avio_child_next(void *obj, void *prev)
 {
     AVIOContext *s = obj;
-    return prev ? NULL : s->opaque;
+    return prev ? NULL : ffio_geturlcontext(s);
 }
 
 #if FF_API_CHILD_CLASS_NEXT
@@ -705,6 +705,41 @@ int ffio_read_indirect(AVIOContext *s, unsigned char *buf, int size, const unsig
     }
 }
 
+int ffio_read_ref(AVIOContext *s, AVBufferRef **buf, int size)
+{
+    URLContext *h = ffio_geturlcontext(s);
+    int buffered = s->buf_end - s->buf_ptr;
+    int64_t pos, res;
+    int ret;
+
+    if (!h || s->write_flag || s->update_checksum || size <= 0)
+        return AVERROR(ENOSYS);
+
+    pos = avio_tell(s);
+    if (pos < 0)
+        return pos;
+    ret = ffurl_read_ref(h, pos, size, buf);
+    if (ret < 0)
+        return ret;
+
+    if (size <= buffered) {
+        s->buf_ptr += size;
+    } else {
+        /* skip the rest without reading it through the buffer */
+        if ((res = s->seek(s->opaque, pos + size, SEEK_SET)) < 0) {
+            av_buffer_unref(buf);
+            return res;
+        }
+        s->seek_count++;
+        s->buf_ptr = s->buf_end = s->buf_ptr_max = s->buffer;
+        s->pos = pos + size;
+        s->bytes_read += size - buffered;
+        s->eof_reached = 0;
+    }
+
+    return size;
+}
+
 int avio_read_partial(AVIOContext *s, unsigned char *buf, int size)
 {
     int len;
@@ -1177,6 +1212,7 @@ int avio_close(AVIOContext *s)
     if (!s)
         return 0;
 
+    ffio_prefetch_uninit(s);
     avio_flush(s);
     h         = s->opaque;
     s->opaque = NULL;
@@ -35,6 +35,9 @@
 #endif
 #include <sys/stat.h>
 #include <stdlib.h>
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
 #include "os_support.h"
 #include "url.h"
 
@@ -74,6 +77,10 @@ typedef struct FileContext {
     int blocksize;
     int follow;
     int seekable;
+    int use_mmap;
+    AVBufferRef *map;       ///< whole file mapping, NULL if not mapped
+    int64_t map_file_size;  ///< size of the file when it was mapped
+    int64_t map_size;       ///< number of readable bytes in the mapping
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
@@ -84,6 +91,7 @@ static const AVOption file_options[] = {
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { "seekable", "Sets if the file is seekable", offsetof(FileContext, seekable), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, 0, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "mmap", "Map the file into memory and export packet data without copying", offsetof(FileContext, use_mmap), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { NULL }
 };
 
@@ -205,6 +213,101 @@ static int file_move(URLContext *h_src, URLContext *h_dst)
 
 #if CONFIG_FILE_PROTOCOL
 
+#if HAVE_MMAP
+static void file_unmap(void *opaque, uint8_t *data)
+{
+    size_t *size = opaque;
+    munmap(data, *size);
+    av_free(size);
+}
+
+static int file_map(URLContext *h)
+{
+    FileContext *c = h->priv_data;
+    long page_size = sysconf(_SC_PAGESIZE);
+    struct stat st;
+    size_t *size;
+    void *map;
+    int ret;
+
+    if (c->follow || h->is_streamed)
+        return AVERROR(ENOSYS);
+    if (fstat(c->fd, &st) < 0)
+        return AVERROR(errno);
+    if (!S_ISREG(st.st_mode) || st.st_size <= 0 || page_size <= 0 ||
+        st.st_size > SIZE_MAX - page_size)
+        return AVERROR(ENOSYS);
+
+    size = av_malloc(sizeof(*size));
+    if (!size)
+        return AVERROR(ENOMEM);
+    *size = st.st_size;
+
+    map = mmap(NULL, *size, PROT_READ, MAP_SHARED, c->fd, 0);
+    if (map == MAP_FAILED) {
+        ret = AVERROR(errno);
+        av_free(size);
+        return ret;
+    }
+
+    /* Only keeps the mapping alive, packets get buffers of their own which
+     * reference it, so the size of this one does not limit the file size. */
+    c->map = av_buffer_create(map, FFMIN(st.st_size, INT_MAX), file_unmap,
+                              size, AV_BUFFER_FLAG_READONLY);
+    if (!c->map) {
+        munmap(map, *size);
+        av_free(size);
+        return AVERROR(ENOMEM);
+    }
+    /* The tail of the last page reads as zeroes, so it can serve as
+     * padding for packets that end close to the end of the file. */
+    c->map_file_size = st.st_size;
+    c->map_size      = FFALIGN(st.st_size, page_size);
+
+    return 0;
+}
+
+static void file_unref_map(void *opaque, uint8_t *data)
+{
+    AVBufferRef *map = opaque;
+    av_buffer_unref(&map);
+}
+
+static int file_read_ref(URLContext *h, int64_t pos, int size, AVBufferRef **buf)
+{
+    FileContext *c = h->priv_data;
+    AVBufferRef *map;
+    struct stat st;
+
+    if (!c->map || pos < 0 || size <= 0 ||
+        pos > c->map_file_size - size)
+        return AVERROR(ENOSYS);
+    /* the padding may extend past the end of the file, but not the mapping */
+    if (pos + size > c->map_size - AV_INPUT_BUFFER_PADDING_SIZE)
+        return AVERROR(ENOSYS);
+
+    /* Pages past the end of a truncated file cannot be accessed, stop
+     * using the mapping before handing out any of them. */
+    if (fstat(c->fd, &st) < 0 || st.st_size < c->map_file_size) {
+        av_log(h, AV_LOG_WARNING, "File was truncated, falling back to read()\n");
+        av_buffer_unref(&c->map);
+        return AVERROR(ENOSYS);
+    }
+
+    map = av_buffer_ref(c->map);
+    if (!map)
+        return AVERROR(ENOMEM);
+    *buf = av_buffer_create(c->map->data + pos, size, file_unref_map, map,
+                            AV_BUFFER_FLAG_READONLY);
+    if (!*buf) {
+        av_buffer_unref(&map);
+        return AVERROR(ENOMEM);
+    }
+
+    return size;
+}
+#endif
+
 static int file_open(URLContext *h, const char *filename, int flags)
 {
     FileContext *c = h->priv_data;
@@ -243,6 +346,15 @@ static int file_open(URLContext *h, const char *filename, int flags)
     if (c->seekable >= 0)
         h->is_streamed = !c->seekable;
 
+#if HAVE_MMAP
+    if (c->use_mmap && !(flags & AVIO_FLAG_WRITE)) {
+        int ret = file_map(h);
+        if (ret < 0)
+            av_log(h, AV_LOG_WARNING, "Cannot map '%s', falling back to read(): %s\n",
+                   filename, av_err2str(ret));
+    }
+#endif
+
     return 0;
 }
 
@@ -266,6 +378,8 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
 static int file_close(URLContext *h)
 {
     FileContext *c = h->priv_data;
+    /* packets may still reference the mapping, it is unmapped with the last one */
+    av_buffer_unref(&c->map);
     return close(c->fd);
 }
 
@@ -364,6 +478,9 @@ const URLProtocol ff_file_protocol = {
     .url_check           = file_check,
     .url_delete          = file_delete,
     .url_move            = file_move,
+#if HAVE_MMAP
+    .url_read_ref        = file_read_ref,
+#endif
     .priv_data_size      = sizeof(FileContext),
     .priv_data_class     = &file_class,
     .url_open_dir        = file_open_dir,
@@ -33,6 +33,7 @@
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
 #include "libavutil/dict.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "avformat.h"
 #include "internal.h"
@@ -40,6 +41,7 @@
 #include "id3v2.h"
 
 #define INITIAL_BUFFER_SIZE 32768
+#define PREFETCH_CHUNK_SIZE 65536
 
 #define MAX_FIELD_LEN 64
 #define MAX_CHARACTERISTICS_LEN 512
@@ -77,6 +79,31 @@ struct segment {
     struct segment *init_section;
 };
 
+/*
+ * A segment downloaded into memory ahead of time by a background thread.
+ * The fields below the lock are protected by HLSContext.prefetch_lock.
+ */
+struct segment_prefetch {
+    struct HLSContext *hls;
+    int64_t seq_no;
+    char *url;
+    int64_t url_offset;
+    int64_t size;
+    AVDictionary *avio_opts; /* copy of HLSContext.avio_opts, gets the new cookies */
+    AVDictionary *opts;   /* options of this request */
+    int in_use;           /* being read by the demuxer */
+#if HAVE_THREADS
+    pthread_t thread;
+#endif
+
+    uint8_t *buf;
+    int64_t buf_size;
+    int64_t len;          /* bytes downloaded so far */
+    int done;
+    int error;
+    int abort;
+};
+
 struct rendition;
 
 enum PlaylistType {
@@ -98,6 +125,9 @@ struct playlist {
     int input_read_done;
     AVIOContext *input_next;
     int input_next_requested;
+    struct segment_prefetch **prefetches;
+    int n_prefetches;
+    struct segment_prefetch *cur_prefetch; /* source of the current segment */
     AVFormatContext *parent;
     int index;
     AVFormatContext *ctx;
@@ -213,8 +243,312 @@ typedef struct HLSContext {
     int http_multiple;
     int http_seekable;
     AVIOContext *playlist_pb;
+    int prefetch_segments;
+    int64_t prefetch_max_size;
+    int64_t prefetch_bytes;  /* downloaded bytes in all prefetch buffers */
+#if HAVE_THREADS
+    pthread_mutex_t prefetch_lock;
+    pthread_cond_t prefetch_cond;
+#endif
 } HLSContext;
 
+static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
+                    AVDictionary **opts, AVDictionary *opts2, int *is_http_out);
+
+#if HAVE_THREADS
+static int segment_prefetch_interrupt(void *opaque)
+{
+    struct segment_prefetch *p = opaque;
+
+    return p->abort || ff_check_interrupt(p->hls->interrupt_callback);
+}
+
+static void *segment_prefetch_task(void *arg)
+{
+    struct segment_prefetch *p = arg;
+    HLSContext *c = p->hls;
+    AVFormatContext *s = c->ctx;
+    AVIOInterruptCB cb = { segment_prefetch_interrupt, p };
+    AVIOContext *in = NULL;
+    URLContext *h;
+    uint8_t *chunk;
+    int ret, is_http = 0;
+
+    chunk = av_malloc(PREFETCH_CHUNK_SIZE);
+    if (!chunk) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    /* The cookies set by the server go to p->avio_opts, they are merged into
+     * c->avio_opts by the demuxer thread once the segment is consumed. */
+    ret = open_url(s, &in, p->url, &p->avio_opts, p->opts, &is_http);
+    if (ret < 0)
+        goto end;
+    /* io_open() only knows the interrupt callback of the demuxer, make the
+     * transfer stop as well when the prefetch is cancelled */
+    if ((h = ffio_geturlcontext(in)))
+        h->interrupt_callback = cb;
+    if (p->url_offset && !is_http) {
+        int64_t seekret = avio_seek(in, p->url_offset, SEEK_SET);
+        if (seekret < 0) {
+            ret = seekret;
+            goto end;
+        }
+    }
+
+    while (1) {
+        int size = PREFETCH_CHUNK_SIZE;
+
+        pthread_mutex_lock(&c->prefetch_lock);
+        /* the segment being demuxed is never held back by the memory cap */
+        while (!p->abort && !p->in_use &&
+               c->prefetch_bytes >= c->prefetch_max_size)
+            pthread_cond_wait(&c->prefetch_cond, &c->prefetch_lock);
+        if (p->abort) {
+            pthread_mutex_unlock(&c->prefetch_lock);
+            ret = AVERROR_EXIT;
+            break;
+        }
+        if (p->size >= 0)
+            size = FFMIN(size, p->size - p->len);
+        pthread_mutex_unlock(&c->prefetch_lock);
+
+        if (size <= 0) {
+            ret = AVERROR_EOF;
+            break;
+        }
+        ret = avio_read_partial(in, chunk, size);
+        if (ret <= 0) {
+            if (!ret)
+                ret = AVERROR_EOF;
+            break;
+        }
+
+        pthread_mutex_lock(&c->prefetch_lock);
+        if (p->len + ret > p->buf_size) {
+            int64_t new_size = FFMAX(2 * p->buf_size, p->len + ret);
+            uint8_t *new_buf = av_realloc(p->buf, new_size);
+            if (!new_buf) {
+                pthread_mutex_unlock(&c->prefetch_lock);
+                ret = AVERROR(ENOMEM);
+                break;
+            }
+            p->buf      = new_buf;
+            p->buf_size = new_size;
+        }
+        memcpy(p->buf + p->len, chunk, ret);
+        p->len            += ret;
+        c->prefetch_bytes += ret;
+        pthread_cond_broadcast(&c->prefetch_cond);
+        pthread_mutex_unlock(&c->prefetch_lock);
+    }
+
+end:
+    ff_format_io_close(s, &in);
+    av_free(chunk);
+
+    pthread_mutex_lock(&c->prefetch_lock);
+    p->error = ret == AVERROR_EOF ? 0 : ret;
+    p->done  = 1;
+    pthread_cond_broadcast(&c->prefetch_cond);
+    pthread_mutex_unlock(&c->prefetch_lock);
+
+    return NULL;
+}
+
+static void free_segment_prefetch(HLSContext *c, struct segment_prefetch **pp)
+{
+    struct segment_prefetch *p = *pp;
+
+    if (!p)
+        return;
+
+    pthread_mutex_lock(&c->prefetch_lock);
+    p->abort = 1;
+    pthread_cond_broadcast(&c->prefetch_cond);
+    pthread_mutex_unlock(&c->prefetch_lock);
+
+    pthread_join(p->thread, NULL);
+
+    if (p->in_use) {
+        AVDictionaryEntry *cookies = av_dict_get(p->avio_opts, "cookies", NULL, 0);
+        if (cookies)
+            av_dict_set(&c->avio_opts, "cookies", cookies->value, 0);
+    }
+
+    pthread_mutex_lock(&c->prefetch_lock);
+    c->prefetch_bytes -= p->len;
+    pthread_cond_broadcast(&c->prefetch_cond);
+    pthread_mutex_unlock(&c->prefetch_lock);
+
+    av_freep(&p->buf);
+    av_freep(&p->url);
+    av_dict_free(&p->avio_opts);
+    av_dict_free(&p->opts);
+    av_freep(pp);
+}
+
+static void cancel_prefetches(HLSContext *c, struct playlist *pls)
+{
+    int i;
+
+    free_segment_prefetch(c, &pls->cur_prefetch);
+    for (i = 0; i < pls->n_prefetches; i++)
+        free_segment_prefetch(c, &pls->prefetches[i]);
+    av_freep(&pls->prefetches);
+    pls->n_prefetches = 0;
+}
+
+static int start_segment_prefetch(HLSContext *c, struct playlist *pls,
+                                  int64_t seq_no)
+{
+    struct segment *seg = pls->segments[seq_no - pls->start_seq_no];
+    struct segment_prefetch *p;
+    int ret;
+
+    p = av_mallocz(sizeof(*p));
+    if (!p)
+        return AVERROR(ENOMEM);
+    p->hls        = c;
+    p->seq_no     = seq_no;
+    p->url_offset = seg->url_offset;
+    p->size       = seg->size;
+    p->url        = av_strdup(seg->url);
+    if (!p->url) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    if ((ret = av_dict_copy(&p->avio_opts, c->avio_opts, 0)) < 0)
+        goto fail;
+    if (seg->size >= 0) {
+        av_dict_set_int(&p->opts, "offset", seg->url_offset, 0);
+        av_dict_set_int(&p->opts, "end_offset", seg->url_offset + seg->size, 0);
+    }
+
+    av_log(pls->parent, AV_LOG_VERBOSE, "HLS prefetch for url '%s', offset %"PRId64", playlist %d\n",
+           seg->url, seg->url_offset, pls->index);
+
+    if ((ret = av_dynarray_add_nofree(&pls->prefetches, &pls->n_prefetches, p)) < 0)
+        goto fail;
+    if ((ret = pthread_create(&p->thread, NULL, segment_prefetch_task, p))) {
+        pls->n_prefetches--;
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    return 0;
+
+fail:
+    av_freep(&p->url);
+    av_dict_free(&p->avio_opts);
+    av_dict_free(&p->opts);
+    av_free(p);
+    return ret;
+}
+
+/* Keep downloads running for the segments following the current one. */
+static void schedule_prefetch(HLSContext *c, struct playlist *pls)
+{
+    int64_t seq_no, end_seq_no;
+    int i, j;
+
+    end_seq_no = FFMIN(pls->cur_seq_no + c->prefetch_segments,
+                       pls->start_seq_no + pls->n_segments - 1);
+
+    for (i = 0; i < pls->n_prefetches; ) {
+        struct segment_prefetch *p = pls->prefetches[i];
+        if (p->seq_no > pls->cur_seq_no && p->seq_no <= end_seq_no) {
+            i++;
+            continue;
+        }
+        free_segment_prefetch(c, &pls->prefetches[i]);
+        pls->prefetches[i] = pls->prefetches[--pls->n_prefetches];
+    }
+
+    for (seq_no = pls->cur_seq_no + 1; seq_no <= end_seq_no; seq_no++) {
+        struct segment *seg = pls->segments[seq_no - pls->start_seq_no];
+
+        if (seg->key_type != KEY_NONE)
+            continue;
+        for (j = 0; j < pls->n_prefetches; j++)
+            if (pls->prefetches[j]->seq_no == seq_no)
+                break;
+        if (j < pls->n_prefetches)
+            continue;
+        if (start_segment_prefetch(c, pls, seq_no) < 0) {
+            av_log(pls->parent, AV_LOG_WARNING, "Failed to start prefetching "
+                   "segment %"PRId64" of playlist %d\n", seq_no, pls->index);
+            break;
+        }
+    }
+}
+
+/* Move the prefetch of the current segment, if any, to cur_prefetch. */
+static int take_segment_prefetch(HLSContext *c, struct playlist *pls)
+{
+    int i;
+
+    for (i = 0; i < pls->n_prefetches; i++) {
+        struct segment_prefetch *p = pls->prefetches[i];
+        if (p->seq_no != pls->cur_seq_no)
+            continue;
+        pls->prefetches[i] = pls->prefetches[--pls->n_prefetches];
+        pls->cur_prefetch  = p;
+        pls->cur_seg_offset = 0;
+
+        pthread_mutex_lock(&c->prefetch_lock);
+        p->in_use = 1;
+        pthread_cond_broadcast(&c->prefetch_cond);
+        pthread_mutex_unlock(&c->prefetch_lock);
+        return 1;
+    }
+    return 0;
+}
+
+static int read_from_prefetch(HLSContext *c, struct playlist *pls,
+                              uint8_t *buf, int buf_size)
+{
+    struct segment_prefetch *p = pls->cur_prefetch;
+    int ret;
+
+    pthread_mutex_lock(&c->prefetch_lock);
+    while (p->len <= pls->cur_seg_offset && !p->done)
+        pthread_cond_wait(&c->prefetch_cond, &c->prefetch_lock);
+    if (p->len > pls->cur_seg_offset) {
+        ret = FFMIN(buf_size, p->len - pls->cur_seg_offset);
+        memcpy(buf, p->buf + pls->cur_seg_offset, ret);
+    } else {
+        ret = p->error ? p->error : AVERROR_EOF;
+    }
+    pthread_mutex_unlock(&c->prefetch_lock);
+
+    return ret;
+}
+#else
+static void free_segment_prefetch(HLSContext *c, struct segment_prefetch **pp)
+{
+}
+
+static void cancel_prefetches(HLSContext *c, struct playlist *pls)
+{
+}
+
+static void schedule_prefetch(HLSContext *c, struct playlist *pls)
+{
+}
+
+static int take_segment_prefetch(HLSContext *c, struct playlist *pls)
+{
+    return 0;
+}
+
+static int read_from_prefetch(HLSContext *c, struct playlist *pls,
+                              uint8_t *buf, int buf_size)
+{
+    return AVERROR(ENOSYS);
+}
+#endif /* HAVE_THREADS */
+
 static void free_segment_dynarray(struct segment **segments, int n_segments)
 {
     int i;
@@ -258,6 +592,7 @@ static void free_playlist_list(HLSContext *c)
         av_freep(&pls->init_sec_buf);
         av_packet_unref(&pls->pkt);
         av_freep(&pls->pb.buffer);
+        cancel_prefetches(c, pls);
         ff_format_io_close(c->ctx, &pls->input);
         pls->input_read_done = 0;
         ff_format_io_close(c->ctx, &pls->input_next);
@@ -1014,7 +1349,10 @@ static int read_from_url(struct playlist *pls, struct segment *seg,
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, seg->size - pls->cur_seg_offset);
 
-    ret = avio_read(pls->input, buf, buf_size);
+    if (pls->cur_prefetch)
+        ret = read_from_prefetch(pls->parent->priv_data, pls, buf, buf_size);
+    else
+        ret = avio_read(pls->input, buf, buf_size);
     if (ret > 0)
         pls->cur_seg_offset += ret;
 
@@ -1429,7 +1767,8 @@ restart:
     if (!v->needed)
         return AVERROR_EOF;
 
-    if (!v->input || (c->http_persistent && v->input_read_done)) {
+    if ((!v->input && !v->cur_prefetch) ||
+        (c->http_persistent && v->input_read_done)) {
         int64_t reload_interval;
 
         /* Check that the playlist is still needed before opening a new
@@ -1500,7 +1839,12 @@ reload:
         if (ret)
             return ret;
 
-        if (c->http_multiple == 1 && v->input_next_requested) {
+        if (take_segment_prefetch(c, v)) {
+            /* the connection kept open for the next request is not used */
+            ff_format_io_close(v->parent, &v->input);
+            v->input_read_done = 0;
+            ret = 0;
+        } else if (c->http_multiple == 1 && v->input_next_requested) {
             FFSWAP(AVIOContext *, v->input, v->input_next);
             v->cur_seg_offset = 0;
             v->input_next_requested = 0;
@@ -1518,9 +1862,12 @@ reload:
             goto reload;
         }
         just_opened = 1;
+
+        if (c->prefetch_segments > 0)
+            schedule_prefetch(c, v);
     }
 
-    if (c->http_multiple == -1) {
+    if (c->http_multiple == -1 && v->input) {
         uint8_t *http_version_opt = NULL;
         int r = av_opt_get(v->input, "http_version", AV_OPT_SEARCH_CHILDREN, &http_version_opt);
         if (r >= 0) {
@@ -1531,7 +1878,7 @@ reload:
 
     seg = next_segment(v);
     if (c->http_multiple == 1 && !v->input_next_requested &&
-        seg && seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
+        c->prefetch_segments <= 0 && seg && seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         ret = open_input(c, v, seg, &v->input_next);
         if (ret < 0) {
             if (ff_check_interrupt(c->interrupt_callback))
@@ -1563,7 +1910,12 @@ reload:
 
         return ret;
     }
-    if (c->http_persistent &&
+    if (v->cur_prefetch) {
+        if (ret < 0 && ret != AVERROR_EXIT)
+            av_log(v->parent, AV_LOG_WARNING, "Failed to prefetch segment %"PRId64" of playlist %d\n",
+                   v->cur_seq_no, v->index);
+        free_segment_prefetch(c, &v->cur_prefetch);
+    } else if (c->http_persistent &&
         seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         v->input_read_done = 1;
     } else {
@@ -1845,6 +2197,13 @@ static int hls_close(AVFormatContext *s)
     av_dict_free(&c->avio_opts);
     ff_format_io_close(c->ctx, &c->playlist_pb);
 
+#if HAVE_THREADS
+    if (c->prefetch_segments > 0) {
+        pthread_cond_destroy(&c->prefetch_cond);
+        pthread_mutex_destroy(&c->prefetch_lock);
+    }
+#endif
+
     return 0;
 }
 
@@ -1861,6 +2220,22 @@ static int hls_read_header(AVFormatContext *s)
     c->first_timestamp = AV_NOPTS_VALUE;
     c->cur_timestamp = AV_NOPTS_VALUE;
 
+#if HAVE_THREADS
+    if (c->prefetch_segments > 0) {
+        if ((ret = pthread_mutex_init(&c->prefetch_lock, NULL)))
+            return AVERROR(ret);
+        if ((ret = pthread_cond_init(&c->prefetch_cond, NULL))) {
+            pthread_mutex_destroy(&c->prefetch_lock);
+            return AVERROR(ret);
+        }
+    }
+#else
+    if (c->prefetch_segments > 0) {
+        av_log(s, AV_LOG_WARNING, "Segment prefetching requires threads, disabling it\n");
+        c->prefetch_segments = 0;
+    }
+#endif
+
     if ((ret = save_avio_options(s)) < 0)
         goto fail;
 
@@ -2087,6 +2462,7 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
             }
             av_log(s, AV_LOG_INFO, "Now receiving playlist %d, segment %"PRId64"\n", i, pls->cur_seq_no);
         } else if (first && !cur_needed && pls->needed) {
+            cancel_prefetches(c, pls);
             ff_format_io_close(pls->parent, &pls->input);
             pls->input_read_done = 0;
             ff_format_io_close(pls->parent, &pls->input_next);
@@ -2327,6 +2703,7 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
     for (i = 0; i < c->n_playlists; i++) {
         /* Reset reading */
         struct playlist *pls = c->playlists[i];
+        cancel_prefetches(c, pls);
         ff_format_io_close(pls->parent, &pls->input);
         pls->input_read_done = 0;
         ff_format_io_close(pls->parent, &pls->input_next);
@@ -2392,6 +2769,10 @@ static const AVOption hls_options[] = {
         OFFSET(http_multiple), AV_OPT_TYPE_BOOL, {.i64 = -1}, -1, 1, FLAGS},
     {"http_seekable", "Use HTTP partial requests, 0 = disable, 1 = enable, -1 = auto",
         OFFSET(http_seekable), AV_OPT_TYPE_BOOL, { .i64 = -1}, -1, 1, FLAGS},
+    {"prefetch_segments", "Number of segments to download in parallel ahead of the current one",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 64, FLAGS},
+    {"prefetch_max_size", "Maximum amount of memory used for prefetched segments",
+        OFFSET(prefetch_max_size), AV_OPT_TYPE_INT64, {.i64 = 64 << 20}, 0, INT64_MAX, FLAGS},
     {NULL}
 };
 
@@ -0,0 +1,549 @@
+/*
+ * Sidecar index cache for demuxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Sidecar index cache for demuxers.
+ *
+ * The cache file stores the stream parameters found by
+ * avformat_find_stream_info() and the keyframes seen while demuxing, so
+ * that reopening the same input can skip probing, and seeks into a part of
+ * the input that was read before go straight to the right keyframe instead
+ * of bisecting the file with read_timestamp().
+ *
+ * It is keyed by the size and modification time of the input and by a CRC
+ * of its first and last KEY_CHUNK_SIZE bytes; a cache that does not match
+ * is ignored and replaced when the input is closed.
+ *
+ * All values are big-endian:
+ *   tag 'FFIX', version, key (size, mtime, crc), demuxer name,
+ *   flags, duration, start_time, bit_rate, number of streams,
+ *   then for each stream its id, time base, timing, codec parameters
+ *   and keyframe index entries.
+ */
+
+#include <sys/stat.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/crc.h"
+#include "libavutil/mem.h"
+#include "libavutil/random_seed.h"
+#include "avformat.h"
+#include "avio_internal.h"
+#include "internal.h"
+#include "os_support.h"
+
+#define INDEX_CACHE_TAG     MKBETAG('F', 'F', 'I', 'X')
+#define INDEX_CACHE_VERSION 1
+#define KEY_CHUNK_SIZE      65536
+#define MAX_EXTRADATA_SIZE  (1 << 28)
+
+/* the cache holds valid codec parameters for all streams */
+#define FLAG_HAVE_PARAMS 1
+
+typedef struct CachedStream {
+    int id;
+    AVRational time_base;
+    int64_t start_time;
+    int64_t duration;
+    int64_t nb_frames;
+    int disposition;
+    AVRational sample_aspect_ratio;
+    AVRational avg_frame_rate;
+    AVRational r_frame_rate;
+    AVCodecParameters *par;
+
+    AVIndexEntry *entries;
+    int nb_entries;
+} CachedStream;
+
+/**
+ * Only demuxers without a read_seek() callback go through the generic seeking
+ * code, the others have their own index (e.g. mov) or seek natively.
+ */
+static int caches_index(const AVFormatContext *s)
+{
+    return !s->iformat->read_seek;
+}
+
+static int64_t input_mtime(const AVFormatContext *s)
+{
+    const char *proto = avio_find_protocol_name(s->url);
+    const char *path  = s->url;
+    struct stat st;
+
+    if (!proto || strcmp(proto, "file"))
+        return 0;
+    av_strstart(path, "file:", &path);
+    if (stat(path, &st) < 0)
+        return 0;
+    return st.st_mtime;
+}
+
+static int compute_key(AVFormatContext *s)
+{
+    AVFormatInternal *internal = s->internal;
+    const AVCRC *crc_table = av_crc_get_table(AV_CRC_32_IEEE_LE);
+    AVIOContext *pb = s->pb;
+    int64_t pos = avio_tell(pb);
+    int64_t size, offset[2];
+    uint32_t crc = 0;
+    uint8_t *buf;
+    int i, ret = 0;
+
+    if (!(pb->seekable & AVIO_SEEKABLE_NORMAL) || (size = avio_size(pb)) <= 0)
+        return AVERROR(ENOSYS);
+
+    buf = av_malloc(KEY_CHUNK_SIZE);
+    if (!buf)
+        return AVERROR(ENOMEM);
+
+    offset[0] = 0;
+    offset[1] = FFMAX(size - KEY_CHUNK_SIZE, KEY_CHUNK_SIZE);
+    for (i = 0; i < 2 && offset[i] < size; i++) {
+        int len = FFMIN(KEY_CHUNK_SIZE, size - offset[i]);
+        if ((ret = avio_seek(pb, offset[i], SEEK_SET)) < 0)
+            break;
+        if ((ret = ffio_read_size(pb, buf, len)) < 0)
+            break;
+        crc = av_crc(crc_table, crc, buf, len);
+    }
+    av_free(buf);
+
+    if (avio_seek(pb, pos, SEEK_SET) < 0)
+        return AVERROR(EIO);
+    if (ret < 0)
+        return ret;
+
+    internal->index_cache_size  = size;
+    internal->index_cache_mtime = input_mtime(s);
+    internal->index_cache_crc   = crc;
+    internal->index_cache_valid = 1;
+    return 0;
+}
+
+static void write_rational(AVIOContext *pb, AVRational q)
+{
+    avio_wb32(pb, q.num);
+    avio_wb32(pb, q.den);
+}
+
+static AVRational read_rational(AVIOContext *pb)
+{
+    AVRational q;
+    q.num = avio_rb32(pb);
+    q.den = avio_rb32(pb);
+    return q;
+}
+
+static void write_codecpar(AVIOContext *pb, const AVCodecParameters *par)
+{
+    avio_wb32(pb, par->codec_type);
+    avio_wb32(pb, par->codec_id);
+    avio_wb32(pb, par->codec_tag);
+    avio_wb32(pb, par->format);
+    avio_wb64(pb, par->bit_rate);
+    avio_wb32(pb, par->bits_per_coded_sample);
+    avio_wb32(pb, par->bits_per_raw_sample);
+    avio_wb32(pb, par->profile);
+    avio_wb32(pb, par->level);
+    avio_wb32(pb, par->width);
+    avio_wb32(pb, par->height);
+    write_rational(pb, par->sample_aspect_ratio);
+    avio_wb32(pb, par->field_order);
+    avio_wb32(pb, par->color_range);
+    avio_wb32(pb, par->color_primaries);
+    avio_wb32(pb, par->color_trc);
+    avio_wb32(pb, par->color_space);
+    avio_wb32(pb, par->chroma_location);
+    avio_wb32(pb, par->video_delay);
+    avio_wb64(pb, par->channel_layout);
+    avio_wb32(pb, par->channels);
+    avio_wb32(pb, par->sample_rate);
+    avio_wb32(pb, par->block_align);
+    avio_wb32(pb, par->frame_size);
+    avio_wb32(pb, par->initial_padding);
+    avio_wb32(pb, par->trailing_padding);
+    avio_wb32(pb, par->seek_preroll);
+    avio_wb32(pb, par->extradata_size);
+    avio_write(pb, par->extradata, par->extradata_size);
+}
+
+static int read_codecpar(AVIOContext *pb, AVCodecParameters *par)
+{
+    int size;
+
+    par->codec_type            = avio_rb32(pb);
+    par->codec_id              = avio_rb32(pb);
+    par->codec_tag             = avio_rb32(pb);
+    par->format                = avio_rb32(pb);
+    par->bit_rate              = avio_rb64(pb);
+    par->bits_per_coded_sample = avio_rb32(pb);
+    par->bits_per_raw_sample   = avio_rb32(pb);
+    par->profile               = avio_rb32(pb);
+    par->level                 = avio_rb32(pb);
+    par->width                 = avio_rb32(pb);
+    par->height                = avio_rb32(pb);
+    par->sample_aspect_ratio   = read_rational(pb);
+    par->field_order           = avio_rb32(pb);
+    par->color_range           = avio_rb32(pb);
+    par->color_primaries       = avio_rb32(pb);
+    par->color_trc             = avio_rb32(pb);
+    par->color_space           = avio_rb32(pb);
+    par->chroma_location       = avio_rb32(pb);
+    par->video_delay           = avio_rb32(pb);
+    par->channel_layout        = avio_rb64(pb);
+    par->channels              = avio_rb32(pb);
+    par->sample_rate           = avio_rb32(pb);
+    par->block_align           = avio_rb32(pb);
+    par->frame_size            = avio_rb32(pb);
+    par->initial_padding       = avio_rb32(pb);
+    par->trailing_padding      = avio_rb32(pb);
+    par->seek_preroll          = avio_rb32(pb);
+
+    size = avio_rb32(pb);
+    if (size < 0 || size > MAX_EXTRADATA_SIZE)
+        return AVERROR_INVALIDDATA;
+    if (size) {
+        int ret;
+        par->extradata = av_mallocz(size + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (!par->extradata)
+            return AVERROR(ENOMEM);
+        par->extradata_size = size;
+        if ((ret = ffio_read_size(pb, par->extradata, size)) < 0)
+            return ret;
+    }
+    return 0;
+}
+
+static void free_cached_streams(CachedStream *cs, int nb_streams)
+{
+    int i;
+
+    if (!cs)
+        return;
+    for (i = 0; i < nb_streams; i++) {
+        avcodec_parameters_free(&cs[i].par);
+        av_freep(&cs[i].entries);
+    }
+    av_free(cs);
+}
+
+static int read_cached_stream(AVIOContext *pb, CachedStream *cs)
+{
+    int i, ret;
+
+    cs->id                  = avio_rb32(pb);
+    cs->time_base           = read_rational(pb);
+    cs->start_time          = avio_rb64(pb);
+    cs->duration            = avio_rb64(pb);
+    cs->nb_frames           = avio_rb64(pb);
+    cs->disposition         = avio_rb32(pb);
+    cs->sample_aspect_ratio = read_rational(pb);
+    cs->avg_frame_rate      = read_rational(pb);
+    cs->r_frame_rate        = read_rational(pb);
+
+    if (!(cs->par = avcodec_parameters_alloc()))
+        return AVERROR(ENOMEM);
+    if ((ret = read_codecpar(pb, cs->par)) < 0)
+        return ret;
+
+    cs->nb_entries = avio_rb32(pb);
+    if (avio_feof(pb) || cs->nb_entries < 0 ||
+        cs->nb_entries > (avio_size(pb) - avio_tell(pb)) / 28)
+        return AVERROR_INVALIDDATA;
+    if (!cs->nb_entries)
+        return 0;
+    cs->entries = av_malloc_array(cs->nb_entries, sizeof(*cs->entries));
+    if (!cs->entries)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < cs->nb_entries; i++) {
+        AVIndexEntry *e = &cs->entries[i];
+        e->pos          = avio_rb64(pb);
+        e->timestamp    = avio_rb64(pb);
+        e->size         = avio_rb32(pb) & 0x3FFFFFFF;
+        e->min_distance = avio_rb32(pb);
+        e->flags        = avio_rb32(pb) & 3;
+    }
+    return pb->error ? pb->error : avio_feof(pb) ? AVERROR_INVALIDDATA : 0;
+}
+
+static int params_match(AVFormatContext *s, const CachedStream *cs, int nb_streams)
+{
+    int i;
+
+    if (nb_streams != s->nb_streams)
+        return 0;
+    for (i = 0; i < nb_streams; i++) {
+        const AVStream *st = s->streams[i];
+        if (st->id != cs[i].id ||
+            av_cmp_q(st->time_base, cs[i].time_base) ||
+            st->codecpar->codec_type != cs[i].par->codec_type ||
+            (st->codecpar->codec_id != AV_CODEC_ID_NONE &&
+             st->codecpar->codec_id != cs[i].par->codec_id))
+            return 0;
+    }
+    return 1;
+}
+
+int ff_index_cache_load(AVFormatContext *s)
+{
+    AVFormatInternal *internal = s->internal;
+    CachedStream *cs = NULL;
+    AVIOContext *pb = NULL;
+    char name[128];
+    int64_t duration, start_time, bit_rate;
+    int i, flags, nb_streams = 0, ret;
+
+    if (!s->pb || (ret = compute_key(s)) == AVERROR(ENOSYS))
+        return 0;
+    if (ret < 0)
+        return ret;
+
+    if (s->io_open(s, &pb, s->index_cache, AVIO_FLAG_READ, NULL) < 0) {
+        av_log(s, AV_LOG_VERBOSE, "No index cache at '%s'\n", s->index_cache);
+        return 0;
+    }
+
+    if (avio_rb32(pb) != INDEX_CACHE_TAG ||
+        avio_rb32(pb) != INDEX_CACHE_VERSION ||
+        avio_rb64(pb) != internal->index_cache_size ||
+        avio_rb64(pb) != internal->index_cache_mtime ||
+        avio_rb32(pb) != internal->index_cache_crc) {
+        av_log(s, AV_LOG_VERBOSE, "Index cache '%s' does not match the input\n",
+               s->index_cache);
+        ret = 0;
+        goto end;
+    }
+    avio_get_str(pb, INT_MAX, name, sizeof(name));
+    if (strcmp(name, s->iformat->name)) {
+        ret = 0;
+        goto end;
+    }
+
+    flags      = avio_rb32(pb);
+    duration   = avio_rb64(pb);
+    start_time = avio_rb64(pb);
+    bit_rate   = avio_rb64(pb);
+    nb_streams = avio_rb32(pb);
+    if (nb_streams < 0 || nb_streams > s->max_streams) {
+        ret = AVERROR_INVALIDDATA;
+        goto end;
+    }
+    cs = av_mallocz_array(nb_streams, sizeof(*cs));
+    if (!cs && nb_streams) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    for (i = 0; i < nb_streams; i++)
+        if ((ret = read_cached_stream(pb, &cs[i])) < 0)
+            goto end;
+
+    if (caches_index(s)) {
+        for (i = 0; i < nb_streams && i < s->nb_streams; i++) {
+            AVStreamInternal *sti = s->streams[i]->internal;
+            if (s->streams[i]->id != cs[i].id ||
+                av_cmp_q(s->streams[i]->time_base, cs[i].time_base))
+                continue;
+            av_freep(&sti->cache_index);
+            sti->cache_index                = cs[i].entries;
+            sti->nb_cache_index             = cs[i].nb_entries;
+            sti->cache_index_allocated_size = cs[i].nb_entries * sizeof(*cs[i].entries);
+            cs[i].entries = NULL;
+            internal->index_cache_entries += sti->nb_cache_index;
+        }
+    }
+
+    if ((flags & FLAG_HAVE_PARAMS) && params_match(s, cs, nb_streams)) {
+        for (i = 0; i < nb_streams; i++) {
+            AVStream *st = s->streams[i];
+            if ((ret = avcodec_parameters_copy(st->codecpar, cs[i].par)) < 0)
+                goto end;
+            st->start_time          = cs[i].start_time;
+            st->duration            = cs[i].duration;
+            st->nb_frames           = cs[i].nb_frames;
+            st->disposition         = cs[i].disposition;
+            st->sample_aspect_ratio = cs[i].sample_aspect_ratio;
+            st->avg_frame_rate      = cs[i].avg_frame_rate;
+            st->r_frame_rate        = cs[i].r_frame_rate;
+            if (st->internal->request_probe > 0)
+                st->internal->request_probe = -1;
+            st->internal->need_context_update = 1;
+        }
+        s->duration   = duration;
+        s->start_time = start_time;
+        s->bit_rate   = bit_rate;
+        internal->index_cache_hit = 1;
+    }
+
+    av_log(s, AV_LOG_VERBOSE, "Loaded %d index entries%s from '%s'\n",
+           internal->index_cache_entries,
+           internal->index_cache_hit ? " and stream parameters" : "",
+           s->index_cache);
+    ret = 0;
+
+end:
+    if (ret == AVERROR_INVALIDDATA || ret == AVERROR_EOF) {
+        av_log(s, AV_LOG_WARNING, "Ignoring invalid index cache '%s'\n",
+               s->index_cache);
+        ret = 0;
+    }
+    free_cached_streams(cs, nb_streams);
+    ff_format_io_close(s, &pb);
+    return ret;
+}
+
+int ff_index_cache_save(AVFormatContext *s)
+{
+    AVFormatInternal *internal = s->internal;
+    AVIOContext *pb = NULL;
+    char *tmp;
+    int i, j, nb_entries = 0, ret;
+
+    if (!internal->index_cache_valid)
+        return 0;
+
+    for (i = 0; i < s->nb_streams; i++)
+        nb_entries += s->streams[i]->internal->nb_cache_index;
+    if (!(internal->index_cache_have_params && !internal->index_cache_hit) &&
+        nb_entries <= internal->index_cache_entries)
+        return 0;
+
+    /* write under a unique name and rename, so that concurrent readers
+     * never see a partial file */
+    tmp = av_asprintf("%s.%08x.tmp", s->index_cache, av_get_random_seed());
+    if (!tmp)
+        return AVERROR(ENOMEM);
+    if ((ret = s->io_open(s, &pb, tmp, AVIO_FLAG_WRITE, NULL)) < 0) {
+        av_log(s, AV_LOG_WARNING, "Could not write index cache '%s'\n", tmp);
+        av_free(tmp);
+        return ret;
+    }
+
+    avio_wb32(pb, INDEX_CACHE_TAG);
+    avio_wb32(pb, INDEX_CACHE_VERSION);
+    avio_wb64(pb, internal->index_cache_size);
+    avio_wb64(pb, internal->index_cache_mtime);
+    avio_wb32(pb, internal->index_cache_crc);
+    avio_put_str(pb, s->iformat->name);
+    avio_wb32(pb, internal->index_cache_have_params ? FLAG_HAVE_PARAMS : 0);
+    avio_wb64(pb, s->duration);
+    avio_wb64(pb, s->start_time);
+    avio_wb64(pb, s->bit_rate);
+    avio_wb32(pb, s->nb_streams);
+
+    for (i = 0; i < s->nb_streams; i++) {
+        const AVStream *st = s->streams[i];
+
+        avio_wb32(pb, st->id);
+        write_rational(pb, st->time_base);
+        avio_wb64(pb, st->start_time);
+        avio_wb64(pb, st->duration);
+        avio_wb64(pb, st->nb_frames);
+        avio_wb32(pb, st->disposition);
+        write_rational(pb, st->sample_aspect_ratio);
+        write_rational(pb, st->avg_frame_rate);
+        write_rational(pb, st->r_frame_rate);
+        write_codecpar(pb, st->codecpar);
+
+        avio_wb32(pb, st->internal->nb_cache_index);
+        for (j = 0; j < st->internal->nb_cache_index; j++) {
+            const AVIndexEntry *e = &st->internal->cache_index[j];
+            avio_wb64(pb, e->pos);
+            avio_wb64(pb, e->timestamp);
+            avio_wb32(pb, e->size);
+            avio_wb32(pb, e->min_distance);
+            avio_wb32(pb, e->flags);
+        }
+    }
+
+    avio_flush(pb);
+    ret = pb->error;
+    ff_format_io_close(s, &pb);
+
+    if (ret >= 0)
+        ret = avpriv_io_move(tmp, s->index_cache);
+    if (ret < 0) {
+        av_log(s, AV_LOG_WARNING, "Could not write index cache '%s': %s\n",
+               s->index_cache, av_err2str(ret));
+        avpriv_io_delete(tmp);
+    } else {
+        av_log(s, AV_LOG_VERBOSE, "Wrote %d index entries to '%s'\n",
+               nb_entries, s->index_cache);
+    }
+    av_free(tmp);
+    return ret;
+}
+
+void ff_index_cache_add(AVFormatContext *s, AVStream *st, const AVPacket *pkt)
+{
+    AVStreamInternal *sti = st->internal;
+    unsigned int max_entries = s->max_index_size / sizeof(AVIndexEntry);
+    int64_t distance = 0;
+
+    /* A full cache keeps the keyframes it has: thinning it out would make
+     * the survivors look adjacent although keyframes were dropped between
+     * them, so their min_distance would let seeks stop short. */
+    if (!caches_index(s) || pkt->pos < 0 || pkt->dts == AV_NOPTS_VALUE ||
+        (unsigned) sti->nb_cache_index >= max_entries)
+        return;
+
+    if (sti->cache_index_sequential && pkt->pos > sti->cache_index_last_pos)
+        distance = FFMIN(pkt->pos - sti->cache_index_last_pos, INT_MAX);
+    sti->cache_index_last_pos   = pkt->pos;
+    sti->cache_index_sequential = 1;
+
+    ff_add_index_entry(&sti->cache_index, &sti->nb_cache_index,
+                       &sti->cache_index_allocated_size, pkt->pos, pkt->dts,
+                       0, distance, AVINDEX_KEYFRAME);
+}
+
+int ff_index_cache_seek(AVFormatContext *s, int stream_index,
+                        int64_t timestamp, int flags)
+{
+    AVStream *st = s->streams[stream_index];
+    AVStreamInternal *sti = st->internal;
+    const AVIndexEntry *e;
+    int64_t ret;
+    int index;
+
+    index = ff_index_search_timestamp(sti->cache_index, sti->nb_cache_index,
+                                      timestamp, flags);
+    if (index < 0)
+        return -1;
+    e = &sti->cache_index[index];
+
+    /* The entry is only the right keyframe if the next (backward) or
+     * previous (forward) keyframe is known as well. */
+    if (e->timestamp != timestamp) {
+        if (flags & AVSEEK_FLAG_BACKWARD) {
+            if (index + 1 >= sti->nb_cache_index || !e[1].min_distance)
+                return -1;
+        } else if (!index || !e->min_distance) {
+            return -1;
+        }
+    }
+
+    ff_read_frame_flush(s);
+    if ((ret = avio_seek(s->pb, e->pos, SEEK_SET)) < 0)
+        return ret;
+    ff_update_cur_dts(s, st, e->timestamp);
+    return 0;
+}
@@ -147,6 +147,18 @@ struct AVFormatInternal {
      * Set if chapter ids are strictly monotonic.
      */
     int chapter_ids_monotonic;
+
+    /**
+     * Sidecar index cache state, see indexcache.c.
+     * The key of the input is valid only if index_cache_valid is set.
+     */
+    int64_t  index_cache_size;
+    int64_t  index_cache_mtime;
+    uint32_t index_cache_crc;
+    int      index_cache_valid;
+    int      index_cache_hit;         ///< stream parameters were restored
+    int      index_cache_entries;     ///< keyframes loaded from the cache
+    int      index_cache_have_params; ///< probing found all codec parameters
 };
 
 struct AVStreamInternal {
@@ -235,6 +247,17 @@ struct AVStreamInternal {
     int nb_index_entries;
     unsigned int index_entries_allocated_size;
 
+    /**
+     * Keyframes seen while demuxing, kept for the index cache. An entry
+     * with a non-zero min_distance was reached by reading on from the
+     * previous entry, so no keyframe lies between the two.
+     */
+    AVIndexEntry *cache_index;
+    int nb_cache_index;
+    unsigned int cache_index_allocated_size;
+    int64_t cache_index_last_pos; ///< position of the last keyframe read
+    int cache_index_sequential;   ///< no seek since cache_index_last_pos
+
     int64_t interleaver_chunk_size;
     int64_t interleaver_chunk_duration;
 
@@ -446,6 +469,14 @@ void ff_sdp_write_media(char *buff, int size, AVStream *st, int idx,
 int ff_write_chained(AVFormatContext *dst, int dst_stream, AVPacket *pkt,
                      AVFormatContext *src, int interleave);
 
+/**
+ * Like av_get_packet(), but let the packet reference the data in place if
+ * the underlying protocol can export it (e.g. a memory mapped file).
+ * The packet data must then be treated as read-only, so demuxers that
+ * modify the payload in place must not use this.
+ */
+int ff_get_packet_ref(AVIOContext *s, AVPacket *pkt, int size);
+
 /**
  * Read a whole line of text from AVIOContext. Stop reading after reaching
  * either a \\n, a \\0 or EOF. The returned string is always \\0-terminated,
@@ -803,6 +834,35 @@ int ff_format_output_open(AVFormatContext *s, const char *url, AVDictionary **op
  */
 void ff_format_io_close(AVFormatContext *s, AVIOContext **pb);
 
+/**
+ * Load the sidecar index cache named by AVFormatContext.index_cache.
+ * Must be called after read_header(). A missing, stale or invalid cache
+ * is not an error.
+ *
+ * @return 0 or a negative AVERROR code on allocation or I/O failure
+ */
+int ff_index_cache_load(AVFormatContext *s);
+
+/**
+ * Write the sidecar index cache, if anything new was learned about the
+ * input since it was opened.
+ */
+int ff_index_cache_save(AVFormatContext *s);
+
+/**
+ * Record a keyframe returned by av_read_frame() in the index cache.
+ */
+void ff_index_cache_add(AVFormatContext *s, AVStream *st, const AVPacket *pkt);
+
+/**
+ * Seek to the keyframe for timestamp using the index cache.
+ *
+ * @return 0 on success, a negative value if the cached index does not
+ *         determine the keyframe
+ */
+int ff_index_cache_seek(AVFormatContext *s, int stream_index,
+                        int64_t timestamp, int flags);
+
 /**
  * Utility function to check if the file uses http or https protocol
  *
@@ -155,6 +155,26 @@ typedef struct MOVIndexRange {
     int64_t end;
 } MOVIndexRange;
 
+/**
+ * Sample index resolved on demand from the sample tables, used instead of
+ * AVStream index entries when the compact_index option is set.
+ */
+typedef struct MOVCompactIndex {
+    unsigned int nb_samples;
+    unsigned int *chunk_first;  ///< first sample of each chunk, chunk_count + 1 entries
+    unsigned int *stts_first;   ///< first sample of each stts entry
+    int64_t *stts_dts;          ///< dts of the first sample of each stts entry
+    unsigned int stts_count;    ///< number of stts entries in use
+    int key_off;
+    int64_t stream_size;
+
+    /* last resolved sample, the next one is found without searching */
+    int sample;
+    unsigned int chunk;
+    unsigned int stts_index;
+    AVIndexEntry entry;
+} MOVCompactIndex;
+
 typedef struct MOVStreamContext {
     AVIOContext *pb;
     int pb_is_copied;
@@ -193,6 +213,8 @@ typedef struct MOVStreamContext {
     int64_t current_index;
     MOVIndexRange* index_ranges;
     MOVIndexRange* current_index_range;
+    MOVCompactIndex *compact_index; ///< set if the samples are not in the AVStream index
+    int full_index;                 ///< do not use a compact index for this track
     unsigned int bytes_per_frame;
     unsigned int samples_per_frame;
     int dv_audio_container;
@@ -297,6 +319,7 @@ typedef struct MOVContext {
     int32_t movie_display_matrix[3][3]; ///< display matrix from mvhd
     int have_read_mfra_size;
     uint32_t mfra_size;
+    int compact_index;
 } MOVContext;
 
 int ff_mp4_read_descr_len(AVIOContext *pb);
@@ -1035,10 +1035,22 @@ static int ebml_read_ascii(AVIOContext *pb, int size,
  * 0 is success, < 0 or NEEDS_CHECKING is failure.
  */
 static int ebml_read_binary(AVIOContext *pb, int length,
-                            int64_t pos, EbmlBin *bin)
+                            int64_t pos, EbmlBin *bin, int by_ref)
 {
+    AVBufferRef *ref;
     int ret;
 
+    /* Reference the data in place if the protocol supports it;
+     * only done for data that is never modified afterwards. */
+    if (by_ref && ffio_read_ref(pb, &ref, length) >= 0) {
+        av_buffer_unref(&bin->buf);
+        bin->buf  = ref;
+        bin->data = ref->data;
+        bin->size = length;
+        bin->pos  = pos;
+        return 0;
+    }
+
     ret = av_buffer_realloc(&bin->buf, length + AV_INPUT_BUFFER_PADDING_SIZE);
     if (ret < 0)
         return ret;
@@ -1434,7 +1446,9 @@ static int ebml_parse(MatroskaDemuxContext *matroska,
         res = ebml_read_ascii(pb, length, syntax->def.s, data);
         break;
     case EBML_BIN:
-        res = ebml_read_binary(pb, length, pos_alt, data);
+        res = ebml_read_binary(pb, length, pos_alt, data,
+                               id == MATROSKA_ID_SIMPLEBLOCK ||
+                               id == MATROSKA_ID_BLOCK);
         break;
     case EBML_LEVEL1:
     case EBML_NEST:
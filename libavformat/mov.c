@@ -3372,6 +3372,141 @@ static int64_t add_ctts_entry(MOVStts** ctts_data, unsigned int* ctts_count, uns
     return *ctts_count;
 }
 
+static void mov_free_compact_index(MOVStreamContext *sc)
+{
+    if (!sc->compact_index)
+        return;
+    av_freep(&sc->compact_index->chunk_first);
+    av_freep(&sc->compact_index->stts_first);
+    av_freep(&sc->compact_index->stts_dts);
+    av_freep(&sc->compact_index);
+}
+
+/**
+ * Return the number of entries of a sorted table which are less than or
+ * equal to v.
+ */
+static unsigned int mov_count_le(const unsigned int *tab, unsigned int nb, int64_t v)
+{
+    unsigned int a = 0, b = nb;
+
+    while (a < b) {
+        unsigned int m = (a + b) >> 1;
+        if (tab[m] <= v)
+            a = m + 1;
+        else
+            b = m;
+    }
+    return a;
+}
+
+static int64_t mov_compact_index_dts(MOVStreamContext *sc, unsigned int n)
+{
+    MOVCompactIndex *ci = sc->compact_index;
+    unsigned int i = ci->stts_index;
+
+    if (i >= ci->stts_count || n < ci->stts_first[i] ||
+        (i + 1 < ci->stts_count && n >= ci->stts_first[i + 1]))
+        ci->stts_index = i = mov_count_le(ci->stts_first, ci->stts_count, n) - 1;
+
+    return ci->stts_dts[i] + (int64_t)(n - ci->stts_first[i]) * sc->stts_data[i].duration;
+}
+
+/**
+ * Find the last sync sample at or before sample n in a table of 1-based
+ * sample numbers.
+ * @return the sample number or -1 if there is none
+ */
+static int64_t mov_compact_index_prev_key(const unsigned int *tab, unsigned int nb,
+                                          int key_off, unsigned int n)
+{
+    unsigned int k = mov_count_le(tab, nb, (int64_t)n + key_off);
+
+    if (!k || tab[k - 1] < (unsigned int)key_off)
+        return -1;
+    return tab[k - 1] - key_off;
+}
+
+static AVIndexEntry *mov_compact_index_get(AVStream *st, unsigned int n)
+{
+    MOVStreamContext *sc = st->priv_data;
+    MOVCompactIndex *ci = sc->compact_index;
+    AVIndexEntry *e = &ci->entry;
+    int64_t last_key = 0, key;
+    int keyframe = 0;
+
+    if (n == ci->sample)
+        return e;
+
+    if (ci->sample >= 0 && n == ci->sample + 1 && n < ci->chunk_first[ci->chunk + 1]) {
+        e->pos += e->size;
+    } else {
+        unsigned int i;
+
+        ci->chunk = mov_count_le(ci->chunk_first, sc->chunk_count, n) - 1;
+        e->pos = sc->chunk_offsets[ci->chunk];
+        if (sc->stsz_sample_size > 0)
+            e->pos += (int64_t)(n - ci->chunk_first[ci->chunk]) * sc->stsz_sample_size;
+        else
+            for (i = ci->chunk_first[ci->chunk]; i < n; i++)
+                e->pos += sc->sample_sizes[i];
+    }
+
+    if (!sc->keyframe_absent) {
+        if (!sc->keyframe_count) {
+            keyframe = 1;
+            last_key = n;
+        } else if ((key = mov_compact_index_prev_key((const unsigned int *)sc->keyframes, sc->keyframe_count,
+                                                     ci->key_off, n)) >= 0) {
+            keyframe = key == n;
+            last_key = key;
+        }
+    }
+    if (sc->stps_count &&
+        (key = mov_compact_index_prev_key(sc->stps_data, sc->stps_count, ci->key_off, n)) >= 0) {
+        keyframe |= key == n;
+        last_key  = FFMAX(last_key, key);
+    }
+    if (sc->keyframe_absent && !sc->stps_count) {
+        if (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
+            keyframe = 1;
+            last_key = n;
+        } else {
+            keyframe = !n && !ci->chunk;
+        }
+    }
+
+    e->timestamp    = mov_compact_index_dts(sc, n);
+    e->size         = sc->stsz_sample_size > 0 ? sc->stsz_sample_size : sc->sample_sizes[n];
+    e->min_distance = n - last_key;
+    e->flags        = keyframe ? AVINDEX_KEYFRAME : 0;
+    ci->sample      = n;
+
+    return e;
+}
+
+static int mov_nb_samples(AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    return sc->compact_index ? sc->compact_index->nb_samples : st->internal->nb_index_entries;
+}
+
+/**
+ * Get the index entry of sample n. With a compact index, the entry is only
+ * valid until the next call for the same stream.
+ */
+static AVIndexEntry *mov_get_sample(AVStream *st, int n)
+{
+    MOVStreamContext *sc = st->priv_data;
+    return sc->compact_index ? mov_compact_index_get(st, n) : &st->internal->index_entries[n];
+}
+
+static int64_t mov_get_sample_dts(AVStream *st, int n)
+{
+    MOVStreamContext *sc = st->priv_data;
+    return sc->compact_index ? mov_compact_index_dts(sc, n) : st->internal->index_entries[n].timestamp;
+}
+
 #define MAX_REORDER_DELAY 16
 static void mov_estimate_video_delay(MOVContext *c, AVStream* st)
 {
@@ -3389,14 +3524,14 @@ static void mov_estimate_video_delay(MOVContext *c, AVStream* st)
     if (st->codecpar->video_delay <= 0 && msc->ctts_data &&
         st->codecpar->codec_id == AV_CODEC_ID_H264) {
         st->codecpar->video_delay = 0;
-        for (ind = 0; ind < st->internal->nb_index_entries && ctts_ind < msc->ctts_count; ++ind) {
+        for (ind = 0; ind < mov_nb_samples(st) && ctts_ind < msc->ctts_count; ++ind) {
             // Point j to the last elem of the buffer and insert the current pts there.
             j = buf_start;
             buf_start = (buf_start + 1);
             if (buf_start == MAX_REORDER_DELAY + 1)
                 buf_start = 0;
 
-            pts_buf[j] = st->internal->index_entries[ind].timestamp + msc->ctts_data[ctts_ind].duration;
+            pts_buf[j] = mov_get_sample_dts(st, ind) + msc->ctts_data[ctts_ind].duration;
 
             // The timestamps that are already in the sorted buffer, and are greater than the
             // current pts, are exactly the timestamps that need to be buffered to output PTS
@@ -3475,6 +3610,24 @@ static void mov_current_sample_set(MOVStreamContext *sc, int current_sample)
     }
 }
 
+/**
+ * Set the ctts position to the one of sc->current_sample.
+ */
+static void mov_current_ctts_set(MOVStreamContext *sc)
+{
+    int time_sample = 0;
+    unsigned int i;
+
+    for (i = 0; i < sc->ctts_count; i++) {
+        int next = time_sample + sc->ctts_data[i].count;
+        if (next > sc->current_sample)
+            break;
+        time_sample = next;
+    }
+    sc->ctts_index  = i;
+    sc->ctts_sample = sc->current_sample - time_sample;
+}
+
 /**
  * Fix st->internal->index_entries, so that it contains only the entries (and the entries
  * which are needed to decode them) that fall in the edit list time ranges.
@@ -3785,6 +3938,199 @@ static void mov_fix_index(MOVContext *mov, AVStream *st)
     msc->current_index = msc->index_ranges[0].start;
 }
 
+static int mov_is_sorted(const unsigned int *tab, unsigned int nb)
+{
+    unsigned int i;
+
+    for (i = 1; i < nb; i++)
+        if (tab[i] < tab[i - 1])
+            return 0;
+    return 1;
+}
+
+/**
+ * Apply the edit list to a compact index. Only a single edit which keeps
+ * every sample is supported, i.e. one for which mov_fix_index() would not
+ * drop or discard any sample and only shift the timestamps: all samples
+ * must be presented within the edit, and the sample at which it would stop
+ * copying the index must be the last one.
+ */
+static int mov_compact_index_fix_edit(MOVContext *mov, AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    MOVCompactIndex *ci = sc->compact_index;
+    int is_audio = st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO;
+    int64_t media_time, duration, min_pts = INT64_MAX;
+    unsigned int ctts_index = 0, ctts_sample = 0, i, n;
+    /* with ctts, mov_fix_index() keeps the samples up to the second
+     * keyframe after the end of the edit, otherwise up to the first */
+    int stops_left = sc->ctts_data && !is_audio;
+
+    if (!sc->elst_count || mov->ignore_editlist || !mov->advanced_editlist)
+        return 0;
+
+    if (sc->elst_count != 1 ||
+        !get_edit_list_entry(mov, sc, 0, &media_time, &duration, mov->time_scale) ||
+        media_time < 0)
+        return AVERROR_PATCHWELCOME;
+
+    for (n = 0; n < ci->nb_samples; n++) {
+        int64_t dts = mov_compact_index_dts(sc, n);
+        int64_t pts = dts + sc->dts_shift;
+
+        if (sc->ctts_data && ctts_index < sc->ctts_count) {
+            pts += sc->ctts_data[ctts_index].duration;
+            if (++ctts_sample == sc->ctts_data[ctts_index].count) {
+                ctts_index++;
+                ctts_sample = 0;
+            }
+        }
+        if (pts < media_time || pts >= media_time + duration)
+            return AVERROR_PATCHWELCOME;
+        if (n + 1 < ci->nb_samples &&
+            pts + mov_compact_index_dts(sc, n + 1) - dts >= media_time + duration &&
+            (is_audio || (mov_compact_index_get(st, n)->flags & AVINDEX_KEYFRAME)) &&
+            !stops_left--)
+            return AVERROR_PATCHWELCOME;
+        min_pts = FFMIN(min_pts, pts);
+    }
+
+    sc->min_corrected_pts = min_pts;
+    if (!is_audio && min_pts > 0)
+        for (i = 0; i < ci->stts_count; i++)
+            ci->stts_dts[i] -= min_pts;
+    st->start_time = 0;
+    st->duration   = FFMIN(st->duration, duration);
+    if (is_audio)
+        st->internal->skip_samples = sc->start_pad = 0;
+    return 0;
+}
+
+/**
+ * Set up a compact index, which resolves samples from the sample tables
+ * when they are read instead of expanding all of them into AVIndexEntries.
+ * Tracks using features the compact index does not handle get a full index.
+ */
+static int mov_build_compact_index(MOVContext *mov, AVStream *st, int64_t current_dts)
+{
+    MOVStreamContext *sc = st->priv_data;
+    MOVCompactIndex *ci;
+    unsigned int stsc_index = 0;
+    uint64_t current_sample = 0;
+    unsigned int i;
+    int ret;
+
+    if ((st->codecpar->codec_type != AVMEDIA_TYPE_VIDEO &&
+         st->codecpar->codec_type != AVMEDIA_TYPE_AUDIO) ||
+        (sc->rap_group_count && sc->rap_group) ||
+        !mov_is_sorted((const unsigned int *)sc->keyframes, sc->keyframe_count) ||
+        !mov_is_sorted(sc->stps_data, sc->stps_count) ||
+        sc->sample_count > INT_MAX)
+        return AVERROR_PATCHWELCOME;
+    /* All chunks must belong to the demuxed sample description. */
+    for (i = 0; i < sc->stsc_count && sc->pseudo_stream_id != -1; i++)
+        if (sc->stsc_data[i].id - 1 != sc->pseudo_stream_id)
+            return AVERROR_PATCHWELCOME;
+
+    sc->compact_index = ci = av_mallocz(sizeof(*ci));
+    if (!ci)
+        return AVERROR(ENOMEM);
+    ci->sample = -1;
+    ci->key_off = (sc->keyframe_count && sc->keyframes[0] > 0) || (sc->stps_count && sc->stps_data[0] > 0);
+
+    /* An entry with a zero count is never left, like in mov_build_index(). */
+    ci->stts_count = sc->stts_count;
+    for (i = 0; i + 1 < sc->stts_count; i++) {
+        if (!sc->stts_data[i].count) {
+            ci->stts_count = i + 1;
+            break;
+        }
+    }
+    ci->stts_first  = av_malloc_array(ci->stts_count, sizeof(*ci->stts_first));
+    ci->stts_dts    = av_malloc_array(ci->stts_count, sizeof(*ci->stts_dts));
+    ci->chunk_first = av_malloc_array(sc->chunk_count + 1, sizeof(*ci->chunk_first));
+    if (!ci->stts_first || !ci->stts_dts || !ci->chunk_first) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    for (i = 0; i < ci->stts_count; i++) {
+        if (sc->stts_data[i].duration < 0) {
+            ret = AVERROR_PATCHWELCOME;
+            goto fail;
+        }
+        ci->stts_first[i] = FFMIN(current_sample, UINT_MAX);
+        ci->stts_dts[i]   = current_dts;
+        current_sample += sc->stts_data[i].count;
+        current_dts    += (int64_t)sc->stts_data[i].count * sc->stts_data[i].duration;
+    }
+
+    current_sample = 0;
+    for (i = 0; i < sc->chunk_count; i++) {
+        int64_t next_offset = i+1 < sc->chunk_count ? sc->chunk_offsets[i+1] : INT64_MAX;
+        int64_t current_offset = sc->chunk_offsets[i];
+        while (mov_stsc_index_valid(stsc_index, sc->stsc_count) &&
+            i + 1 == sc->stsc_data[stsc_index + 1].first)
+            stsc_index++;
+
+        if (next_offset > current_offset && sc->sample_size>0 && sc->sample_size < sc->stsz_sample_size &&
+            sc->stsc_data[stsc_index].count * (int64_t)sc->stsz_sample_size > next_offset - current_offset) {
+            av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too large), ignoring\n", sc->stsz_sample_size);
+            sc->stsz_sample_size = sc->sample_size;
+        }
+        if (sc->stsz_sample_size>0 && sc->stsz_sample_size < sc->sample_size) {
+            av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too small), ignoring\n", sc->stsz_sample_size);
+            sc->stsz_sample_size = sc->sample_size;
+        }
+
+        ci->chunk_first[i] = current_sample;
+        current_sample += sc->stsc_data[stsc_index].count;
+        if (current_sample > sc->sample_count) {
+            av_log(mov->fc, AV_LOG_ERROR, "wrong sample count\n");
+            current_sample = sc->sample_count;
+            break;
+        }
+    }
+    for (; i <= sc->chunk_count; i++)
+        ci->chunk_first[i] = current_sample;
+    ci->nb_samples = current_sample;
+    if (!ci->nb_samples) {
+        ret = AVERROR_PATCHWELCOME;
+        goto fail;
+    }
+
+    for (i = 0; i < ci->nb_samples; i++) {
+        unsigned int sample_size = sc->stsz_sample_size > 0 ? sc->stsz_sample_size : sc->sample_sizes[i];
+        if (sample_size > 0x3FFFFFFF) {
+            ret = AVERROR_PATCHWELCOME;
+            goto fail;
+        }
+        ci->stream_size += sample_size;
+    }
+
+    if ((ret = mov_compact_index_fix_edit(mov, st)) < 0)
+        goto fail;
+
+    if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+        for (i = 0; i < FFMIN(ci->nb_samples, 99); i++)
+            ff_rfps_add_frame(mov->fc, st, mov_compact_index_dts(sc, i));
+    if (st->duration > 0)
+        st->codecpar->bit_rate = ci->stream_size*8*sc->time_scale/st->duration;
+    if (st->start_time == AV_NOPTS_VALUE && st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+        st->start_time = mov_compact_index_dts(sc, 0) + sc->dts_shift;
+        if (sc->ctts_data)
+            st->start_time += sc->ctts_data[0].duration;
+    }
+    mov_estimate_video_delay(mov, st);
+
+    av_log(mov->fc, AV_LOG_DEBUG, "stream %d: compact index of %u samples\n",
+           st->index, ci->nb_samples);
+    return 0;
+fail:
+    mov_free_compact_index(sc);
+    return ret;
+}
+
 static void mov_build_index(MOVContext *mov, AVStream *st)
 {
     MOVStreamContext *sc = st->priv_data;
@@ -3857,6 +4203,9 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
 
         if (!sc->sample_count || st->internal->nb_index_entries)
             return;
+        if (mov->compact_index && !sc->full_index &&
+            mov_build_compact_index(mov, st, current_dts) >= 0)
+            return;
         if (sc->sample_count >= UINT_MAX / sizeof(*st->internal->index_entries) - st->internal->nb_index_entries)
             return;
         if (av_reallocp_array(&st->internal->index_entries,
@@ -3957,7 +4306,10 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
                     av_log(mov->fc, AV_LOG_TRACE, "AVIndex stream %d, sample %u, offset %"PRIx64", dts %"PRId64", "
                             "size %u, distance %u, keyframe %d\n", st->index, current_sample,
                             current_offset, current_dts, sample_size, distance, keyframe);
-                    if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && st->internal->nb_index_entries < 100)
+                    /* no frame rate info is left when a fragment makes
+                     * a compact index rebuild it while demuxing */
+                    if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && st->internal->nb_index_entries < 100 &&
+                        st->internal->info)
                         ff_rfps_add_frame(mov->fc, st, current_dts);
                 }
 
@@ -4341,13 +4693,15 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         && sc->time_scale == st->codecpar->sample_rate) {
             st->need_parsing = AVSTREAM_PARSE_FULL;
     }
-    /* Do not need those anymore. */
-    av_freep(&sc->chunk_offsets);
-    av_freep(&sc->sample_sizes);
-    av_freep(&sc->keyframes);
-    av_freep(&sc->stts_data);
-    av_freep(&sc->stps_data);
-    av_freep(&sc->elst_data);
+    /* Do not need those anymore, unless samples are looked up in them. */
+    if (!sc->compact_index) {
+        av_freep(&sc->chunk_offsets);
+        av_freep(&sc->sample_sizes);
+        av_freep(&sc->keyframes);
+        av_freep(&sc->stts_data);
+        av_freep(&sc->stps_data);
+        av_freep(&sc->elst_data);
+    }
     av_freep(&sc->rap_group);
 
     return 0;
@@ -4796,6 +5150,20 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     if (sc->pseudo_stream_id+1 != frag->stsd_id && sc->pseudo_stream_id != -1)
         return 0;
 
+    // Fragment samples are inserted in the AVStream index,
+    // so it has to hold the samples of the moov as well.
+    // The full index expands ctts to one entry per sample and may be
+    // rearranged by the edit list, so the read position is set again.
+    if (sc->compact_index) {
+        int current_sample = sc->current_sample;
+        mov_free_compact_index(sc);
+        sc->full_index = 1;
+        mov_build_index(c, st);
+        mov_current_sample_set(sc, current_sample);
+        if (sc->ctts_data)
+            mov_current_ctts_set(sc);
+    }
+
     // Find the next frag_index index that has a valid index_entry for
     // the current track_id.
     //
@@ -7209,9 +7577,9 @@ static void mov_read_chapters(AVFormatContext *s)
 
         if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
             st->disposition |= AV_DISPOSITION_ATTACHED_PIC | AV_DISPOSITION_TIMED_THUMBNAILS;
-            if (st->internal->nb_index_entries) {
+            if (mov_nb_samples(st)) {
                 // Retrieve the first frame, if possible
-                AVIndexEntry *sample = &st->internal->index_entries[0];
+                AVIndexEntry *sample = mov_get_sample(st, 0);
                 if (avio_seek(sc->pb, sample->pos, SEEK_SET) != sample->pos) {
                     av_log(s, AV_LOG_ERROR, "Failed to retrieve first frame\n");
                     goto finish;
@@ -7396,6 +7764,7 @@ static int mov_read_close(AVFormatContext *s)
         av_freep(&sc->rap_group);
         av_freep(&sc->display_matrix);
         av_freep(&sc->index_ranges);
+        mov_free_compact_index(sc);
 
         if (sc->extradata)
             for (j = 0; j < sc->stsd_count; j++)
@@ -7795,8 +8164,8 @@ static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
     for (i = 0; i < s->nb_streams; i++) {
         AVStream *avst = s->streams[i];
         MOVStreamContext *msc = avst->priv_data;
-        if (msc->pb && msc->current_sample < avst->internal->nb_index_entries) {
-            AVIndexEntry *current_sample = &avst->internal->index_entries[msc->current_sample];
+        if (msc->pb && msc->current_sample < mov_nb_samples(avst)) {
+            AVIndexEntry *current_sample = mov_get_sample(avst, msc->current_sample);
             int64_t dts = av_rescale(current_sample->timestamp, AV_TIME_BASE, msc->time_scale);
             av_log(s, AV_LOG_TRACE, "stream %d, sample %d, dts %"PRId64"\n", i, msc->current_sample, dts);
             if (!sample || (!(s->pb->seekable & AVIO_SEEKABLE_NORMAL) && current_sample->pos < sample->pos) ||
@@ -7926,6 +8295,8 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
     if (mov->next_root_atom) {
         sample->pos = FFMIN(sample->pos, mov->next_root_atom);
         sample->size = FFMIN(sample->size, (mov->next_root_atom - sample->pos));
+        if (sc->compact_index)
+            sc->compact_index->sample = -1;
     }
 
     if (st->discard != AVDISCARD_ALL) {
@@ -7946,6 +8317,9 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
 
         if (st->codecpar->codec_id == AV_CODEC_ID_EIA_608 && sample->size > 8)
             ret = get_eia608_packet(sc->pb, pkt, sample->size);
+        else if (!mov->aax_mode && !mov->decryption_key)
+            /* the payload is only modified in place when decrypting */
+            ret = ff_get_packet_ref(sc->pb, pkt, sample->size);
         else
             ret = av_get_packet(sc->pb, pkt, sample->size);
         if (ret < 0) {
@@ -7999,8 +8373,8 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
             sc->ctts_sample = 0;
         }
     } else {
-        int64_t next_dts = (sc->current_sample < st->internal->nb_index_entries) ?
-            st->internal->index_entries[sc->current_sample].timestamp : st->duration;
+        int64_t next_dts = (sc->current_sample < mov_nb_samples(st)) ?
+            mov_get_sample_dts(st, sc->current_sample) : st->duration;
 
         if (next_dts >= pkt->dts)
             pkt->duration = next_dts - pkt->dts;
@@ -8065,6 +8439,39 @@ static int mov_seek_fragment(AVFormatContext *s, AVStream *st, int64_t timestamp
     return 0;
 }
 
+/**
+ * Like av_index_search_timestamp(), also for tracks with a compact index.
+ */
+static int mov_index_search_timestamp(AVStream *st, int64_t timestamp, int flags)
+{
+    MOVStreamContext *sc = st->priv_data;
+    int nb_samples = mov_nb_samples(st);
+    int a = -1, b = nb_samples, m;
+
+    if (!sc->compact_index)
+        return av_index_search_timestamp(st, timestamp, flags);
+
+    while (b - a > 1) {
+        int64_t ts;
+        m  = (a + b) >> 1;
+        ts = mov_get_sample_dts(st, m);
+        if (ts >= timestamp)
+            b = m;
+        if (ts <= timestamp)
+            a = m;
+    }
+    m = (flags & AVSEEK_FLAG_BACKWARD) ? a : b;
+
+    if (!(flags & AVSEEK_FLAG_ANY))
+        while (m >= 0 && m < nb_samples &&
+               !(mov_get_sample(st, m)->flags & AVINDEX_KEYFRAME))
+            m += (flags & AVSEEK_FLAG_BACKWARD) ? -1 : 1;
+
+    if (m == nb_samples)
+        return -1;
+    return m;
+}
+
 static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp, int flags)
 {
     MOVStreamContext *sc = st->priv_data;
@@ -8079,27 +8486,17 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
     if (ret < 0)
         return ret;
 
-    sample = av_index_search_timestamp(st, timestamp, flags);
+    sample = mov_index_search_timestamp(st, timestamp, flags);
     av_log(s, AV_LOG_TRACE, "stream %d, timestamp %"PRId64", sample %d\n", st->index, timestamp, sample);
-    if (sample < 0 && st->internal->nb_index_entries && timestamp < st->internal->index_entries[0].timestamp)
+    if (sample < 0 && mov_nb_samples(st) && timestamp < mov_get_sample_dts(st, 0))
         sample = 0;
     if (sample < 0) /* not sure what to do */
         return AVERROR_INVALIDDATA;
     mov_current_sample_set(sc, sample);
     av_log(s, AV_LOG_TRACE, "stream %d, found sample %d\n", st->index, sc->current_sample);
     /* adjust ctts index */
-    if (sc->ctts_data) {
-        time_sample = 0;
-        for (i = 0; i < sc->ctts_count; i++) {
-            int next = time_sample + sc->ctts_data[i].count;
-            if (next > sc->current_sample) {
-                sc->ctts_index = i;
-                sc->ctts_sample = sc->current_sample - time_sample;
-                break;
-            }
-            time_sample = next;
-        }
-    }
+    if (sc->ctts_data)
+        mov_current_ctts_set(sc);
 
     /* adjust stsd index */
     if (sc->chunk_count) {
@@ -8122,8 +8519,8 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
 static int64_t mov_get_skip_samples(AVStream *st, int sample)
 {
     MOVStreamContext *sc = st->priv_data;
-    int64_t first_ts = st->internal->index_entries[0].timestamp;
-    int64_t ts = st->internal->index_entries[sample].timestamp;
+    int64_t first_ts = mov_get_sample_dts(st, 0);
+    int64_t ts = mov_get_sample_dts(st, sample);
     int64_t off;
 
     if (st->codecpar->codec_type != AVMEDIA_TYPE_AUDIO)
@@ -8152,7 +8549,7 @@ static int mov_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
 
     if (mc->seek_individually) {
         /* adjust seek timestamp to found sample timestamp */
-        int64_t seek_timestamp = st->internal->index_entries[sample].timestamp;
+        int64_t seek_timestamp = mov_get_sample_dts(st, sample);
         st->internal->skip_samples = mov_get_skip_samples(st, sample);
 
         for (i = 0; i < s->nb_streams; i++) {
@@ -8235,6 +8632,8 @@ static const AVOption mov_options[] = {
     { "decryption_key", "The media decryption key (hex)", OFFSET(decryption_key), AV_OPT_TYPE_BINARY, .flags = AV_OPT_FLAG_DECODING_PARAM },
     { "enable_drefs", "Enable external track support.", OFFSET(enable_drefs), AV_OPT_TYPE_BOOL,
         {.i64 = 0}, 0, 1, FLAGS },
+    { "compact_index", "Look up samples in the sample tables instead of building a full index.",
+        OFFSET(compact_index), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, FLAGS },
 
     { NULL },
 };
@@ -169,7 +169,7 @@ static const AVClass av_format_context_class = {
 static int io_open_default(AVFormatContext *s, AVIOContext **pb,
                            const char *url, int flags, AVDictionary **options)
 {
-    int loglevel;
+    int loglevel, ret;
 
     if (!strcmp(url, s->url) ||
         s->iformat && !strcmp(s->iformat->name, "image2") ||
@@ -188,7 +188,17 @@ FF_DISABLE_DEPRECATION_WARNINGS
 FF_ENABLE_DEPRECATION_WARNINGS
 #endif
 
-    return ffio_open_whitelist(pb, url, flags, &s->interrupt_callback, options, s->protocol_whitelist, s->protocol_blacklist);
+    ret = ffio_open_whitelist(pb, url, flags, &s->interrupt_callback, options, s->protocol_whitelist, s->protocol_blacklist);
+    if (ret < 0)
+        return ret;
+
+    if (s->prefetch_size > 0 && !(flags & AVIO_FLAG_WRITE)) {
+        int err = ffio_prefetch_init(*pb, s->prefetch_size);
+        if (err < 0 && err != AVERROR(ENOSYS))
+            av_log(s, AV_LOG_WARNING, "Cannot prefetch '%s': %s\n", url, av_err2str(err));
+    }
+
+    return 0;
 }
 
 static void io_close_default(AVFormatContext *s, AVIOContext *pb)
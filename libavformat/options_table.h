@@ -112,6 +112,10 @@ static const AVOption avformat_options[] = {
 {"max_streams", "maximum number of streams", OFFSET(max_streams), AV_OPT_TYPE_INT, { .i64 = 1000 }, 0, INT_MAX, D },
 {"skip_estimate_duration_from_pts", "skip duration calculation in estimate_timings_from_pts", OFFSET(skip_estimate_duration_from_pts), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, D},
 {"max_probe_packets", "Maximum number of packets to probe a codec", OFFSET(max_probe_packets), AV_OPT_TYPE_INT, { .i64 = 2500 }, 0, INT_MAX, D },
+{"prefetch_size", "size of the buffer read ahead in a background thread, 0 to disable", OFFSET(prefetch_size), AV_OPT_TYPE_INT, {.i64 = 0 }, 0, INT_MAX / 2, D},
+{"index_cache", "sidecar file caching stream parameters and keyframe index", OFFSET(index_cache), AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, D},
+{"probe_threads", "number of threads decoding streams in parallel while probing, 0 for one per CPU", OFFSET(probe_threads), AV_OPT_TYPE_INT, {.i64 = 1 }, 0, INT_MAX, D},
+{"max_probe_latency", "maximum time spent reading and decoding packets while probing (in microseconds)", OFFSET(max_probe_latency), AV_OPT_TYPE_INT64, {.i64 = 0 }, 0, INT64_MAX, D},
 {NULL},
 };
 
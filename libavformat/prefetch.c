@@ -0,0 +1,354 @@
+/*
+ * AVIOContext read-ahead in a background thread
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Read-ahead layer for AVIOContexts backed by a URLContext.
+ *
+ * A background thread keeps reading from the URLContext into a FIFO while
+ * the demuxer consumes data, so I/O latency overlaps with demuxing. Seeks
+ * that land inside the buffered window (including a part of the already
+ * consumed data) are served from the FIFO, all others flush it and are
+ * forwarded to the protocol.
+ */
+
+#include "config.h"
+
+#include "libavutil/error.h"
+#include "libavutil/fifo.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+#include "avio_internal.h"
+#include "url.h"
+
+#if HAVE_THREADS
+
+#define CHUNK_SIZE 32768
+
+typedef struct PrefetchContext {
+    URLContext     *h;
+    AVIOInterruptCB interrupt_callback; ///< original callback of h
+
+    AVFifoBuffer   *fifo;
+    uint8_t        *chunk;
+    int             read_pos;           ///< offset of the next unread byte in fifo
+    int             read_back_capacity; ///< consumed bytes kept for seeking back
+    int64_t         logical_pos;        ///< stream position of the next unread byte
+    int64_t         logical_size;
+
+    int             seek_request;
+    int64_t         seek_pos;
+    int             seek_whence;
+    int             seek_completed;
+    int64_t         seek_ret;
+
+    int             eof_reached;
+    int             io_error;
+    int             abort_request;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond_wakeup_main;
+    pthread_cond_t  cond_wakeup_background;
+    pthread_t       thread;
+
+    /* statistics */
+    int             nb_reads;
+    int             nb_stalls;
+    int64_t         stall_time;
+    int             nb_buffer_seeks;
+    int             nb_flushes;
+} PrefetchContext;
+
+static int prefetch_check_interrupt(void *opaque)
+{
+    PrefetchContext *c = opaque;
+
+    return c->abort_request || ff_check_interrupt(&c->interrupt_callback);
+}
+
+static void *prefetch_task(void *arg)
+{
+    PrefetchContext *c = arg;
+
+    pthread_mutex_lock(&c->mutex);
+    while (!c->abort_request) {
+        int ret;
+
+        if (c->seek_request) {
+            int64_t seek_ret;
+
+            /* a pending read would have to be dropped anyway */
+            pthread_mutex_unlock(&c->mutex);
+            seek_ret = ffurl_seek(c->h, c->seek_pos, c->seek_whence);
+            pthread_mutex_lock(&c->mutex);
+
+            if (seek_ret >= 0) {
+                av_fifo_reset(c->fifo);
+                c->read_pos    = 0;
+                c->logical_pos = seek_ret;
+                c->eof_reached = 0;
+                c->io_error    = 0;
+            }
+            c->seek_ret       = seek_ret;
+            c->seek_request   = 0;
+            c->seek_completed = 1;
+            pthread_cond_signal(&c->cond_wakeup_main);
+            continue;
+        }
+
+        if (c->eof_reached || c->io_error ||
+            av_fifo_space(c->fifo) < CHUNK_SIZE) {
+            pthread_cond_wait(&c->cond_wakeup_background, &c->mutex);
+            continue;
+        }
+
+        pthread_mutex_unlock(&c->mutex);
+        ret = ffurl_read(c->h, c->chunk, CHUNK_SIZE);
+        pthread_mutex_lock(&c->mutex);
+
+        /* the data belongs to the position before the seek */
+        if (c->seek_request)
+            continue;
+
+        if (ret == AVERROR_EOF || !ret)
+            c->eof_reached = 1;
+        else if (ret < 0)
+            c->io_error = ret;
+        else
+            av_fifo_generic_write(c->fifo, c->chunk, ret, NULL);
+        pthread_cond_signal(&c->cond_wakeup_main);
+    }
+    pthread_mutex_unlock(&c->mutex);
+
+    return NULL;
+}
+
+/* Drop consumed data beyond the read-back window. */
+static void trim_read_back(PrefetchContext *c)
+{
+    if (c->read_pos > c->read_back_capacity) {
+        av_fifo_drain(c->fifo, c->read_pos - c->read_back_capacity);
+        c->read_pos = c->read_back_capacity;
+    }
+}
+
+static int prefetch_read(void *opaque, uint8_t *buf, int size)
+{
+    PrefetchContext *c = opaque;
+    int64_t stall_start = 0;
+    int ret;
+
+    pthread_mutex_lock(&c->mutex);
+    c->nb_reads++;
+    while (1) {
+        int avail = av_fifo_size(c->fifo) - c->read_pos;
+
+        if (avail > 0) {
+            ret = FFMIN(avail, size);
+            av_fifo_generic_peek_at(c->fifo, buf, c->read_pos, ret, NULL);
+            c->read_pos    += ret;
+            c->logical_pos += ret;
+            trim_read_back(c);
+            break;
+        } else if (c->io_error) {
+            ret = c->io_error;
+            break;
+        } else if (c->eof_reached) {
+            ret = AVERROR_EOF;
+            break;
+        }
+
+        if (!stall_start) {
+            c->nb_stalls++;
+            stall_start = av_gettime_relative();
+        }
+        pthread_cond_signal(&c->cond_wakeup_background);
+        pthread_cond_wait(&c->cond_wakeup_main, &c->mutex);
+    }
+    if (stall_start)
+        c->stall_time += av_gettime_relative() - stall_start;
+    pthread_cond_signal(&c->cond_wakeup_background);
+    pthread_mutex_unlock(&c->mutex);
+
+    return ret;
+}
+
+static int64_t prefetch_seek(void *opaque, int64_t pos, int whence)
+{
+    PrefetchContext *c = opaque;
+    int64_t ret;
+
+    if (whence == AVSEEK_SIZE)
+        return c->logical_size;
+
+    pthread_mutex_lock(&c->mutex);
+    if (whence == SEEK_CUR) {
+        pos   += c->logical_pos;
+        whence = SEEK_SET;
+    }
+
+    if (whence == SEEK_SET &&
+        pos >= c->logical_pos - c->read_pos &&
+        pos <= c->logical_pos + av_fifo_size(c->fifo) - c->read_pos) {
+        c->read_pos   += pos - c->logical_pos;
+        c->logical_pos = pos;
+        trim_read_back(c);
+        c->nb_buffer_seeks++;
+        ret = pos;
+    } else {
+        c->seek_request   = 1;
+        c->seek_pos       = pos;
+        c->seek_whence    = whence;
+        c->seek_completed = 0;
+        c->nb_flushes++;
+        pthread_cond_signal(&c->cond_wakeup_background);
+        while (!c->seek_completed)
+            pthread_cond_wait(&c->cond_wakeup_main, &c->mutex);
+        ret = c->seek_ret;
+    }
+    pthread_cond_signal(&c->cond_wakeup_background);
+    pthread_mutex_unlock(&c->mutex);
+
+    return ret;
+}
+
+static void prefetch_free(PrefetchContext *c)
+{
+    av_fifo_freep(&c->fifo);
+    av_freep(&c->chunk);
+    av_free(c);
+}
+
+int ffio_prefetch_init(AVIOContext *s, int size)
+{
+    URLContext *h = ffio_geturlcontext(s);
+    PrefetchContext *c;
+    int ret;
+
+    /* Packet based protocols need every read to hold a whole packet,
+     * protocols with pause or time based seeking need the URLContext. */
+    if (!h || s->write_flag || h->max_packet_size ||
+        s->read_pause || s->read_seek || size <= 0)
+        return AVERROR(ENOSYS);
+
+    c = av_mallocz(sizeof(*c));
+    if (!c)
+        return AVERROR(ENOMEM);
+
+    size                  = FFMAX(size, 2 * CHUNK_SIZE);
+    c->read_back_capacity = size / 4;
+    c->fifo  = av_fifo_alloc(size + c->read_back_capacity);
+    c->chunk = av_malloc(CHUNK_SIZE);
+    if (!c->fifo || !c->chunk) {
+        prefetch_free(c);
+        return AVERROR(ENOMEM);
+    }
+
+    c->h            = h;
+    c->logical_pos  = s->pos;
+    c->logical_size = ffurl_seek(h, 0, AVSEEK_SIZE);
+
+    if ((ret = pthread_mutex_init(&c->mutex, NULL))) {
+        prefetch_free(c);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_cond_init(&c->cond_wakeup_main, NULL))) {
+        pthread_mutex_destroy(&c->mutex);
+        prefetch_free(c);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_cond_init(&c->cond_wakeup_background, NULL))) {
+        pthread_cond_destroy(&c->cond_wakeup_main);
+        pthread_mutex_destroy(&c->mutex);
+        prefetch_free(c);
+        return AVERROR(ret);
+    }
+
+    c->interrupt_callback = h->interrupt_callback;
+    h->interrupt_callback.callback = prefetch_check_interrupt;
+    h->interrupt_callback.opaque   = c;
+
+    if ((ret = pthread_create(&c->thread, NULL, prefetch_task, c))) {
+        h->interrupt_callback = c->interrupt_callback;
+        pthread_cond_destroy(&c->cond_wakeup_background);
+        pthread_cond_destroy(&c->cond_wakeup_main);
+        pthread_mutex_destroy(&c->mutex);
+        prefetch_free(c);
+        return AVERROR(ret);
+    }
+
+    s->opaque         = c;
+    s->read_packet    = prefetch_read;
+    s->seek           = prefetch_seek;
+    s->short_seek_get = NULL;
+
+    return 0;
+}
+
+void ffio_prefetch_uninit(AVIOContext *s)
+{
+    PrefetchContext *c;
+    int ret;
+
+    if (s->read_packet != prefetch_read)
+        return;
+    c = s->opaque;
+
+    pthread_mutex_lock(&c->mutex);
+    c->abort_request = 1;
+    pthread_cond_signal(&c->cond_wakeup_background);
+    pthread_mutex_unlock(&c->mutex);
+
+    ret = pthread_join(c->thread, NULL);
+    if (ret)
+        av_log(s, AV_LOG_ERROR, "pthread_join(): %s\n", av_err2str(AVERROR(ret)));
+
+    av_log(s, AV_LOG_VERBOSE, "Prefetch statistics: %d of %d reads served "
+           "without waiting (%.1f%%), %"PRId64" ms stalled, %d seeks in "
+           "buffer, %d flushes\n", c->nb_reads - c->nb_stalls, c->nb_reads,
+           c->nb_reads ? 100.0 * (c->nb_reads - c->nb_stalls) / c->nb_reads : 0.0,
+           c->stall_time / 1000, c->nb_buffer_seeks, c->nb_flushes);
+
+    pthread_cond_destroy(&c->cond_wakeup_background);
+    pthread_cond_destroy(&c->cond_wakeup_main);
+    pthread_mutex_destroy(&c->mutex);
+
+    c->h->interrupt_callback = c->interrupt_callback;
+    s->opaque         = c->h;
+    s->read_packet    = (int (*)(void *, uint8_t *, int))ffurl_read;
+    s->seek           = (int64_t (*)(void *, int64_t, int))ffurl_seek;
+    s->short_seek_get = (int (*)(void *))ffurl_get_short_seek;
+    prefetch_free(c);
+}
+
+#else
+
+int ffio_prefetch_init(AVIOContext *s, int size)
+{
+    return AVERROR(ENOSYS);
+}
+
+void ffio_prefetch_uninit(AVIOContext *s)
+{
+}
+
+#endif /* HAVE_THREADS */
@@ -0,0 +1,303 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavformat/udp.c"
+
+#include <stdio.h>
+
+#include "libavutil/time.h"
+
+#define NB_SENT 10
+
+static void fill(uint8_t *buf, int len, int seed)
+{
+    int i;
+
+    for (i = 0; i < len; i++)
+        buf[i] = seed * 31 + i;
+}
+
+static int check(const uint8_t *buf, int len, int seed)
+{
+    int i;
+
+    for (i = 0; i < len; i++)
+        if (buf[i] != (uint8_t)(seed * 31 + i))
+            return 0;
+    return 1;
+}
+
+/* Pass datagrams of varying sizes through a small ring, wrapping around. */
+static int test_ring(void)
+{
+    UDPContext s = { 0 };
+    uint8_t in[300], out[300];
+    int i, j, ret, written = 0, read = 0, full = 0;
+
+    s.fifo_size = 1000 + 1;
+    s.fifo      = av_malloc(s.fifo_size);
+    if (!s.fifo)
+        return AVERROR(ENOMEM);
+    atomic_init(&s.fifo_rpos, 0);
+    atomic_init(&s.fifo_wpos, 0);
+
+    if (fifo_read(&s, out, sizeof(out)) != AVERROR(EAGAIN)) {
+        printf("ring: read from an empty ring\n");
+        goto fail;
+    }
+
+    for (i = 0; i < 50; i++) {
+        /* fill the ring up, then drain all but one datagram */
+        for (;;) {
+            int len = 1 + written * 37 % 296;
+            fill(in, len, written);
+            if (fifo_write(&s, in, len) < 0)
+                break;
+            written++;
+        }
+        full++;
+        while (read < written - 1) {
+            int len = 1 + read * 37 % 296;
+            ret = fifo_read(&s, out, sizeof(out));
+            if (ret != len || !check(out, len, read)) {
+                printf("ring: datagram %d read back as %d bytes, %d expected\n",
+                       read, ret, len);
+                goto fail;
+            }
+            read++;
+        }
+    }
+
+    ret = fifo_read(&s, out, sizeof(out));
+    if (ret != 1 + read * 37 % 296 || !check(out, ret, read)) {
+        printf("ring: last datagram read back as %d bytes\n", ret);
+        goto fail;
+    }
+    read++;
+
+    /* the rest of a datagram longer than the read size is dropped */
+    fill(in, 300, 1000);
+    if (fifo_write(&s, in, 300) < 0 || fifo_write(&s, in, 20) < 0) {
+        printf("ring: could not refill the ring\n");
+        goto fail;
+    }
+    ret = fifo_read(&s, out, 100);
+    j   = fifo_read(&s, out + 100, 100);
+    if (ret != 300 || !check(out, 100, 1000) || j != 20 || !check(out + 100, 20, 1000)) {
+        printf("ring: partial read returned %d and %d\n", ret, j);
+        goto fail;
+    }
+    if (fifo_read(&s, out, sizeof(out)) != AVERROR(EAGAIN)) {
+        printf("ring: not empty after reading everything\n");
+        goto fail;
+    }
+
+    printf("ring: %d datagrams in %d fills, all intact\n", read, full);
+    av_free(s.fifo);
+    return 0;
+
+fail:
+    av_free(s.fifo);
+    return AVERROR(EINVAL);
+}
+
+static int open_receiver(URLContext **h, const char *opts)
+{
+    char url[256];
+
+    /* reads give up after 100 ms without a datagram */
+    snprintf(url, sizeof(url), "udp://127.0.0.1:0?timeout=100000&%s", opts);
+    return ffurl_open_whitelist(h, url, AVIO_FLAG_READ, NULL, NULL,
+                                NULL, NULL, NULL);
+}
+
+static int open_sender(URLContext *h, struct sockaddr_in *addr)
+{
+    int fd = ff_socket(AF_INET, SOCK_DGRAM, 0);
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family      = AF_INET;
+    addr->sin_port        = htons(ff_udp_get_local_port(h));
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return fd;
+}
+
+static int send_datagram(int fd, const struct sockaddr_in *addr, int len, int seed)
+{
+    uint8_t buf[2000];
+
+    fill(buf, len, seed);
+    if (sendto(fd, buf, len, 0, (const struct sockaddr *)addr, sizeof(*addr)) != len)
+        return ff_neterrno();
+    return 0;
+}
+
+/* Read datagrams until the read times out. */
+static int receive_all(URLContext *h, int size, int *count)
+{
+    uint8_t buf[2000];
+    int ret;
+
+    *count = 0;
+    while ((ret = ffurl_read(h, buf, size)) > 0)
+        (*count)++;
+    return ret == AVERROR(EIO) ? 0 : ret;
+}
+
+/* Overflow a small circular buffer, every dropped datagram is counted. */
+static int test_overruns(void)
+{
+    URLContext *h = NULL;
+    struct sockaddr_in addr;
+    int64_t overruns = -1;
+    int i, fd, ret, received;
+
+    /* room for 3 datagrams of 500 bytes and their size prefix */
+    if ((ret = open_receiver(&h, "fifo_size=10&overrun_nonfatal=1")) < 0)
+        return ret;
+    if ((fd = open_sender(h, &addr)) < 0) {
+        ret = fd;
+        goto end;
+    }
+    for (i = 0; i < NB_SENT; i++)
+        if ((ret = send_datagram(fd, &addr, 500, i)) < 0)
+            goto end;
+    /* let the receiving thread fill the buffer before anything is read */
+    av_usleep(200000);
+
+    if ((ret = receive_all(h, 500, &received)) < 0)
+        goto end;
+    av_opt_get_int(h->priv_data, "fifo_overruns", 0, &overruns);
+    printf("overruns: %d datagrams sent, %d received, %"PRId64" dropped\n",
+           NB_SENT, received, overruns);
+
+end:
+    if (fd >= 0)
+        closesocket(fd);
+    ffurl_closep(&h);
+    return ret;
+}
+
+/* Datagrams longer than the read size are truncated, not merged. */
+static int test_truncation(void)
+{
+    URLContext *h = NULL;
+    struct sockaddr_in addr;
+    uint8_t buf[2000];
+    int fd, ret, len1, len2;
+
+    if ((ret = open_receiver(&h, "fifo_size=100")) < 0)
+        return ret;
+    if ((fd = open_sender(h, &addr)) < 0) {
+        ret = fd;
+        goto end;
+    }
+    if ((ret = send_datagram(fd, &addr, 1500, 1)) < 0 ||
+        (ret = send_datagram(fd, &addr,  200, 2)) < 0)
+        goto end;
+
+    len1 = ffurl_read(h, buf, 1000);
+    if (len1 != 1000 || !check(buf, 1000, 1)) {
+        printf("truncation: first read returned %d\n", len1);
+        ret = AVERROR(EINVAL);
+        goto end;
+    }
+    len2 = ffurl_read(h, buf, 1000);
+    if (len2 != 200 || !check(buf, 200, 2)) {
+        printf("truncation: second read returned %d\n", len2);
+        ret = AVERROR(EINVAL);
+        goto end;
+    }
+    printf("truncation: 1500 bytes read as %d, next datagram intact\n", len1);
+
+end:
+    if (fd >= 0)
+        closesocket(fd);
+    ffurl_closep(&h);
+    return ret;
+}
+
+/*
+ * Flood a small socket buffer. Every datagram must either be received,
+ * dropped at the circular buffer or reported as dropped by the kernel.
+ */
+static int test_kernel_drops(void)
+{
+    URLContext *h = NULL;
+    struct sockaddr_in addr;
+    int64_t overruns = 0, drops = 0;
+    int i, fd, ret, received, sent = 0;
+
+    if ((ret = open_receiver(&h, "buffer_size=8192&fifo_size=100000&overrun_nonfatal=1")) < 0)
+        return ret;
+    if ((fd = open_sender(h, &addr)) < 0) {
+        ret = fd;
+        goto end;
+    }
+    for (i = 0; i < 2000; i++, sent++)
+        if ((ret = send_datagram(fd, &addr, 1000, i)) < 0)
+            goto end;
+    /* the drops are reported along with the next datagram received */
+    av_usleep(100000);
+    if ((ret = send_datagram(fd, &addr, 1000, i)) < 0)
+        goto end;
+    sent++;
+
+    if ((ret = receive_all(h, 1000, &received)) < 0)
+        goto end;
+    av_opt_get_int(h->priv_data, "fifo_overruns", 0, &overruns);
+    av_opt_get_int(h->priv_data, "kernel_drops",  0, &drops);
+#ifdef SO_RXQ_OVFL
+    ret = received + overruns + drops == sent;
+#else
+    ret = received + overruns <= sent;
+#endif
+    if (!ret)
+        printf("kernel drops: %d sent, %d received, %"PRId64" + %"PRId64" dropped\n",
+               sent, received, overruns, drops);
+    else
+        printf("kernel drops: all datagrams accounted for\n");
+    ret = ret ? 0 : AVERROR(EINVAL);
+
+end:
+    if (fd >= 0)
+        closesocket(fd);
+    ffurl_closep(&h);
+    return ret;
+}
+
+int main(void)
+{
+    int ret;
+
+    av_log_set_level(AV_LOG_ERROR);
+
+    if ((ret = test_ring()) < 0) {
+        printf("error: %s\n", av_err2str(ret));
+        return 1;
+    }
+
+    if (!ff_network_init())
+        return 1;
+    if ((ret = test_overruns()) < 0 ||
+        (ret = test_truncation()) < 0 ||
+        (ret = test_kernel_drops()) < 0)
+        printf("error: %s\n", av_err2str(ret));
+    ff_network_close();
+    return ret < 0;
+}
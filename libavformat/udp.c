@@ -26,12 +26,14 @@
 
 #define _DEFAULT_SOURCE
 #define _BSD_SOURCE     /* Needed for using struct ip_mreq with recent glibc */
+#define _GNU_SOURCE     /* Needed for recvmmsg() and sendmmsg() */
+
+#include <stdatomic.h>
 
 #include "avformat.h"
 #include "avio_internal.h"
 #include "libavutil/avassert.h"
 #include "libavutil/parseutils.h"
-#include "libavutil/fifo.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/avstring.h"
 #include "libavutil/opt.h"
@@ -79,6 +81,7 @@
 #define UDP_RX_BUF_SIZE 393216
 #define UDP_MAX_PKT_SIZE 65536
 #define UDP_HEADER_SIZE 8
+#define UDP_MAX_BATCH 16
 
 typedef struct UDPContext {
     const AVClass *class;
@@ -98,8 +101,17 @@ typedef struct UDPContext {
 
     /* Circular Buffer variables for use in UDP receive code */
     int circular_buffer_size;
-    AVFifoBuffer *fifo;
-    int circular_buffer_error;
+    uint8_t *fifo;
+    size_t fifo_size;
+    atomic_size_t fifo_rpos;    ///< only written by the consumer
+    atomic_size_t fifo_wpos;    ///< only written by the producer
+    atomic_int circular_buffer_error;
+    atomic_uint nb_fifo_overruns;
+    atomic_uint nb_kernel_drops;
+    int64_t fifo_overruns;      ///< exported copy of nb_fifo_overruns
+    int64_t kernel_drops;       ///< exported copy of nb_kernel_drops
+    uint8_t *batch_buf;         ///< batch_size slots of UDP_MAX_PKT_SIZE bytes
+    int batch_size;
     int64_t bitrate; /* number of bits to send per second */
     int64_t burst_bits;
     int close_req;
@@ -109,7 +121,6 @@ typedef struct UDPContext {
     pthread_cond_t cond;
     int thread_started;
 #endif
-    uint8_t tmp[UDP_MAX_PKT_SIZE+4];
     int remaining_in_dg;
     char *localaddr;
     int timeout;
@@ -138,6 +149,8 @@ static const AVOption options[] = {
     { "connect",        "set if connect() should be called on socket",     OFFSET(is_connected),   AV_OPT_TYPE_BOOL,   { .i64 =  0 },     0, 1,       .flags = D|E },
     { "fifo_size",      "set the UDP receiving circular buffer size, expressed as a number of packets with size of 188 bytes", OFFSET(circular_buffer_size), AV_OPT_TYPE_INT, {.i64 = 7*4096}, 0, INT_MAX, D },
     { "overrun_nonfatal", "survive in case of UDP receiving circular buffer overrun", OFFSET(overrun_nonfatal), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1,    D },
+    { "fifo_overruns",  "export the number of datagrams dropped because the circular buffer was full", OFFSET(fifo_overruns), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+    { "kernel_drops",   "export the number of datagrams dropped because the socket buffer was full", OFFSET(kernel_drops), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
     { "timeout",        "set raise error timeout, in microseconds (only in read mode)",OFFSET(timeout),         AV_OPT_TYPE_INT,  {.i64 = 0}, 0, INT_MAX, D },
     { "sources",        "Source list",                                     OFFSET(sources),        AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "block",          "Block list",                                      OFFSET(block),          AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
@@ -460,6 +473,199 @@ static int udp_get_file_handle(URLContext *h)
 }
 
 #if HAVE_PTHREAD_CANCEL
+/*
+ * The circular buffer is a single-producer/single-consumer ring of
+ * datagrams, each prefixed with its size as a 32-bit little-endian value.
+ * Each side only ever updates its own position, so no lock is needed to
+ * pass data around; the mutex and condition are only used to sleep while
+ * the ring is empty. One byte is kept unused to tell a full ring from an
+ * empty one.
+ */
+static size_t fifo_copy_in(UDPContext *s, size_t wpos, const uint8_t *src, size_t len)
+{
+    size_t len1 = FFMIN(len, s->fifo_size - wpos);
+
+    memcpy(s->fifo + wpos, src, len1);
+    memcpy(s->fifo, src + len1, len - len1);
+    wpos += len;
+    return wpos >= s->fifo_size ? wpos - s->fifo_size : wpos;
+}
+
+static size_t fifo_copy_out(UDPContext *s, size_t rpos, uint8_t *dst, size_t len)
+{
+    size_t len1 = FFMIN(len, s->fifo_size - rpos);
+
+    if (dst) {
+        memcpy(dst, s->fifo + rpos, len1);
+        memcpy(dst + len1, s->fifo, len - len1);
+    }
+    rpos += len;
+    return rpos >= s->fifo_size ? rpos - s->fifo_size : rpos;
+}
+
+static int fifo_empty(UDPContext *s)
+{
+    return atomic_load_explicit(&s->fifo_rpos, memory_order_relaxed) ==
+           atomic_load_explicit(&s->fifo_wpos, memory_order_acquire);
+}
+
+/* Queue one datagram, called by the producer only. */
+static int fifo_write(UDPContext *s, const uint8_t *buf, int len)
+{
+    size_t rpos = atomic_load_explicit(&s->fifo_rpos, memory_order_acquire);
+    size_t wpos = atomic_load_explicit(&s->fifo_wpos, memory_order_relaxed);
+    size_t used = wpos >= rpos ? wpos - rpos : s->fifo_size - rpos + wpos;
+    uint8_t tmp[4];
+
+    if (s->fifo_size - 1 - used < len + 4)
+        return AVERROR(ENOSPC);
+
+    AV_WL32(tmp, len);
+    wpos = fifo_copy_in(s, wpos, tmp, 4);
+    wpos = fifo_copy_in(s, wpos, buf, len);
+    atomic_store_explicit(&s->fifo_wpos, wpos, memory_order_release);
+    return 0;
+}
+
+/**
+ * Dequeue one datagram, called by the consumer only.
+ * At most size bytes are copied to buf, the rest of the datagram is dropped.
+ * @return the full size of the datagram, or AVERROR(EAGAIN) if the ring is empty
+ */
+static int fifo_read(UDPContext *s, uint8_t *buf, int size)
+{
+    size_t wpos = atomic_load_explicit(&s->fifo_wpos, memory_order_acquire);
+    size_t rpos = atomic_load_explicit(&s->fifo_rpos, memory_order_relaxed);
+    uint8_t tmp[4];
+    int len;
+
+    if (rpos == wpos)
+        return AVERROR(EAGAIN);
+
+    rpos = fifo_copy_out(s, rpos, tmp, 4);
+    len  = AV_RL32(tmp);
+    rpos = fifo_copy_out(s, rpos, buf, FFMIN(len, size));
+    rpos = fifo_copy_out(s, rpos, NULL, len - FFMIN(len, size));
+    atomic_store_explicit(&s->fifo_rpos, rpos, memory_order_release);
+    return len;
+}
+
+/**
+ * Receive up to batch_size datagrams into the slots of batch_buf, blocking
+ * until at least one is available.
+ * @return the number of datagrams received or a negative error code
+ */
+static int udp_recv_batch(UDPContext *s, struct sockaddr_storage *addr, int *len)
+{
+#if HAVE_RECVMMSG
+    struct mmsghdr msg[UDP_MAX_BATCH] = { { { 0 } } };
+    struct iovec iov[UDP_MAX_BATCH];
+#ifdef SO_RXQ_OVFL
+    union {
+        struct cmsghdr align;
+        uint8_t buf[CMSG_SPACE(sizeof(uint32_t))];
+    } control[UDP_MAX_BATCH];
+#endif
+    int i, n;
+
+    for (i = 0; i < s->batch_size; i++) {
+        iov[i].iov_base = s->batch_buf + i * UDP_MAX_PKT_SIZE;
+        iov[i].iov_len  = UDP_MAX_PKT_SIZE;
+        msg[i].msg_hdr.msg_name    = &addr[i];
+        msg[i].msg_hdr.msg_namelen = sizeof(addr[i]);
+        msg[i].msg_hdr.msg_iov     = &iov[i];
+        msg[i].msg_hdr.msg_iovlen  = 1;
+#ifdef SO_RXQ_OVFL
+        msg[i].msg_hdr.msg_control    = control[i].buf;
+        msg[i].msg_hdr.msg_controllen = sizeof(control[i].buf);
+#endif
+    }
+
+    n = recvmmsg(s->udp_fd, msg, s->batch_size, MSG_WAITFORONE, NULL);
+    if (n < 0)
+        return ff_neterrno();
+
+    for (i = 0; i < n; i++) {
+#ifdef SO_RXQ_OVFL
+        struct cmsghdr *cmsg;
+        for (cmsg = CMSG_FIRSTHDR(&msg[i].msg_hdr); cmsg;
+             cmsg = CMSG_NXTHDR(&msg[i].msg_hdr, cmsg)) {
+            /* the kernel reports the total number of drops so far */
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+                atomic_store(&s->nb_kernel_drops, AV_RN32(CMSG_DATA(cmsg)));
+        }
+#endif
+        len[i] = msg[i].msg_len;
+    }
+    return n;
+#else
+    socklen_t addr_len = sizeof(*addr);
+
+    len[0] = recvfrom(s->udp_fd, s->batch_buf, UDP_MAX_PKT_SIZE, 0,
+                      (struct sockaddr *)addr, &addr_len);
+    return len[0] < 0 ? ff_neterrno() : 1;
+#endif
+}
+
+/**
+ * Send the first nb datagrams of batch_buf.
+ * @return 0 on success or a negative error code
+ */
+static int udp_send_batch(UDPContext *s, const int *len, int nb)
+{
+#if HAVE_SENDMMSG
+    struct mmsghdr msg[UDP_MAX_BATCH] = { { { 0 } } };
+    struct iovec iov[UDP_MAX_BATCH];
+    int i, ret;
+
+    for (i = 0; i < nb; i++) {
+        iov[i].iov_base = s->batch_buf + i * UDP_MAX_PKT_SIZE;
+        iov[i].iov_len  = len[i];
+        if (!s->is_connected) {
+            msg[i].msg_hdr.msg_name    = &s->dest_addr;
+            msg[i].msg_hdr.msg_namelen = s->dest_addr_len;
+        }
+        msg[i].msg_hdr.msg_iov    = &iov[i];
+        msg[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    for (i = 0; i < nb;) {
+        ret = sendmmsg(s->udp_fd, msg + i, nb - i, 0);
+        if (ret >= 0) {
+            i += ret;
+        } else {
+            ret = ff_neterrno();
+            if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR))
+                return ret;
+        }
+    }
+#else
+    const uint8_t *p = s->batch_buf;
+    int size = len[0];
+
+    av_assert0(nb == 1);
+    while (size) {
+        int ret;
+        av_assert0(size > 0);
+        if (!s->is_connected) {
+            ret = sendto (s->udp_fd, p, size, 0,
+                        (struct sockaddr *) &s->dest_addr,
+                        s->dest_addr_len);
+        } else
+            ret = send(s->udp_fd, p, size, 0);
+        if (ret >= 0) {
+            size -= ret;
+            p    += ret;
+        } else {
+            ret = ff_neterrno();
+            if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR))
+                return ret;
+        }
+    }
+#endif
+    return 0;
+}
+
 static void *circular_buffer_task_rx( void *_URLContext)
 {
     URLContext *h = _URLContext;
@@ -467,55 +673,57 @@ static void *circular_buffer_task_rx( void *_URLContext)
     int old_cancelstate;
 
     pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
-    pthread_mutex_lock(&s->mutex);
     if (ff_socket_nonblock(s->udp_fd, 0) < 0) {
         av_log(h, AV_LOG_ERROR, "Failed to set blocking mode");
-        s->circular_buffer_error = AVERROR(EIO);
+        atomic_store(&s->circular_buffer_error, AVERROR(EIO));
         goto end;
     }
     while(1) {
-        int len;
-        struct sockaddr_storage addr;
-        socklen_t addr_len = sizeof(addr);
+        struct sockaddr_storage addr[UDP_MAX_BATCH];
+        int len[UDP_MAX_BATCH];
+        int i, n;
 
-        pthread_mutex_unlock(&s->mutex);
         /* Blocking operations are always cancellation points;
            see "General Information" / "Thread Cancelation Overview"
            in Single Unix. */
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
-        len = recvfrom(s->udp_fd, s->tmp+4, sizeof(s->tmp)-4, 0, (struct sockaddr *)&addr, &addr_len);
+        n = udp_recv_batch(s, addr, len);
         pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
-        pthread_mutex_lock(&s->mutex);
-        if (len < 0) {
-            if (ff_neterrno() != AVERROR(EAGAIN) && ff_neterrno() != AVERROR(EINTR)) {
-                s->circular_buffer_error = ff_neterrno();
+        if (n < 0) {
+            if (n != AVERROR(EAGAIN) && n != AVERROR(EINTR)) {
+                atomic_store(&s->circular_buffer_error, n);
                 goto end;
             }
             continue;
         }
-        if (ff_ip_check_source_lists(&addr, &s->filters))
-            continue;
-        AV_WL32(s->tmp, len);
 
-        if(av_fifo_space(s->fifo) < len + 4) {
-            /* No Space left */
-            if (s->overrun_nonfatal) {
-                av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
-                        "Surviving due to overrun_nonfatal option\n");
+        for (i = 0; i < n; i++) {
+            if (ff_ip_check_source_lists(&addr[i], &s->filters))
                 continue;
-            } else {
-                av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
-                        "To avoid, increase fifo_size URL option. "
-                        "To survive in such case, use overrun_nonfatal option\n");
-                s->circular_buffer_error = AVERROR(EIO);
-                goto end;
+            if (fifo_write(s, s->batch_buf + i * UDP_MAX_PKT_SIZE, len[i]) < 0) {
+                /* No Space left */
+                atomic_fetch_add(&s->nb_fifo_overruns, 1);
+                if (s->overrun_nonfatal) {
+                    av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
+                            "Surviving due to overrun_nonfatal option\n");
+                    continue;
+                } else {
+                    av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
+                            "To avoid, increase fifo_size URL option. "
+                            "To survive in such case, use overrun_nonfatal option\n");
+                    atomic_store(&s->circular_buffer_error, AVERROR(EIO));
+                    goto end;
+                }
             }
         }
-        av_fifo_generic_write(s->fifo, s->tmp, len+4, NULL);
+
+        pthread_mutex_lock(&s->mutex);
         pthread_cond_signal(&s->cond);
+        pthread_mutex_unlock(&s->mutex);
     }
 
 end:
+    pthread_mutex_lock(&s->mutex);
     pthread_cond_signal(&s->cond);
     pthread_mutex_unlock(&s->mutex);
     return NULL;
@@ -531,86 +739,65 @@ static void *circular_buffer_task_tx( void *_URLContext)
     int64_t burst_interval = s->bitrate ? (s->burst_bits * 1000000 / s->bitrate) : 0;
     int64_t max_delay = s->bitrate ?  ((int64_t)h->max_packet_size * 8 * 1000000 / s->bitrate + 1) : 0;
 
-    pthread_mutex_lock(&s->mutex);
-
     if (ff_socket_nonblock(s->udp_fd, 0) < 0) {
         av_log(h, AV_LOG_ERROR, "Failed to set blocking mode");
-        s->circular_buffer_error = AVERROR(EIO);
-        goto end;
+        atomic_store(&s->circular_buffer_error, AVERROR(EIO));
+        return NULL;
     }
 
     for(;;) {
-        int len;
-        const uint8_t *p;
-        uint8_t tmp[4];
-        int64_t timestamp;
-
-        len = av_fifo_size(s->fifo);
-
-        while (len<4) {
-            if (s->close_req)
-                goto end;
-            if (pthread_cond_wait(&s->cond, &s->mutex) < 0) {
-                goto end;
-            }
-            len = av_fifo_size(s->fifo);
-        }
-
-        av_fifo_generic_read(s->fifo, tmp, 4, NULL);
-        len = AV_RL32(tmp);
-
-        av_assert0(len >= 0);
-        av_assert0(len <= sizeof(s->tmp));
-
-        av_fifo_generic_read(s->fifo, s->tmp, len, NULL);
-
-        pthread_mutex_unlock(&s->mutex);
-
-        if (s->bitrate) {
-            timestamp = av_gettime_relative();
-            if (timestamp < target_timestamp) {
-                int64_t delay = target_timestamp - timestamp;
-                if (delay > max_delay) {
-                    delay = max_delay;
-                    start_timestamp = timestamp + delay;
-                    sent_bits = 0;
-                }
-                av_usleep(delay);
-            } else {
-                if (timestamp - burst_interval > target_timestamp) {
-                    start_timestamp = timestamp - burst_interval;
-                    sent_bits = 0;
+        int len[UDP_MAX_BATCH];
+        int64_t timestamp = 0;
+        int nb = 0, ret;
+
+        if (fifo_empty(s)) {
+            pthread_mutex_lock(&s->mutex);
+            while (fifo_empty(s)) {
+                if (s->close_req)
+                    goto end;
+                if (pthread_cond_wait(&s->cond, &s->mutex) < 0) {
+                    goto end;
                 }
             }
-            sent_bits += len * 8;
-            target_timestamp = start_timestamp + sent_bits * 1000000 / s->bitrate;
+            pthread_mutex_unlock(&s->mutex);
         }
 
-        p = s->tmp;
-        while (len) {
-            int ret;
-            av_assert0(len > 0);
-            if (!s->is_connected) {
-                ret = sendto (s->udp_fd, p, len, 0,
-                            (struct sockaddr *) &s->dest_addr,
-                            s->dest_addr_len);
-            } else
-                ret = send(s->udp_fd, p, len, 0);
-            if (ret >= 0) {
-                len -= ret;
-                p   += ret;
-            } else {
-                ret = ff_neterrno();
-                if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR)) {
-                    pthread_mutex_lock(&s->mutex);
-                    s->circular_buffer_error = ret;
-                    pthread_mutex_unlock(&s->mutex);
-                    return NULL;
+        /* Send the queued datagrams that are already due in one go. */
+        do {
+            ret = fifo_read(s, s->batch_buf + nb * UDP_MAX_PKT_SIZE, UDP_MAX_PKT_SIZE);
+            if (ret < 0)
+                break;
+            len[nb] = FFMIN(ret, UDP_MAX_PKT_SIZE);
+
+            if (s->bitrate) {
+                if (!nb)
+                    timestamp = av_gettime_relative();
+                if (timestamp < target_timestamp) {
+                    int64_t delay = target_timestamp - timestamp;
+                    if (delay > max_delay) {
+                        delay = max_delay;
+                        start_timestamp = timestamp + delay;
+                        sent_bits = 0;
+                    }
+                    av_usleep(delay);
+                } else {
+                    if (timestamp - burst_interval > target_timestamp) {
+                        start_timestamp = timestamp - burst_interval;
+                        sent_bits = 0;
+                    }
                 }
+                sent_bits += len[nb] * 8;
+                target_timestamp = start_timestamp + sent_bits * 1000000 / s->bitrate;
             }
+            nb++;
+        } while (nb < s->batch_size &&
+                 (!s->bitrate || timestamp >= target_timestamp));
+
+        ret = udp_send_batch(s, len, nb);
+        if (ret < 0) {
+            atomic_store(&s->circular_buffer_error, ret);
+            return NULL;
         }
-
-        pthread_mutex_lock(&s->mutex);
     }
 
 end:
@@ -875,6 +1062,13 @@ static int udp_open(URLContext *h, const char *uri, int flags)
                 av_log(h, AV_LOG_WARNING, "attempted to set receive buffer to size %d but it only ended up set as %d\n", s->buffer_size, tmp);
         }
 
+#ifdef SO_RXQ_OVFL
+        /* have the number of datagrams dropped by the kernel reported */
+        tmp = 1;
+        if (setsockopt(udp_fd, SOL_SOCKET, SO_RXQ_OVFL, &tmp, sizeof(tmp)) < 0)
+            ff_log_net_error(h, AV_LOG_DEBUG, "setsockopt(SO_RXQ_OVFL)");
+#endif
+
         /* make the socket non-blocking */
         ff_socket_nonblock(udp_fd, 1);
     }
@@ -902,8 +1096,11 @@ static int udp_open(URLContext *h, const char *uri, int flags)
 
     if ((!is_output && s->circular_buffer_size) || (is_output && s->bitrate && s->circular_buffer_size)) {
         /* start the task going */
-        s->fifo = av_fifo_alloc(s->circular_buffer_size);
-        if (!s->fifo) {
+        s->batch_size = (is_output ? HAVE_SENDMMSG : HAVE_RECVMMSG) ? UDP_MAX_BATCH : 1;
+        s->fifo_size  = s->circular_buffer_size + 1;
+        s->fifo       = av_malloc(s->fifo_size);
+        s->batch_buf  = av_malloc(s->batch_size * UDP_MAX_PKT_SIZE);
+        if (!s->fifo || !s->batch_buf) {
             ret = AVERROR(ENOMEM);
             goto fail;
         }
@@ -939,7 +1136,8 @@ static int udp_open(URLContext *h, const char *uri, int flags)
  fail:
     if (udp_fd >= 0)
         closesocket(udp_fd);
-    av_fifo_freep(&s->fifo);
+    av_freep(&s->fifo);
+    av_freep(&s->batch_buf);
     ff_ip_reset_filters(&s->filters);
     return ret;
 }
@@ -961,32 +1159,22 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
     struct sockaddr_storage addr;
     socklen_t addr_len = sizeof(addr);
 #if HAVE_PTHREAD_CANCEL
-    int avail, nonblock = h->flags & AVIO_FLAG_NONBLOCK;
+    int avail, err, nonblock = h->flags & AVIO_FLAG_NONBLOCK;
 
     if (s->fifo) {
-        pthread_mutex_lock(&s->mutex);
         do {
-            avail = av_fifo_size(s->fifo);
-            if (avail) { // >=size) {
-                uint8_t tmp[4];
-
-                av_fifo_generic_read(s->fifo, tmp, 4, NULL);
-                avail = AV_RL32(tmp);
+            avail = fifo_read(s, buf, size);
+            s->fifo_overruns = atomic_load(&s->nb_fifo_overruns);
+            s->kernel_drops  = atomic_load(&s->nb_kernel_drops);
+            if (avail >= 0) {
                 if(avail > size){
                     av_log(h, AV_LOG_WARNING, "Part of datagram lost due to insufficient buffer size\n");
                     avail = size;
                 }
-
-                av_fifo_generic_read(s->fifo, buf, avail, NULL);
-                av_fifo_drain(s->fifo, AV_RL32(tmp) - avail);
-                pthread_mutex_unlock(&s->mutex);
                 return avail;
-            } else if(s->circular_buffer_error){
-                int err = s->circular_buffer_error;
-                pthread_mutex_unlock(&s->mutex);
+            } else if ((err = atomic_load(&s->circular_buffer_error))) {
                 return err;
             } else if(nonblock) {
-                pthread_mutex_unlock(&s->mutex);
                 return AVERROR(EAGAIN);
             } else {
                 /* FIXME: using the monotonic clock would be better,
@@ -994,11 +1182,12 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
                 int64_t t = av_gettime() + 100000;
                 struct timespec tv = { .tv_sec  =  t / 1000000,
                                        .tv_nsec = (t % 1000000) * 1000 };
-                int err = pthread_cond_timedwait(&s->cond, &s->mutex, &tv);
-                if (err) {
-                    pthread_mutex_unlock(&s->mutex);
+                pthread_mutex_lock(&s->mutex);
+                if (fifo_empty(s) && !atomic_load(&s->circular_buffer_error))
+                    err = pthread_cond_timedwait(&s->cond, &s->mutex, &tv);
+                pthread_mutex_unlock(&s->mutex);
+                if (err)
                     return AVERROR(err == ETIMEDOUT ? EAGAIN : err);
-                }
                 nonblock = 1;
             }
         } while(1);
@@ -1025,28 +1214,19 @@ static int udp_write(URLContext *h, const uint8_t *buf, int size)
 
 #if HAVE_PTHREAD_CANCEL
     if (s->fifo) {
-        uint8_t tmp[4];
-
-        pthread_mutex_lock(&s->mutex);
-
         /*
           Return error if last tx failed.
           Here we can't know on which packet error was, but it needs to know that error exists.
         */
-        if (s->circular_buffer_error<0) {
-            int err = s->circular_buffer_error;
-            pthread_mutex_unlock(&s->mutex);
+        int err = atomic_load(&s->circular_buffer_error);
+        if (err < 0)
             return err;
-        }
 
-        if(av_fifo_space(s->fifo) < size + 4) {
+        if (fifo_write(s, buf, size) < 0) {
             /* What about a partial packet tx ? */
-            pthread_mutex_unlock(&s->mutex);
             return AVERROR(ENOMEM);
         }
-        AV_WL32(tmp, size);
-        av_fifo_generic_write(s->fifo, tmp, 4, NULL); /* size of packet */
-        av_fifo_generic_write(s->fifo, (uint8_t *)buf, size, NULL); /* the data */
+        pthread_mutex_lock(&s->mutex);
         pthread_cond_signal(&s->cond);
         pthread_mutex_unlock(&s->mutex);
         return size;
@@ -1107,7 +1287,8 @@ static int udp_close(URLContext *h)
     }
 #endif
     closesocket(s->udp_fd);
-    av_fifo_freep(&s->fifo);
+    av_freep(&s->fifo);
+    av_freep(&s->batch_buf);
     ff_ip_reset_filters(&s->filters);
     return 0;
 }
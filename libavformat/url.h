@@ -27,6 +27,7 @@
 #include "avio.h"
 #include "libavformat/version.h"
 
+#include "libavutil/buffer.h"
 #include "libavutil/dict.h"
 #include "libavutil/log.h"
 
@@ -96,6 +97,12 @@ typedef struct URLProtocol {
     int (*url_close_dir)(URLContext *h);
     int (*url_delete)(URLContext *h);
     int (*url_move)(URLContext *h_src, URLContext *h_dst);
+    /**
+     * Export size bytes at the absolute position pos as a read-only
+     * reference instead of copying them, see ffurl_read_ref().
+     * Does not change the read position.
+     */
+    int (*url_read_ref)(URLContext *h, int64_t pos, int size, AVBufferRef **buf);
     const char *default_whitelist;
 } URLProtocol;
 
@@ -254,6 +261,19 @@ int ffurl_get_multi_file_handle(URLContext *h, int **handles, int *numhandles);
  */
 int ffurl_get_short_seek(URLContext *h);
 
+/**
+ * Get a reference to size bytes at the absolute position pos without
+ * copying them, if the protocol supports it (e.g. a memory mapped file).
+ *
+ * The returned buffer is read-only and at least
+ * AV_INPUT_BUFFER_PADDING_SIZE bytes following the data are readable,
+ * but not necessarily zeroed. The read position is not changed.
+ *
+ * @return size on success, AVERROR(ENOSYS) if the data cannot be
+ *         exported this way, another negative value on error
+ */
+int ffurl_read_ref(URLContext *h, int64_t pos, int size, AVBufferRef **buf);
+
 /**
  * Signal the URLContext that we are done reading or writing the stream.
  *
@@ -25,12 +25,14 @@
 
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
+#include "libavutil/cpu.h"
 #include "libavutil/dict.h"
 #include "libavutil/internal.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/pixfmt.h"
+#include "libavutil/slicethread.h"
 #include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "libavutil/timestamp.h"
@@ -317,6 +319,23 @@ int av_get_packet(AVIOContext *s, AVPacket *pkt, int size)
     return append_packet_chunked(s, pkt, size);
 }
 
+int ff_get_packet_ref(AVIOContext *s, AVPacket *pkt, int size)
+{
+    int64_t pos = avio_tell(s);
+    AVBufferRef *buf;
+
+    if (ffio_read_ref(s, &buf, size) < 0)
+        return av_get_packet(s, pkt, size);
+
+    av_init_packet(pkt);
+    pkt->buf  = buf;
+    pkt->data = buf->data;
+    pkt->size = size;
+    pkt->pos  = pos;
+
+    return size;
+}
+
 int av_append_packet(AVIOContext *s, AVPacket *pkt, int size)
 {
     if (!pkt->size)
@@ -629,6 +648,9 @@ FF_ENABLE_DEPRECATION_WARNINGS
 
     s->internal->raw_packet_buffer_remaining_size = RAW_PACKET_BUFFER_SIZE;
 
+    if (s->index_cache && (ret = ff_index_cache_load(s)) < 0)
+        goto close;
+
     update_stream_avctx(s);
 
     for (i = 0; i < s->nb_streams; i++)
@@ -1805,6 +1827,8 @@ return_packet:
         ff_reduce_index(s, st->index);
         av_add_index_entry(st, pkt->pos, pkt->dts, 0, 0, AVINDEX_KEYFRAME);
     }
+    if (s->index_cache && pkt->flags & AV_PKT_FLAG_KEY)
+        ff_index_cache_add(s, st, pkt);
 
     if (is_relative(pkt->dts))
         pkt->dts -= RELATIVE_TS_BASE;
@@ -1884,6 +1908,7 @@ void ff_read_frame_flush(AVFormatContext *s)
         }
         st->last_IP_pts = AV_NOPTS_VALUE;
         st->internal->last_dts_for_order_check = AV_NOPTS_VALUE;
+        st->internal->cache_index_sequential = 0;
         if (st->first_dts == AV_NOPTS_VALUE)
             st->cur_dts = RELATIVE_TS_BASE;
         else
@@ -2452,6 +2477,9 @@ static int seek_frame_internal(AVFormatContext *s, int stream_index,
     if (ret >= 0)
         return 0;
 
+    if (s->index_cache && ff_index_cache_seek(s, stream_index, timestamp, flags) >= 0)
+        return 0;
+
     if (s->iformat->read_timestamp &&
         !(s->iformat->flags & AVFMT_NOBINSEARCH)) {
         ff_read_frame_flush(s);
@@ -2991,8 +3019,10 @@ static int has_codec_parameters(AVStream *st, const char **errmsg_ptr)
 }
 
 /* returns 1 or 0 if or if not decoded data was returned, or a negative error */
+/* nb_frames is the value of st->codec_info_nb_frames when avpkt was read */
 static int try_decode_frame(AVFormatContext *s, AVStream *st,
-                            const AVPacket *avpkt, AVDictionary **options)
+                            const AVPacket *avpkt, AVDictionary **options,
+                            int nb_frames)
 {
     AVCodecContext *avctx = st->internal->avctx;
     const AVCodec *codec;
@@ -3053,7 +3083,7 @@ static int try_decode_frame(AVFormatContext *s, AVStream *st,
     while ((pkt.size > 0 || (!pkt.data && got_picture)) &&
            ret >= 0 &&
            (!has_codec_parameters(st, NULL) || !has_decode_delay_been_guessed(st) ||
-            (!st->codec_info_nb_frames &&
+            (!nb_frames &&
              (avctx->codec->capabilities & AV_CODEC_CAP_CHANNEL_CONF)))) {
         got_picture = 0;
         if (avctx->codec_type == AVMEDIA_TYPE_VIDEO ||
@@ -3095,6 +3125,111 @@ fail:
     return ret;
 }
 
+typedef struct ProbeDecode {
+    AVStream *st;
+    const AVPacket *pkt;
+    AVDictionary **options;
+    int nb_frames;
+} ProbeDecode;
+
+/**
+ * Packets whose trial decoding is deferred, so that the packets of a batch
+ * can be decoded for different streams in parallel. Each stream is decoded
+ * by a single job, in read order; the codec contexts are not touched by the
+ * reading thread while a batch is decoded.
+ */
+typedef struct ProbeDecodeBatch {
+    AVFormatContext *ic;
+    AVSliceThread *thread;
+    ProbeDecode *pending;
+    int nb_pending;
+    int *streams;       ///< indexes of the streams with pending packets
+    int nb_streams;
+    int size;
+} ProbeDecodeBatch;
+
+static void probe_decode_worker(void *priv, int jobnr, int threadnr,
+                                int nb_jobs, int nb_threads)
+{
+    ProbeDecodeBatch *b = priv;
+    int i, index = b->streams[jobnr];
+
+    for (i = 0; i < b->nb_pending; i++) {
+        ProbeDecode *d = &b->pending[i];
+        if (d->st->index == index)
+            try_decode_frame(b->ic, d->st, d->pkt, d->options, d->nb_frames);
+    }
+}
+
+static int probe_decode_init(ProbeDecodeBatch *b, AVFormatContext *ic)
+{
+    int nb_threads = ic->probe_threads ? ic->probe_threads : av_cpu_count();
+
+    memset(b, 0, sizeof(*b));
+    b->ic = ic;
+    /* the packets are only guaranteed to stay around when buffered */
+    if (nb_threads <= 1 || ic->flags & AVFMT_FLAG_NOBUFFER)
+        return 0;
+
+    b->size     = FFMAX(ic->nb_streams, 2 * nb_threads);
+    b->pending  = av_malloc_array(b->size, sizeof(*b->pending));
+    b->streams  = av_malloc_array(b->size, sizeof(*b->streams));
+    if (!b->pending || !b->streams)
+        return AVERROR(ENOMEM);
+    if (avpriv_slicethread_create(&b->thread, b, probe_decode_worker,
+                                  NULL, nb_threads) < 0) {
+        av_log(ic, AV_LOG_VERBOSE, "Probing streams without threads\n");
+        b->thread = NULL;
+    }
+    return 0;
+}
+
+static void probe_decode_flush(ProbeDecodeBatch *b)
+{
+    if (!b->nb_pending)
+        return;
+    avpriv_slicethread_execute(b->thread, b->nb_streams, 0);
+    b->nb_pending = b->nb_streams = 0;
+}
+
+static void probe_decode_uninit(ProbeDecodeBatch *b)
+{
+    avpriv_slicethread_free(&b->thread);
+    av_freep(&b->pending);
+    av_freep(&b->streams);
+}
+
+/**
+ * Decode pkt to fill in the codec parameters of st, either right away or
+ * as part of the next batch.
+ */
+static void probe_decode(ProbeDecodeBatch *b, AVStream *st,
+                         const AVPacket *pkt, AVDictionary **options)
+{
+    ProbeDecode *d;
+    int i;
+
+    if (!b->thread) {
+        try_decode_frame(b->ic, st, pkt, options, st->codec_info_nb_frames);
+        return;
+    }
+
+    for (i = 0; i < b->nb_streams; i++)
+        if (b->streams[i] == st->index)
+            break;
+    if (i == b->nb_streams)
+        b->streams[b->nb_streams++] = st->index;
+
+    d = &b->pending[b->nb_pending++];
+    d->st        = st;
+    d->pkt       = pkt;
+    d->options   = options;
+    d->nb_frames = st->codec_info_nb_frames;
+
+    if (b->nb_pending == b->size)
+        probe_decode_flush(b);
+}
+
 unsigned int ff_codec_get_tag(const AVCodecTag *tags, enum AVCodecID id)
 {
     while (tags->id != AV_CODEC_ID_NONE) {
@@ -3591,10 +3726,23 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
     int64_t max_subtitle_analyze_duration;
     int64_t probesize = ic->probesize;
     int eof_reached = 0;
+    int missing_params = 0;
+    int64_t start_time = av_gettime_relative();
+    ProbeDecodeBatch probe;
     int *missing_streams = av_opt_ptr(ic->iformat->priv_class, ic->priv_data, "missing_streams");
 
     flush_codecs = probesize > 0;
 
+    if (ic->internal->index_cache_hit) {
+        av_log(ic, AV_LOG_DEBUG, "Stream parameters taken from the index cache\n");
+        return 0;
+    }
+
+    if ((ret = probe_decode_init(&probe, ic)) < 0) {
+        probe_decode_uninit(&probe);
+        return ret;
+    }
+
     av_opt_set(ic, "skip_clear", "1", AV_OPT_SEARCH_CHILDREN);
 
     max_stream_analyze_duration = max_analyze_duration;
@@ -3785,6 +3933,14 @@ FF_ENABLE_DEPRECATION_WARNINGS
                            "consider increasing probesize\n", i);
             break;
         }
+        if (ic->max_probe_latency > 0 &&
+            av_gettime_relative() - start_time >= ic->max_probe_latency) {
+            ret = count;
+            av_log(ic, AV_LOG_DEBUG,
+                   "Probe latency limit of %"PRId64" microseconds reached\n",
+                   ic->max_probe_latency);
+            break;
+        }
 
         /* NOTE: A new stream can be added there if no header in file
          * (AVFMTCTX_NOHEADER). */
@@ -3920,8 +4076,9 @@ FF_ENABLE_DEPRECATION_WARNINGS
          * least one frame of codec data, this makes sure the codec initializes
          * the channel configuration and does not only trust the values from
          * the container. */
-        try_decode_frame(ic, st, pkt,
-                         (options && i < orig_nb_streams) ? &options[i] : NULL);
+        probe_decode(&probe, st, pkt,
+                     (options && pkt->stream_index < orig_nb_streams) ?
+                     &options[pkt->stream_index] : NULL);
 
         if (ic->flags & AVFMT_FLAG_NOBUFFER)
             av_packet_unref(&pkt1);
@@ -3929,6 +4086,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
         st->codec_info_nb_frames++;
         count++;
     }
+    probe_decode_flush(&probe);
 
     if (eof_reached) {
         int stream_index;
@@ -3970,7 +4128,8 @@ FF_ENABLE_DEPRECATION_WARNINGS
                 do {
                     err = try_decode_frame(ic, st, &empty_pkt,
                                             (options && i < orig_nb_streams)
-                                            ? &options[i] : NULL);
+                                            ? &options[i] : NULL,
+                                            st->codec_info_nb_frames);
                 } while (err > 0 && !has_codec_parameters(st, NULL));
 
                 if (err < 0) {
@@ -4103,6 +4262,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
                    "Could not find codec parameters for stream %d (%s): %s\n"
                    "Consider increasing the value for the 'analyzeduration' (%"PRId64") and 'probesize' (%"PRId64") options\n",
                    i, buf, errmsg, ic->max_analyze_duration, ic->probesize);
+            missing_params = 1;
         } else {
             ret = 0;
         }
@@ -4164,7 +4324,10 @@ FF_ENABLE_DEPRECATION_WARNINGS
         st->internal->avctx_inited = 0;
     }
 
+    ic->internal->index_cache_have_params = !missing_params;
+
 find_stream_info_err:
+    probe_decode_uninit(&probe);
     for (i = 0; i < ic->nb_streams; i++) {
         st = ic->streams[i];
         if (st->internal->info)
@@ -4371,6 +4534,7 @@ static void free_stream(AVStream **pst)
         av_bsf_free(&st->internal->bsfc);
         av_freep(&st->internal->priv_pts);
         av_freep(&st->internal->index_entries);
+        av_freep(&st->internal->cache_index);
         av_freep(&st->internal->probe_data.buf);
 
         av_bsf_free(&st->internal->extract_extradata.bsf);
@@ -4465,6 +4629,9 @@ void avformat_close_input(AVFormatContext **ps)
         (s->flags & AVFMT_FLAG_CUSTOM_IO))
         pb = NULL;
 
+    if (s->index_cache)
+        ff_index_cache_save(s);
+
     flush_packet_queue(s);
 
     if (s->iformat)
@@ -258,6 +258,7 @@ AVBufferPool *av_buffer_pool_init2(int size, void *opaque,
     pool->alloc     = av_buffer_alloc; // fallback
     pool->pool_free = pool_free;
 
+    atomic_init(&pool->free_head, 0);
     atomic_init(&pool->refcount, 1);
 
     return pool;
@@ -274,20 +275,96 @@ AVBufferPool *av_buffer_pool_init(int size, AVBufferRef* (*alloc)(int size))
     pool->size     = size;
     pool->alloc    = alloc ? alloc : av_buffer_alloc;
 
+    atomic_init(&pool->free_head, 0);
     atomic_init(&pool->refcount, 1);
 
     return pool;
 }
 
+static BufferPoolEntry *pool_entry(AVBufferPool *pool, unsigned index)
+{
+    unsigned chunk = av_log2((index >> POOL_CHUNK0_BITS) + 1);
+    return &pool->chunks[chunk][index - (((1U << chunk) - 1) << POOL_CHUNK0_BITS)];
+}
+
+#if POOL_LOCK_FREE
+/* set the index of a free list head and increment its counter */
+static intptr_t pool_head_update(intptr_t head, unsigned index)
+{
+    return (intptr_t)((((uint64_t)head & ~POOL_INDEX_MASK) +
+                       (UINT64_C(1) << POOL_INDEX_BITS)) | index);
+}
+
+static void pool_push(AVBufferPool *pool, BufferPoolEntry *buf)
+{
+    intptr_t head = atomic_load_explicit(&pool->free_head, memory_order_relaxed);
+    intptr_t new_head;
+
+    do {
+        atomic_store_explicit(&buf->next, (uint64_t)head & POOL_INDEX_MASK,
+                              memory_order_relaxed);
+        new_head = pool_head_update(head, buf->index + 1);
+    } while (!atomic_compare_exchange_weak_explicit(&pool->free_head, &head, new_head,
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+}
+
+static BufferPoolEntry *pool_pop(AVBufferPool *pool)
+{
+    intptr_t head = atomic_load_explicit(&pool->free_head, memory_order_acquire);
+    intptr_t new_head;
+    BufferPoolEntry *buf;
+
+    do {
+        unsigned index = (uint64_t)head & POOL_INDEX_MASK;
+
+        if (!index)
+            return NULL;
+        buf      = pool_entry(pool, index - 1);
+        new_head = pool_head_update(head, atomic_load_explicit(&buf->next,
+                                                               memory_order_relaxed));
+    } while (!atomic_compare_exchange_weak_explicit(&pool->free_head, &head, new_head,
+                                                    memory_order_acquire,
+                                                    memory_order_acquire));
+
+    return buf;
+}
+#else
+static void pool_push(AVBufferPool *pool, BufferPoolEntry *buf)
+{
+    ff_mutex_lock(&pool->mutex);
+    atomic_store_explicit(&buf->next,
+                          atomic_load_explicit(&pool->free_head, memory_order_relaxed),
+                          memory_order_relaxed);
+    atomic_store_explicit(&pool->free_head, buf->index + 1, memory_order_relaxed);
+    ff_mutex_unlock(&pool->mutex);
+}
+
+static BufferPoolEntry *pool_pop(AVBufferPool *pool)
+{
+    BufferPoolEntry *buf = NULL;
+    unsigned index;
+
+    ff_mutex_lock(&pool->mutex);
+    index = atomic_load_explicit(&pool->free_head, memory_order_relaxed);
+    if (index) {
+        buf = pool_entry(pool, index - 1);
+        atomic_store_explicit(&pool->free_head,
+                              atomic_load_explicit(&buf->next, memory_order_relaxed),
+                              memory_order_relaxed);
+    }
+    ff_mutex_unlock(&pool->mutex);
+
+    return buf;
+}
+#endif
+
 static void buffer_pool_flush(AVBufferPool *pool)
 {
-    while (pool->pool) {
-        BufferPoolEntry *buf = pool->pool;
-        pool->pool = buf->next;
+    BufferPoolEntry *buf;
 
+    while ((buf = pool_pop(pool)))
         buf->free(buf->opaque, buf->data);
-        av_freep(&buf);
-    }
 }
 
 /*
@@ -296,9 +373,14 @@ static void buffer_pool_flush(AVBufferPool *pool)
  */
 static void buffer_pool_free(AVBufferPool *pool)
 {
+    int i;
+
     buffer_pool_flush(pool);
     ff_mutex_destroy(&pool->mutex);
 
+    for (i = 0; i < POOL_MAX_CHUNKS; i++)
+        av_freep(&pool->chunks[i]);
+
     if (pool->pool_free)
         pool->pool_free(pool->opaque);
 
@@ -314,9 +396,7 @@ void av_buffer_pool_uninit(AVBufferPool **ppool)
     pool   = *ppool;
     *ppool = NULL;
 
-    ff_mutex_lock(&pool->mutex);
     buffer_pool_flush(pool);
-    ff_mutex_unlock(&pool->mutex);
 
     if (atomic_fetch_sub_explicit(&pool->refcount, 1, memory_order_acq_rel) == 1)
         buffer_pool_free(pool);
@@ -330,15 +410,38 @@ static void pool_release_buffer(void *opaque, uint8_t *data)
     if(CONFIG_MEMORY_POISONING)
         memset(buf->data, FF_MEMORY_POISON, pool->size);
 
-    ff_mutex_lock(&pool->mutex);
-    buf->next = pool->pool;
-    pool->pool = buf;
-    ff_mutex_unlock(&pool->mutex);
+    pool_push(pool, buf);
 
     if (atomic_fetch_sub_explicit(&pool->refcount, 1, memory_order_acq_rel) == 1)
         buffer_pool_free(pool);
 }
 
+/* get an unused entry from the entry table, growing it if needed;
+ * must be called with the pool mutex held */
+static BufferPoolEntry *pool_alloc_entry(AVBufferPool *pool)
+{
+    unsigned index = pool->nb_entries;
+    unsigned chunk = av_log2((index >> POOL_CHUNK0_BITS) + 1);
+    BufferPoolEntry *buf;
+
+    if (index >= POOL_MAX_ENTRIES)
+        return NULL;
+
+    if (!pool->chunks[chunk]) {
+        pool->chunks[chunk] = av_mallocz_array((size_t)(1 << POOL_CHUNK0_BITS) << chunk,
+                                               sizeof(*pool->chunks[chunk]));
+        if (!pool->chunks[chunk])
+            return NULL;
+    }
+
+    buf = pool_entry(pool, index);
+    buf->index = index;
+    atomic_init(&buf->next, 0);
+    pool->nb_entries++;
+
+    return buf;
+}
+
 /* allocate a new buffer and override its free() callback so that
  * it is returned to the pool on free */
 static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
@@ -353,7 +456,7 @@ static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
     if (!ret)
         return NULL;
 
-    buf = av_mallocz(sizeof(*buf));
+    buf = pool_alloc_entry(pool);
     if (!buf) {
         av_buffer_unref(&ret);
         return NULL;
@@ -375,19 +478,17 @@ AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
     AVBufferRef *ret;
     BufferPoolEntry *buf;
 
-    ff_mutex_lock(&pool->mutex);
-    buf = pool->pool;
+    buf = pool_pop(pool);
     if (buf) {
         ret = av_buffer_create(buf->data, pool->size, pool_release_buffer,
                                buf, 0);
-        if (ret) {
-            pool->pool = buf->next;
-            buf->next = NULL;
-        }
+        if (!ret)
+            pool_push(pool, buf);
     } else {
+        ff_mutex_lock(&pool->mutex);
         ret = pool_alloc_buffer(pool);
+        ff_mutex_unlock(&pool->mutex);
     }
-    ff_mutex_unlock(&pool->mutex);
 
     if (ret)
         atomic_fetch_add_explicit(&pool->refcount, 1, memory_order_relaxed);
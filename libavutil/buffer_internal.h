@@ -71,12 +71,46 @@ typedef struct BufferPoolEntry {
     void (*free)(void *opaque, uint8_t *data);
 
     AVBufferPool *pool;
-    struct BufferPoolEntry *next;
+
+    /* position of this entry in the entry table of the pool */
+    unsigned index;
+    /* index + 1 of the next entry in the free list, 0 at its end */
+    atomic_uint next;
 } BufferPoolEntry;
 
+/*
+ * The free list of a pool is a stack of entry indices. Its head stores the
+ * index + 1 of the top entry in the low 32 bits of an intptr_t.
+ *
+ * Where intptr_t has 64 bits, the list is lock-free: the high 32 bits hold
+ * a counter which is incremented on every update, so that a pop cannot
+ * succeed on a head that was popped and pushed back in the meantime (the
+ * ABA problem). With a 32-bit intptr_t there is no room for the counter
+ * (the compat atomics also emulate every atomic type with an intptr_t), so
+ * the list is protected by the pool mutex instead.
+ */
+#define POOL_LOCK_FREE   (UINTPTR_MAX > UINT32_MAX)
+#define POOL_INDEX_BITS  32
+#define POOL_INDEX_MASK  ((UINT64_C(1) << POOL_INDEX_BITS) - 1)
+
+/*
+ * The entries are allocated in chunks which are never moved, the n-th chunk
+ * holds (1 << POOL_CHUNK0_BITS) << n entries. This covers every index that
+ * fits in the head, and the table can not realistically fill up as each
+ * entry holds a live allocation.
+ */
+#define POOL_CHUNK0_BITS 3
+#define POOL_MAX_CHUNKS  29
+#define POOL_MAX_ENTRIES ((((1U << POOL_MAX_CHUNKS) - 1) << POOL_CHUNK0_BITS))
+
 struct AVBufferPool {
+    /* serializes the allocation of new buffers, and the free list
+     * updates if it is not lock-free */
     AVMutex mutex;
-    BufferPoolEntry *pool;
+    atomic_intptr_t free_head;
+
+    BufferPoolEntry *chunks[POOL_MAX_CHUNKS];
+    unsigned nb_entries;
 
     /*
      * This is used to track when the pool is to be freed.
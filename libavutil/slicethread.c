@@ -16,11 +16,83 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "config.h"
+
+#if HAVE_SCHED_SETAFFINITY
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+#include <sched.h>
+#endif
+
 #include <stdatomic.h>
+#include <stdlib.h>
 #include "slicethread.h"
 #include "mem.h"
 #include "thread.h"
 #include "avassert.h"
+#include "avstring.h"
+#include "cpu.h"
+
+/**
+ * Parse a CPU list such as "0-7,16-23".
+ * @return the number of CPUs in the list if index < 0, the CPU at position
+ *         index otherwise, or AVERROR(EINVAL) if the list is invalid
+ */
+static int parse_cpu_list(const char *cpus, int index)
+{
+    const char *p = cpus;
+    int count = 0;
+
+    while (*p) {
+        char *end;
+        long first, last;
+
+        first = last = strtol(p, &end, 10);
+        if (end == p || first < 0)
+            return AVERROR(EINVAL);
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1 || last < first)
+                return AVERROR(EINVAL);
+            p = end;
+        }
+        if (last >= 1024)
+            return AVERROR(EINVAL);
+        if (index >= count && index <= count + last - first)
+            return first + index - count;
+        count += last - first + 1;
+        if (*p == ',')
+            p++;
+        else if (*p)
+            return AVERROR(EINVAL);
+    }
+
+    return count ? (index < 0 ? count : AVERROR(EINVAL)) : AVERROR(EINVAL);
+}
+
+int avpriv_thread_set_affinity(const char *cpus, int index)
+{
+    int count = parse_cpu_list(cpus, -1);
+
+    if (count < 0)
+        return count;
+#if HAVE_SCHED_SETAFFINITY
+    {
+        cpu_set_t set;
+        int cpu = parse_cpu_list(cpus, index % count);
+
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set))
+            return AVERROR(errno);
+        return cpu;
+    }
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
 
 #if HAVE_PTHREADS || HAVE_W32THREADS || HAVE_OS2THREADS
 
@@ -30,8 +102,29 @@ typedef struct WorkerContext {
     pthread_cond_t  cond;
     pthread_t       thread;
     int             done;
+    int             pinned;
 } WorkerContext;
 
+/**
+ * Process-wide pool of threads running the jobs of all contexts created
+ * with avpriv_slicethread_create_shared(). Contexts with jobs left to hand
+ * out are queued; idle pool threads join the oldest queued context and
+ * pull jobs from it until it runs dry.
+ */
+typedef struct SharedPool {
+    pthread_mutex_t mutex;
+    pthread_cond_t  work_cond;
+    pthread_cond_t  done_cond;
+    AVSliceThread   *head, *tail;
+    pthread_t       *threads;
+    int             nb_threads;
+    int             nb_users;
+    int             finished;
+} SharedPool;
+
+static AVMutex shared_pool_lock = AV_MUTEX_INITIALIZER;
+static SharedPool *shared_pool;
+
 struct AVSliceThread {
     WorkerContext   *workers;
     int             nb_threads;
@@ -48,6 +141,14 @@ struct AVSliceThread {
     void            *priv;
     void            (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads);
     void            (*main_func)(void *priv);
+
+    char            *affinity;
+
+    SharedPool      *pool;
+    AVSliceThread   *next;
+    int             queued;
+    int             nb_helpers;
+    int             running_helpers;
 };
 
 static int run_jobs(AVSliceThread *ctx)
@@ -82,6 +183,11 @@ static void *attribute_align_arg thread_worker(void *v)
             return NULL;
         }
 
+        if (ctx->affinity && !w->pinned) {
+            avpriv_thread_set_affinity(ctx->affinity, w - ctx->workers);
+            w->pinned = 1;
+        }
+
         if (run_jobs(ctx)) {
             pthread_mutex_lock(&ctx->done_mutex);
             ctx->done = 1;
@@ -161,11 +267,225 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
     return nb_threads;
 }
 
+static void shared_run_jobs(AVSliceThread *ctx, int threadnr)
+{
+    unsigned nb_jobs = ctx->nb_jobs;
+    unsigned jobnr;
+
+    while ((jobnr = atomic_fetch_add_explicit(&ctx->current_job, 1, memory_order_acq_rel)) < nb_jobs)
+        ctx->worker_func(ctx->priv, jobnr, threadnr, nb_jobs, ctx->nb_active_threads);
+}
+
+static void shared_pool_dequeue(SharedPool *pool, AVSliceThread *ctx)
+{
+    AVSliceThread **p = &pool->head, *prev = NULL;
+
+    while (*p != ctx) {
+        prev = *p;
+        p    = &(*p)->next;
+    }
+    *p = ctx->next;
+    if (pool->tail == ctx)
+        pool->tail = prev;
+    ctx->next   = NULL;
+    ctx->queued = 0;
+}
+
+static void *attribute_align_arg shared_worker(void *v)
+{
+    SharedPool *pool = v;
+
+    pthread_mutex_lock(&pool->mutex);
+    while (!pool->finished) {
+        AVSliceThread *ctx = pool->head;
+        int threadnr;
+
+        if (!ctx) {
+            pthread_cond_wait(&pool->work_cond, &pool->mutex);
+            continue;
+        }
+
+        threadnr = ++ctx->nb_helpers;
+        if (threadnr == ctx->nb_active_threads - 1)
+            shared_pool_dequeue(pool, ctx);
+        ctx->running_helpers++;
+        pthread_mutex_unlock(&pool->mutex);
+
+        shared_run_jobs(ctx, threadnr);
+
+        pthread_mutex_lock(&pool->mutex);
+        if (!--ctx->running_helpers)
+            pthread_cond_broadcast(&pool->done_cond);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return NULL;
+}
+
+static void shared_pool_destroy(SharedPool *pool)
+{
+    int i;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->finished = 1;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (i = 0; i < pool->nb_threads; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_cond_destroy(&pool->done_cond);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_mutex_destroy(&pool->mutex);
+    av_freep(&pool->threads);
+    av_free(pool);
+}
+
+static SharedPool *shared_pool_ref(void)
+{
+    SharedPool *pool;
+    int i;
+
+    ff_mutex_lock(&shared_pool_lock);
+    if (shared_pool) {
+        shared_pool->nb_users++;
+        pool = shared_pool;
+        goto end;
+    }
+
+    pool = av_mallocz(sizeof(*pool));
+    if (!pool)
+        goto end;
+    pool->threads = av_calloc(av_cpu_count(), sizeof(*pool->threads));
+    if (!pool->threads) {
+        av_freep(&pool);
+        goto end;
+    }
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    for (i = 0; i < av_cpu_count(); i++) {
+        if (pthread_create(&pool->threads[i], NULL, shared_worker, pool))
+            break;
+        pool->nb_threads++;
+    }
+    if (!pool->nb_threads) {
+        shared_pool_destroy(pool);
+        pool = NULL;
+        goto end;
+    }
+    pool->nb_users = 1;
+    shared_pool    = pool;
+end:
+    ff_mutex_unlock(&shared_pool_lock);
+    return pool;
+}
+
+static void shared_pool_unref(SharedPool *pool)
+{
+    ff_mutex_lock(&shared_pool_lock);
+    if (!--pool->nb_users) {
+        shared_pool = NULL;
+        shared_pool_destroy(pool);
+    }
+    ff_mutex_unlock(&shared_pool_lock);
+}
+
+int avpriv_slicethread_create_shared(AVSliceThread **pctx, void *priv,
+                                     void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
+                                     int nb_threads)
+{
+    AVSliceThread *ctx;
+
+    av_assert0(nb_threads >= 0);
+
+    *pctx = ctx = av_mallocz(sizeof(*ctx));
+    if (!ctx)
+        return AVERROR(ENOMEM);
+
+    ctx->pool = shared_pool_ref();
+    if (!ctx->pool) {
+        av_freep(pctx);
+        return AVERROR(ENOMEM);
+    }
+
+    if (!nb_threads)
+        nb_threads = ctx->pool->nb_threads + 1;
+
+    ctx->priv        = priv;
+    ctx->worker_func = worker_func;
+    ctx->nb_threads  = nb_threads;
+    atomic_init(&ctx->first_job, 0);
+    atomic_init(&ctx->current_job, 0);
+
+    return nb_threads;
+}
+
+static void shared_execute(AVSliceThread *ctx, int nb_jobs)
+{
+    SharedPool *pool = ctx->pool;
+    int i;
+
+    ctx->nb_jobs           = nb_jobs;
+    ctx->nb_active_threads = FFMIN(nb_jobs, ctx->nb_threads);
+    atomic_store_explicit(&ctx->current_job, 0, memory_order_relaxed);
+
+    if (ctx->nb_active_threads > 1) {
+        pthread_mutex_lock(&pool->mutex);
+        ctx->nb_helpers = 0;
+        ctx->queued     = 1;
+        if (pool->tail)
+            pool->tail->next = ctx;
+        else
+            pool->head = ctx;
+        pool->tail = ctx;
+        for (i = 1; i < ctx->nb_active_threads; i++)
+            pthread_cond_signal(&pool->work_cond);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+
+    /* The caller always takes part, so all jobs are run even if every
+     * thread of the pool is busy with other contexts. */
+    shared_run_jobs(ctx, 0);
+
+    if (ctx->nb_active_threads > 1) {
+        pthread_mutex_lock(&pool->mutex);
+        if (ctx->queued)
+            shared_pool_dequeue(pool, ctx);
+        while (ctx->running_helpers)
+            pthread_cond_wait(&pool->done_cond, &pool->mutex);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+}
+
+int avpriv_slicethread_set_affinity(AVSliceThread *ctx, const char *cpus)
+{
+    int ret = parse_cpu_list(cpus, -1);
+
+    if (ret < 0)
+        return ret;
+    if (!HAVE_SCHED_SETAFFINITY || ctx->pool)
+        return AVERROR(ENOSYS);
+
+    av_freep(&ctx->affinity);
+    ctx->affinity = av_strdup(cpus);
+    if (!ctx->affinity)
+        return AVERROR(ENOMEM);
+    return 0;
+}
+
 void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_main)
 {
     int nb_workers, i, is_last = 0;
 
     av_assert0(nb_jobs > 0);
+
+    if (ctx->pool) {
+        shared_execute(ctx, nb_jobs);
+        return;
+    }
+
     ctx->nb_jobs           = nb_jobs;
     ctx->nb_active_threads = FFMIN(nb_jobs, ctx->nb_threads);
     atomic_store_explicit(&ctx->first_job, 0, memory_order_relaxed);
@@ -205,6 +525,12 @@ void avpriv_slicethread_free(AVSliceThread **pctx)
         return;
 
     ctx = *pctx;
+    if (ctx->pool) {
+        shared_pool_unref(ctx->pool);
+        av_freep(pctx);
+        return;
+    }
+
     nb_workers = ctx->nb_threads;
     if (!ctx->main_func)
         nb_workers--;
@@ -227,6 +553,7 @@ void avpriv_slicethread_free(AVSliceThread **pctx)
 
     pthread_cond_destroy(&ctx->done_cond);
     pthread_mutex_destroy(&ctx->done_mutex);
+    av_freep(&ctx->affinity);
     av_freep(&ctx->workers);
     av_freep(pctx);
 }
@@ -242,6 +569,20 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
     return AVERROR(EINVAL);
 }
 
+int avpriv_slicethread_create_shared(AVSliceThread **pctx, void *priv,
+                                     void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
+                                     int nb_threads)
+{
+    *pctx = NULL;
+    return AVERROR(EINVAL);
+}
+
+int avpriv_slicethread_set_affinity(AVSliceThread *ctx, const char *cpus)
+{
+    av_assert0(0);
+    return AVERROR(ENOSYS);
+}
+
 void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_main)
 {
     av_assert0(0);
@@ -35,6 +35,47 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
                               void (*main_func)(void *priv),
                               int nb_threads);
 
+/**
+ * Create a slice threading context running its jobs on the process-wide
+ * shared thread pool.
+ *
+ * The pool has one thread per CPU and is shared by all contexts created
+ * with this function, so the number of threads does not grow with the
+ * number of contexts. The calling thread of avpriv_slicethread_execute()
+ * takes part in running the jobs, idle pool threads join it.
+ *
+ * @param pctx slice threading context returned here
+ * @param priv private pointer to be passed to callback function
+ * @param worker_func callback function to be executed
+ * @param nb_threads maximum number of threads running jobs of this context
+ *                   at the same time, including the calling thread,
+ *                   0 for automatic, must be >= 0
+ * @return return number of threads or negative AVERROR on failure
+ */
+int avpriv_slicethread_create_shared(AVSliceThread **pctx, void *priv,
+                                     void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
+                                     int nb_threads);
+
+/**
+ * Pin the worker threads of a slice threading context to CPUs.
+ *
+ * Worker n is pinned to the n-th CPU of the list (modulo its length) the
+ * next time it runs jobs.
+ *
+ * @param ctx slice threading context
+ * @param cpus CPU list, e.g. "0-7,16-23"
+ * @return 0 on success, AVERROR(EINVAL) if the list is invalid, or
+ *         AVERROR(ENOSYS) if thread affinity is not supported
+ */
+int avpriv_slicethread_set_affinity(AVSliceThread *ctx, const char *cpus);
+
+/**
+ * Pin the calling thread to the CPU at position index (modulo the list
+ * length) of a CPU list as accepted by avpriv_slicethread_set_affinity().
+ * @return the CPU number or a negative AVERROR on failure
+ */
+int avpriv_thread_set_affinity(const char *cpus, int index);
+
 /**
  * Execute slice threading.
  * @param ctx slice threading context
@@ -0,0 +1,128 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * This test program gets and releases buffers from a single AVBufferPool in
+ * several threads at once and checks that no buffer is handed out twice.
+ * With -t, it prints the cost of a get/unref pair for 1 to 64 threads.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#define BUFFER_SIZE  64
+#define NB_HELD      4
+#define MAX_THREADS  64
+
+typedef struct Worker {
+    pthread_t thread;
+    AVBufferPool *pool;
+    int id;
+    int nb_iter;
+    int ret;
+} Worker;
+
+static void *worker_main(void *arg)
+{
+    Worker *w = arg;
+    AVBufferRef *bufs[NB_HELD];
+    int i, j;
+
+    for (i = 0; i < w->nb_iter; i++) {
+        for (j = 0; j < NB_HELD; j++) {
+            bufs[j] = av_buffer_pool_get(w->pool);
+            if (!bufs[j]) {
+                w->ret = 1;
+                while (j--)
+                    av_buffer_unref(&bufs[j]);
+                return NULL;
+            }
+            AV_WN32(bufs[j]->data, w->id * NB_HELD + j);
+        }
+        for (j = 0; j < NB_HELD; j++) {
+            if (AV_RN32(bufs[j]->data) != w->id * NB_HELD + j)
+                w->ret = 2;
+            av_buffer_unref(&bufs[j]);
+        }
+    }
+
+    return NULL;
+}
+
+static int run(int nb_threads, int nb_iter, int64_t *elapsed)
+{
+    Worker workers[MAX_THREADS] = { { 0 } };
+    AVBufferPool *pool;
+    int64_t start;
+    int i, ret = 0;
+
+    pool = av_buffer_pool_init(BUFFER_SIZE, NULL);
+    if (!pool)
+        return 1;
+
+    start = av_gettime_relative();
+    for (i = 0; i < nb_threads; i++) {
+        workers[i].pool    = pool;
+        workers[i].id      = i;
+        workers[i].nb_iter = nb_iter;
+        if ((ret = pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]))) {
+            fprintf(stderr, "pthread_create failed: %s.\n", strerror(ret));
+            nb_threads = i;
+            ret = 1;
+            break;
+        }
+    }
+    for (i = 0; i < nb_threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        if (workers[i].ret) {
+            fprintf(stderr, "thread %d failed with %d\n", i, workers[i].ret);
+            ret = workers[i].ret;
+        }
+    }
+    *elapsed = av_gettime_relative() - start;
+
+    av_buffer_pool_uninit(&pool);
+
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    int64_t elapsed;
+    int nb_threads, ret;
+
+    if (argc > 1 && !strcmp(argv[1], "-t")) {
+        const int nb_iter = 100000;
+
+        for (nb_threads = 1; nb_threads <= MAX_THREADS; nb_threads *= 2) {
+            if ((ret = run(nb_threads, nb_iter, &elapsed)))
+                return ret;
+            printf("threads: %2d  %7.1f ns per get/unref in each thread, %5.1f Mops/s total\n", nb_threads,
+                   elapsed * 1000.0 / ((double)nb_iter * NB_HELD),
+                   (double)nb_threads * nb_iter * NB_HELD / elapsed);
+        }
+        return 0;
+    }
+
+    return run(8, 2000, &elapsed);
+}
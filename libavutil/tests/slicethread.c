@@ -0,0 +1,123 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * This test program runs slice threading contexts from several threads at
+ * once, private ones and ones on the shared pool, and checks that every job
+ * of every execute call is run exactly once, on a valid thread number.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/slicethread.h"
+#include "libavutil/thread.h"
+
+#define MAX_JOBS     64
+#define NB_CONTEXTS  8
+
+typedef struct Context {
+    pthread_t thread;
+    AVSliceThread *slicethread;
+    int shared;
+    int threads;
+    int nb_threads;
+    int nb_iter;
+    int runs[MAX_JOBS];
+    int bad_threadnr;
+    int ret;
+} Context;
+
+static void worker(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    Context *c = priv;
+
+    c->runs[jobnr]++;
+    if (threadnr < 0 || threadnr >= nb_threads || nb_threads > c->nb_threads)
+        c->bad_threadnr = 1;
+}
+
+static void *context_main(void *arg)
+{
+    Context *c = arg;
+    int i, j, ret;
+
+    /* create and free the context repeatedly, so that the shared pool is
+     * also torn down and set up again while other contexts use it */
+    for (i = 0; i < c->nb_iter; i++) {
+        int nb_jobs = 1 + (i * 7 + c->threads) % MAX_JOBS;
+
+        if (!c->slicethread) {
+            ret = c->shared ?
+                  avpriv_slicethread_create_shared(&c->slicethread, c, worker, c->threads) :
+                  avpriv_slicethread_create(&c->slicethread, c, worker, NULL, c->threads);
+            if (ret < 0) {
+                c->ret = 1;
+                return NULL;
+            }
+            c->nb_threads = ret;
+        }
+
+        memset(c->runs, 0, sizeof(c->runs));
+        avpriv_slicethread_execute(c->slicethread, nb_jobs, 0);
+        for (j = 0; j < MAX_JOBS; j++) {
+            if (c->runs[j] != (j < nb_jobs)) {
+                fprintf(stderr, "job %d of %d run %d times\n", j, nb_jobs, c->runs[j]);
+                c->ret = 2;
+            }
+        }
+        if (c->bad_threadnr)
+            c->ret = 3;
+
+        if (i % 100 == 99)
+            avpriv_slicethread_free(&c->slicethread);
+    }
+    avpriv_slicethread_free(&c->slicethread);
+
+    return NULL;
+}
+
+int main(void)
+{
+    Context contexts[NB_CONTEXTS] = { { 0 } };
+    int i, ret = 0, nb_started;
+
+    for (i = 0; i < NB_CONTEXTS; i++) {
+        Context *c = &contexts[i];
+
+        /* mostly shared contexts, with automatic and fixed thread counts */
+        c->shared     = i != NB_CONTEXTS - 1;
+        c->threads    = i % 4;
+        c->nb_iter    = 1000;
+        if ((ret = pthread_create(&c->thread, NULL, context_main, c))) {
+            fprintf(stderr, "pthread_create failed: %s.\n", strerror(ret));
+            ret = 1;
+            break;
+        }
+    }
+    nb_started = i;
+    for (i = 0; i < nb_started; i++) {
+        pthread_join(contexts[i].thread, NULL);
+        if (contexts[i].ret) {
+            fprintf(stderr, "context %d failed with %d\n", i, contexts[i].ret);
+            ret = contexts[i].ret;
+        }
+    }
+
+    return ret;
+}
@@ -235,14 +235,23 @@ static void lumRangeFromJpeg16_c(int16_t *_dst, int width)
     if (DEBUG_SWSCALE_BUFFERS)                  \
         av_log(c, AV_LOG_DEBUG, __VA_ARGS__)
 
-static int swscale(SwsContext *c, const uint8_t *src[],
-                   int srcStride[], int srcSliceY,
-                   int srcSliceH, uint8_t *dst[], int dstStride[])
+/*
+ * Scale srcSliceH input lines starting at srcSliceY. If dstSliceY/dstSliceH
+ * do not cover the whole output, the input must be the complete frame and
+ * only the given output lines are produced, dst then points to the first
+ * of them.
+ */
+static int scale_slice(SwsContext *c, const uint8_t *src[],
+                       int srcStride[], int srcSliceY, int srcSliceH,
+                       uint8_t *dst[], int dstStride[],
+                       int dstSliceY, int dstSliceH)
 {
     /* load a few things into local vars to make the code more readable?
      * and faster */
     const int dstW                   = c->dstW;
     const int dstH                   = c->dstH;
+    const int scale_dst              = dstSliceY > 0 || dstSliceH < dstH;
+    const int dstEnd                 = dstSliceY + dstSliceH;
 
     const enum AVPixelFormat dstFormat = c->dstFormat;
     const int flags                  = c->flags;
@@ -334,7 +343,11 @@ static int swscale(SwsContext *c, const uint8_t *src[],
     /* Note the user might start scaling the picture in the middle so this
      * will not get executed. This is not really intended but works
      * currently, so people might do it. */
-    if (srcSliceY == 0) {
+    if (scale_dst) {
+        dstY         = dstSliceY;
+        lastInLumBuf = -1;
+        lastInChrBuf = -1;
+    } else if (srcSliceY == 0) {
         dstY         = 0;
         lastInLumBuf = -1;
         lastInChrBuf = -1;
@@ -352,8 +365,8 @@ static int swscale(SwsContext *c, const uint8_t *src[],
             srcSliceY, srcSliceH, chrSrcSliceY, chrSrcSliceH, 1);
 
     ff_init_slice_from_src(vout_slice, (uint8_t**)dst, dstStride, c->dstW,
-            dstY, dstH, dstY >> c->chrDstVSubSample,
-            AV_CEIL_RSHIFT(dstH, c->chrDstVSubSample), 0);
+            dstY, dstSliceH, dstY >> c->chrDstVSubSample,
+            AV_CEIL_RSHIFT(dstSliceH, c->chrDstVSubSample), scale_dst);
     if (srcSliceY == 0) {
         hout_slice->plane[0].sliceY = lastInLumBuf + 1;
         hout_slice->plane[1].sliceY = lastInChrBuf + 1;
@@ -367,7 +380,7 @@ static int swscale(SwsContext *c, const uint8_t *src[],
         hout_slice->width = dstW;
     }
 
-    for (; dstY < dstH; dstY++) {
+    for (; dstY < dstEnd; dstY++) {
         const int chrDstY = dstY >> c->chrDstVSubSample;
         int use_mmx_vfilter= c->use_mmx_vfilter;
 
@@ -495,19 +508,20 @@ static int swscale(SwsContext *c, const uint8_t *src[],
     if (isPlanar(dstFormat) && isALPHA(dstFormat) && !needAlpha) {
         int length = dstW;
         int height = dstY - lastDstY;
+        int dstOffset = scale_dst ? dstSliceY : 0;
 
         if (is16BPS(dstFormat) || isNBPS(dstFormat)) {
             const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(dstFormat);
-            fillPlane16(dst[3], dstStride[3], length, height, lastDstY,
+            fillPlane16(dst[3], dstStride[3], length, height, lastDstY - dstOffset,
                     1, desc->comp[3].depth,
                     isBE(dstFormat));
         } else if (is32BPS(dstFormat)) {
             const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(dstFormat);
-            fillPlane32(dst[3], dstStride[3], length, height, lastDstY,
+            fillPlane32(dst[3], dstStride[3], length, height, lastDstY - dstOffset,
                     1, desc->comp[3].depth,
                     isBE(dstFormat), desc->flags & AV_PIX_FMT_FLAG_FLOAT);
         } else
-            fillPlane(dst[3], dstStride[3], length, height, lastDstY, 255);
+            fillPlane(dst[3], dstStride[3], length, height, lastDstY - dstOffset, 255);
     }
 
 #if HAVE_MMXEXT_INLINE
@@ -524,6 +538,45 @@ static int swscale(SwsContext *c, const uint8_t *src[],
     return dstY - lastDstY;
 }
 
+static int swscale(SwsContext *c, const uint8_t *src[],
+                   int srcStride[], int srcSliceY,
+                   int srcSliceH, uint8_t *dst[], int dstStride[])
+{
+    return scale_slice(c, src, srcStride, srcSliceY, srcSliceH,
+                       dst, dstStride, 0, c->dstH);
+}
+
+void ff_sws_slice_worker(void *priv, int jobnr, int threadnr,
+                         int nb_jobs, int nb_threads)
+{
+    SwsContext *parent = priv;
+    SwsContext      *c = parent->slice_ctx[threadnr];
+    const int align    = 1 << parent->chrDstVSubSample;
+    const int slice_h  = FFALIGN((parent->dstH + nb_jobs - 1) / nb_jobs, align);
+    const int start    = jobnr * slice_h;
+    const int end      = FFMIN(start + slice_h, parent->dstH);
+    const uint8_t *src[4];
+    uint8_t *dst[4];
+    int srcStride[4];
+    int i;
+
+    if (start >= end)
+        return;
+
+    /* scale_slice() modifies the pointer and stride arrays */
+    memcpy(src,       parent->slice_src,        sizeof(src));
+    memcpy(srcStride, parent->slice_src_stride, sizeof(srcStride));
+    for (i = 0; i < 4; i++) {
+        const int vshift = (i == 1 || i == 2) ? c->chrDstVSubSample : 0;
+        dst[i] = parent->slice_dst[i];
+        if (dst[i] && (i == 0 || isPlanar(c->dstFormat)))
+            dst[i] += parent->slice_dst_stride[i] * (start >> vshift);
+    }
+
+    scale_slice(c, src, srcStride, 0, c->srcH,
+                dst, parent->slice_dst_stride, start, end - start);
+}
+
 av_cold void ff_sws_init_range_convert(SwsContext *c)
 {
     c->lumConvertRange = NULL;
@@ -967,7 +1020,27 @@ int attribute_align_arg sws_scale(struct SwsContext *c,
     /* reset slice direction at end of frame */
     if (srcSliceY_internal + srcSliceH == c->srcH)
         c->sliceDir = 0;
-    ret = c->swscale(c, src2, srcStride2, srcSliceY_internal, srcSliceH, dst2, dstStride2);
+    if (c->nb_slice_ctx && srcSliceH == c->srcH) {
+        memcpy(c->slice_src,        src2,       sizeof(c->slice_src));
+        memcpy(c->slice_src_stride, srcStride2, sizeof(c->slice_src_stride));
+        memcpy(c->slice_dst,        dst2,       sizeof(c->slice_dst));
+        memcpy(c->slice_dst_stride, dstStride2, sizeof(c->slice_dst_stride));
+        if (usePal(c->srcFormat)) {
+            for (i = 0; i < c->nb_slice_ctx; i++) {
+                memcpy(c->slice_ctx[i]->pal_yuv, c->pal_yuv, sizeof(c->pal_yuv));
+                memcpy(c->slice_ctx[i]->pal_rgb, c->pal_rgb, sizeof(c->pal_rgb));
+            }
+        }
+
+        /* keep slices tall enough for the vertical filter overlap not to
+         * dominate */
+        avpriv_slicethread_execute(c->slicethread,
+                                   av_clip(c->dstH / 16, 1, c->nb_slice_ctx), 0);
+
+        ret     = c->dstH;
+        c->dstY = c->dstH;
+    } else
+        ret = c->swscale(c, src2, srcStride2, srcSliceY_internal, srcSliceH, dst2, dstStride2);
 
     if (c->dstXYZ && !(c->srcXYZ && c->srcW==c->dstW && c->srcH==c->dstH)) {
         int dstY = c->dstY ? c->dstY : srcSliceY + srcSliceH;
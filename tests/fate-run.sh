@@ -185,6 +185,139 @@ enc_dec_pcm(){
     ffmpeg -auto_conversion_filters -bitexact -i ${encfile} -c:a pcm_${pcm_fmt} -fflags +bitexact -f ${dec_fmt} -
 }
 
+# Print the frame and copy counts of the -filter_stats table, the times vary
+# from run to run and are left out.
+filter_stats(){
+    log="${outdir}/${test}.log"
+    cleanfiles="$log"
+    ffmpeg -filter_stats "$@" -f null - 2> $log || return
+    sed -n '/^Filtergraph #/,/^[^ ]/p' $log | awk '
+        /^Filtergraph #/ { print; next }
+        /^  filter / { print "filter", "in", "out", "copies"; next }
+        /^  / { name = $1; for (i = 2; i <= NF - 10; i++) name = name " " $i
+                print name, $(NF - 8), $(NF - 7), $(NF - 6) }'
+}
+
+# encode with one and with several threads, the output must not differ
+enc_threads(){
+    out_fmt=$1
+    src_file=$(target_path $2)
+    shift 2
+    encfile1="${outdir}/${test}-1.${out_fmt}"
+    encfile4="${outdir}/${test}-4.${out_fmt}"
+    cleanfiles="$encfile1 $encfile4"
+    ffmpeg -auto_conversion_filters -i $src_file "$@" -threads 1 -f $out_fmt -y $(target_path $encfile1) || return
+    ffmpeg -auto_conversion_filters -i $src_file "$@" -threads 4 -f $out_fmt -y $(target_path $encfile4) || return
+    md5_1=$(do_md5sum $encfile1 | awk '{print $1}')
+    md5_4=$(do_md5sum $encfile4 | awk '{print $1}')
+    test "$md5_1" = "$md5_4" && echo identical || echo "$md5_1 != $md5_4"
+}
+
+# Filter with one and with four filter threads, the output must not differ.
+filter_threads(){
+    out1="${outdir}/${test}.out1"
+    out4="${outdir}/${test}.out4"
+    cleanfiles="$out1 $out4"
+    framecrc -filter_complex_threads 1 "$@" > $out1 || return
+    framecrc -filter_complex_threads 4 "$@" > $out4 || return
+    cmp -s $out1 $out4 && echo identical || echo different
+}
+
+# Demux and seek a file with an index cache which is first written, then
+# reused; a stale and a corrupt cache must behave like a new one.
+index_cache(){
+    src_opts=$1
+    srcfile=$(target_path $2)
+    enc_opts=$3
+    encfile="${outdir}/${test}.ts"
+    stalefile="${outdir}/${test}-stale.ts"
+    cache="${outdir}/${test}.idx"
+    newcache="${outdir}/${test}-new.idx"
+    out1="${outdir}/${test}.out1"
+    out2="${outdir}/${test}.out2"
+    cleanfiles="$encfile $stalefile $cache $newcache $out1 $out2"
+    tencfile=$(target_path $encfile)
+    tcache=$(target_path $cache)
+    tnewcache=$(target_path $newcache)
+
+    same(){
+        cmp -s $out1 $out2 && echo "$1: identical" || echo "$1: different"
+    }
+
+    ffmpeg $src_opts -i $srcfile $enc_opts -f mpegts -y $tencfile || return
+    framecrc -i $tencfile -c copy > $out1 || return
+    framecrc -index_cache $tcache -i $tencfile -c copy > $out2 || return
+    same write
+    framecrc -index_cache $tcache -i $tencfile -c copy > $out2 || return
+    same read
+
+    # seeking with all keyframes known
+    run libavformat/tests/seek${EXESUF} $tencfile -index_cache $tcache || return
+
+    # the cache of another file is ignored
+    cp $encfile $stalefile
+    head -c 188 $encfile >> $stalefile
+    rm -f $newcache
+    run libavformat/tests/seek${EXESUF} $(target_path $stalefile) -index_cache $tnewcache > $out1 || return
+    run libavformat/tests/seek${EXESUF} $(target_path $stalefile) -index_cache $tcache > $out2 || return
+    same stale
+
+    # and so is a truncated one
+    rm -f $newcache
+    run libavformat/tests/seek${EXESUF} $tencfile -index_cache $tnewcache > $out1 || return
+    head -c 100 $newcache > $cache
+    run libavformat/tests/seek${EXESUF} $tencfile -index_cache $tcache > $out2 || return
+    same corrupt
+}
+
+# Probe a multi-program transport stream with one and with several threads
+# and with a probing latency limit, the streams found must not differ unless
+# the limit is reached.
+probe_threads(){
+    src_opts=$1
+    srcfile=$(target_path $2)
+    asrcfile=$(target_path $3)
+    enc_opts=$4
+    encfile="${outdir}/${test}.ts"
+    out1="${outdir}/${test}.out1"
+    out2="${outdir}/${test}.out2"
+    info1="${outdir}/${test}.info1"
+    info2="${outdir}/${test}.info2"
+    cleanfiles="$encfile $out1 $out2 $info1 $info2"
+    tencfile=$(target_path $encfile)
+
+    probe(){
+        out=$1
+        info=$2
+        shift 2
+        ffmpeg "$@" -i $tencfile -map 0 -c copy -bitexact -f framecrc - > $out 2> $info.log || return
+        sed -n '/^Input #0/,/^Output #0/p' $info.log | grep -E "Program|Stream #" > $info
+        rm -f $info.log
+    }
+    same(){
+        cmp -s $out1 $out2 && cmp -s $info1 $info2 && echo "$1: identical" || echo "$1: different"
+    }
+
+    ffmpeg $src_opts -i $srcfile -i $asrcfile $enc_opts -f mpegts -y $tencfile || return
+    probe $out1 $info1 -probe_threads 1 || return
+    grep -c "Stream #" $info1
+
+    probe $out2 $info2 -probe_threads 4 || return
+    same "threads 4"
+    probe $out2 $info2 -probe_threads 0 || return
+    same "threads auto"
+    # a latency limit which is not reached changes nothing
+    probe $out2 $info2 -probe_threads 4 -max_probe_latency 60000000 || return
+    same latency
+    # one which is reached stops probing after the first packet at the latest,
+    # the parameters of the streams are then incomplete and copying them fails
+    ffmpeg -v debug -probe_threads 4 -max_probe_latency 1 -i $tencfile -map 0 -c copy -f null - 2> $info2.log
+    grep -q "Probe latency limit of 1 microseconds reached" $info2.log && echo "latency limit: reached" || echo "latency limit: not reached"
+    sed -n '/^Input #0/,/^Output #0/p' $info2.log | grep -E "Program|Stream #" > $info2
+    rm -f $info2.log
+    cmp -s $info1 $info2 && echo "streams: complete" || echo "streams: incomplete"
+}
+
 FLAGS="-flags +bitexact -sws_flags +accurate_rnd+bitexact -fflags +bitexact"
 DEC_OPTS="-threads $threads -idct simple $FLAGS"
 ENC_OPTS="-threads 1        -idct simple -dct fastint"
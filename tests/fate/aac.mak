@@ -158,6 +158,23 @@ fate-aac-aref-encode: CMP_TARGET = 596
 fate-aac-aref-encode: SIZE_TOLERANCE = 2464
 fate-aac-aref-encode: FUZZ = 89
 
+FATE_AAC_ENCODE += fate-aac-51-encode
+fate-aac-51-encode: ./tests/data/asynth-44100-6.wav
+fate-aac-51-encode: CMD = enc_dec_pcm adts wav s16le $(REF) -c:a aac -b:a 384k -fflags +bitexact -flags +bitexact
+fate-aac-51-encode: CMP = stddev
+fate-aac-51-encode: REF = ./tests/data/asynth-44100-6.wav
+fate-aac-51-encode: CMP_SHIFT = -12288
+fate-aac-51-encode: CMP_TARGET = 4356
+fate-aac-51-encode: SIZE_TOLERANCE = 7392
+fate-aac-51-encode: FUZZ = 5
+
+# the channel elements are searched in parallel
+FATE_AAC_ENCODE += fate-aac-51-encode-threads
+fate-aac-51-encode-threads: ./tests/data/asynth-44100-6.wav
+fate-aac-51-encode-threads: CMD = enc_threads adts ./tests/data/asynth-44100-6.wav -c:a aac -b:a 384k -fflags +bitexact -flags +bitexact
+fate-aac-51-encode-threads: CMP = oneline
+fate-aac-51-encode-threads: REF = identical
+
 FATE_AAC_ENCODE += fate-aac-ln-encode
 fate-aac-ln-encode: CMD = enc_dec_pcm adts wav s16le $(TARGET_SAMPLES)/audio-reference/luckynight_2ch_44kHz_s16.wav -c:a aac -aac_is 0 -aac_pns 0 -aac_ms 0 -aac_tns 0 -b:a 512k -fflags +bitexact -flags +bitexact
 fate-aac-ln-encode: CMP = stddev
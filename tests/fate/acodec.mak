@@ -135,6 +135,11 @@ fate-acodec-flac: CODEC = flac -compression_level 2
 fate-acodec-flac-exact-rice: FMT = flac
 fate-acodec-flac-exact-rice: CODEC = flac -compression_level 2 -exact_rice_parameters 1
 
+# Frames are encoded in parallel, the output must not change.
+FATE_ACODEC-$(call ENCDEC, FLAC, FLAC) += fate-acodec-flac-threads
+fate-acodec-flac-threads: FMT = flac
+fate-acodec-flac-threads: CODEC = flac -compression_level 2 -threads 4
+
 FATE_ACODEC-$(call ENCDEC, G723_1, G723_1) += fate-acodec-g723_1
 fate-acodec-g723_1: tests/data/asynth-8000-1.wav
 fate-acodec-g723_1: SRC = tests/data/asynth-8000-1.wav
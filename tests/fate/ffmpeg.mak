@@ -41,6 +41,32 @@ fate-ffmpeg-filter_colorkey: CMD = framecrc -auto_conversion_filters -idct simpl
 FATE_FFMPEG-$(CONFIG_COLOR_FILTER) += fate-ffmpeg-lavfi
 fate-ffmpeg-lavfi: CMD = framecrc -lavfi color=d=1:r=5 -fflags +bitexact
 
+# Encode two video renditions and an audio stream, once from the main thread
+# and once with every encoder in a thread of its own; the output must match.
+FATE_FFMPEG-$(call ALLYES, RAWVIDEO_DEMUXER WAV_DEMUXER MPEG4_ENCODER FLAC_ENCODER FRAMECRC_MUXER) += fate-ffmpeg-ladder fate-ffmpeg-ladder-enc-thread
+fate-ffmpeg-ladder fate-ffmpeg-ladder-enc-thread: tests/data/vsynth1.yuv tests/data/asynth-44100-2.wav
+fate-ffmpeg-ladder: CMD = framecrc -f rawvideo -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv \
+  -i $(TARGET_PATH)/tests/data/asynth-44100-2.wav -map 0:v -map 0:v -map 1:a -t 1 \
+  -c:v mpeg4 -qscale:v:0 5 -qscale:v:1 15 -c:a flac -flags +bitexact -fflags +bitexact
+fate-ffmpeg-ladder-enc-thread: CMD = framecrc -f rawvideo -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv \
+  -i $(TARGET_PATH)/tests/data/asynth-44100-2.wav -map 0:v -map 0:v -map 1:a -t 1 \
+  -c:v mpeg4 -qscale:v:0 5 -qscale:v:1 15 -c:a flac -flags +bitexact -fflags +bitexact -enc_thread_queue_size 2
+fate-ffmpeg-ladder-enc-thread: REF = $(SRC_PATH)/tests/ref/fate/ffmpeg-ladder
+
+# Filter a split graph with statistics collected, see avfilter_get_stats().
+FATE_FFMPEG-$(call ALLYES, RAWVIDEO_DEMUXER SPLIT_FILTER HFLIP_FILTER VFLIP_FILTER VSTACK_FILTER NULL_MUXER) += fate-ffmpeg-filter-stats
+fate-ffmpeg-filter-stats: tests/data/vsynth1.yuv
+fate-ffmpeg-filter-stats: CMD = filter_stats -f rawvideo -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv \
+  -filter_complex "split[a][b];[a]hflip[a1];[b]vflip[b1];[a1][b1]vstack" -c:v rawvideo
+
+# Both drawbox inputs need writable frames. hflip outputs frames of its own,
+# the first drawbox gets a copy while split still holds a reference for the
+# second one, which then draws in place.
+FATE_FFMPEG-$(call ALLYES, RAWVIDEO_DEMUXER HFLIP_FILTER SPLIT_FILTER DRAWBOX_FILTER VSTACK_FILTER NULL_MUXER) += fate-ffmpeg-filter-stats-copies
+fate-ffmpeg-filter-stats-copies: tests/data/vsynth1.yuv
+fate-ffmpeg-filter-stats-copies: CMD = filter_stats -f rawvideo -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv \
+  -filter_complex "hflip,split[a][b];[a]drawbox=c=red[a1];[b]drawbox=c=blue[b1];[a1][b1]vstack" -c:v rawvideo
+
 FATE_SAMPLES_FFMPEG-$(CONFIG_RAWVIDEO_DEMUXER) += fate-force_key_frames
 fate-force_key_frames: tests/data/vsynth_lena.yuv
 fate-force_key_frames: CMD = enc_dec \
@@ -116,6 +142,14 @@ FATE_STREAMCOPY-$(call ENCDEC, APNG, APNG) += fate-copy-apng
 fate-copy-apng: fate-lavf-apng
 fate-copy-apng: CMD = transcode apng tests/data/lavf/lavf.apng apng "-c:v copy"
 
+FATE_FFMPEG-$(call ALLYES, FILE_PROTOCOL FRAMECRC_MUXER MPEG4_ENCODER MP2_ENCODER MATROSKA_MUXER MATROSKA_DEMUXER) += fate-copy-mmap-mkv
+fate-copy-mmap-mkv: fate-lavf-mkv
+fate-copy-mmap-mkv: CMD = framecrc -mmap 1 -i $(TARGET_PATH)/tests/data/lavf/lavf.mkv -c copy
+
+FATE_FFMPEG-$(call ALLYES, FILE_PROTOCOL FRAMECRC_MUXER MPEG4_ENCODER PCM_ALAW_ENCODER MOV_MUXER MOV_DEMUXER) += fate-copy-mmap-mov
+fate-copy-mmap-mov: fate-lavf-mov
+fate-copy-mmap-mov: CMD = framecrc -mmap 1 -i $(TARGET_PATH)/tests/data/lavf/lavf.mov -c copy
+
 FATE_STREAMCOPY-$(call DEMMUX, OGG, OGG) += fate-limited_input_seek fate-limited_input_seek-copyts
 fate-limited_input_seek: $(SAMPLES)/vorbis/moog_small.ogg
 fate-limited_input_seek: CMD = md5 -ss 1.5 -t 1.3 -i $(TARGET_SAMPLES)/vorbis/moog_small.ogg -c:a copy -fflags +bitexact -f ogg
@@ -65,6 +65,31 @@ fate-filter-paletteuse-sierra2_4a: CMD = framecrc -auto_conversion_filters -i $(
 fate-filter-paletteuse: $(FATE_FILTER_PALETTEUSE)
 FATE_FILTER_SAMPLES-$(call ALLYES, PALETTEUSE_FILTER MATROSKA_DEMUXER H264_DECODER IMAGE2_DEMUXER PNG_DECODER) += $(FATE_FILTER_PALETTEUSE)
 
+# palettegen and the undithered paletteuse are slice threaded, the output
+# must not change
+FATE_FILTER-$(call ALLYES, TESTSRC2_FILTER SCALE_FILTER PALETTEGEN_FILTER) += fate-filter-palettegen-testsrc2 fate-filter-palettegen-testsrc2-threads
+fate-filter-palettegen-testsrc2: CMD = framecrc -lavfi testsrc2=d=1,scale,palettegen,scale -pix_fmt bgra
+fate-filter-palettegen-testsrc2-threads: CMD = framecrc -filter_complex_threads 4 -lavfi testsrc2=d=1,scale,palettegen,scale -pix_fmt bgra
+fate-filter-palettegen-testsrc2-threads: REF = $(SRC_PATH)/tests/ref/fate/filter-palettegen-testsrc2
+
+FATE_FILTER-$(call ALLYES, TESTSRC2_FILTER SCALE_FILTER PALETTEGEN_FILTER) += fate-filter-palettegen-testsrc2-diff fate-filter-palettegen-testsrc2-diff-threads
+fate-filter-palettegen-testsrc2-diff: CMD = framecrc -lavfi testsrc2=d=1,scale,palettegen=max_colors=128:reserve_transparent=0:stats_mode=diff,scale -pix_fmt bgra
+fate-filter-palettegen-testsrc2-diff-threads: CMD = framecrc -filter_complex_threads 4 -lavfi testsrc2=d=1,scale,palettegen=max_colors=128:reserve_transparent=0:stats_mode=diff,scale -pix_fmt bgra
+fate-filter-palettegen-testsrc2-diff-threads: REF = $(SRC_PATH)/tests/ref/fate/filter-palettegen-testsrc2-diff
+
+FATE_FILTER-$(call ALLYES, TESTSRC2_FILTER SCALE_FILTER SPLIT_FILTER PALETTEGEN_FILTER PALETTEUSE_FILTER) += fate-filter-paletteuse-testsrc2-nodither fate-filter-paletteuse-testsrc2-nodither-threads
+fate-filter-paletteuse-testsrc2-nodither: CMD = framecrc -lavfi "testsrc2=d=1,scale,split[a][b];[b]palettegen[p];[a][p]paletteuse=dither=none,scale" -pix_fmt bgra
+fate-filter-paletteuse-testsrc2-nodither-threads: CMD = framecrc -filter_complex_threads 4 -lavfi "testsrc2=d=1,scale,split[a][b];[b]palettegen[p];[a][p]paletteuse=dither=none,scale" -pix_fmt bgra
+fate-filter-paletteuse-testsrc2-nodither-threads: REF = $(SRC_PATH)/tests/ref/fate/filter-paletteuse-testsrc2-nodither
+
+# zscale is split into bands without dithering only, both must not depend
+# on the number of threads
+FATE_FILTER-$(call ALLYES, TESTSRC2_FILTER ZSCALE_FILTER) += fate-filter-zscale-threads fate-filter-zscale-threads-dither
+fate-filter-zscale-threads: CMD = filter_threads -lavfi testsrc2=d=1,zscale=w=200:h=150:f=spline36:d=none,format=yuv420p
+fate-filter-zscale-threads-dither: CMD = filter_threads -lavfi testsrc2=d=1,zscale=w=200:h=150:d=error_diffusion,format=yuv420p
+fate-filter-zscale-threads fate-filter-zscale-threads-dither: CMP = oneline
+fate-filter-zscale-threads fate-filter-zscale-threads-dither: REF = identical
+
 FATE_FILTER-$(call ALLYES, AVDEVICE LIFE_FILTER) += fate-filter-lavd-life
 fate-filter-lavd-life: CMD = framecrc -f lavfi -i life=s=40x40:r=5:seed=42:mold=64:ratio=0.1:death_color=red:life_color=green -t 2
 
@@ -126,6 +151,33 @@ FATE_FILTER-$(call ALLYES, MINTERPOLATE_FILTER TESTSRC2_FILTER) += fate-filter-m
 fate-filter-minterpolate-up: CMD = framecrc -lavfi testsrc2=r=2:d=10,minterpolate=fps=10 -t 1
 fate-filter-minterpolate-down: CMD = framecrc -lavfi testsrc2=r=2:d=10,minterpolate=fps=1 -t 1
 
+# minterpolate is slice threaded, the output must not change.
+FATE_FILTER-$(call ALLYES, MINTERPOLATE_FILTER TESTSRC2_FILTER) += fate-filter-minterpolate-up-threads
+fate-filter-minterpolate-up-threads: CMD = framecrc -filter_complex_threads 4 -lavfi testsrc2=r=2:d=10,minterpolate=fps=10 -t 1
+
+# same on the shared thread pool
+FATE_FILTER-$(call ALLYES, MINTERPOLATE_FILTER TESTSRC2_FILTER) += fate-filter-minterpolate-up-shared-threads
+fate-filter-minterpolate-up-shared-threads: CMD = framecrc -filter_shared_threads -filter_complex_threads 4 -lavfi testsrc2=r=2:d=10,minterpolate=fps=10 -t 1
+fate-filter-minterpolate-up-shared-threads: REF = $(SRC_PATH)/tests/ref/fate/filter-minterpolate-up
+
+# diamond search splits the motion estimation by block rows
+FATE_FILTER-$(call ALLYES, MINTERPOLATE_FILTER TESTSRC2_FILTER) += fate-filter-minterpolate-ds fate-filter-minterpolate-ds-threads
+fate-filter-minterpolate-ds: CMD = framecrc -lavfi testsrc2=r=2:d=10,minterpolate=fps=10:me=ds -t 1
+fate-filter-minterpolate-ds-threads: CMD = framecrc -filter_complex_threads 4 -lavfi testsrc2=r=2:d=10,minterpolate=fps=10:me=ds -t 1
+fate-filter-minterpolate-ds-threads: REF = $(SRC_PATH)/tests/ref/fate/filter-minterpolate-ds
+
+# bidirectional motion estimation, split by direction with EPZS and by
+# block rows of each direction with diamond search
+FATE_FILTER-$(call ALLYES, MINTERPOLATE_FILTER TESTSRC2_FILTER) += fate-filter-minterpolate-bidir fate-filter-minterpolate-bidir-threads
+fate-filter-minterpolate-bidir: CMD = framecrc -lavfi testsrc2=r=2:d=10,minterpolate=fps=10:me_mode=bidir -t 1
+fate-filter-minterpolate-bidir-threads: CMD = framecrc -filter_complex_threads 4 -lavfi testsrc2=r=2:d=10,minterpolate=fps=10:me_mode=bidir -t 1
+fate-filter-minterpolate-bidir-threads: REF = $(SRC_PATH)/tests/ref/fate/filter-minterpolate-bidir
+
+FATE_FILTER-$(call ALLYES, MINTERPOLATE_FILTER TESTSRC2_FILTER) += fate-filter-minterpolate-bidir-ds fate-filter-minterpolate-bidir-ds-threads
+fate-filter-minterpolate-bidir-ds: CMD = framecrc -lavfi testsrc2=r=2:d=10,minterpolate=fps=10:me_mode=bidir:me=ds -t 1
+fate-filter-minterpolate-bidir-ds-threads: CMD = framecrc -filter_complex_threads 4 -lavfi testsrc2=r=2:d=10,minterpolate=fps=10:me_mode=bidir:me=ds -t 1
+fate-filter-minterpolate-bidir-ds-threads: REF = $(SRC_PATH)/tests/ref/fate/filter-minterpolate-bidir-ds
+
 FATE_FILTER_VSYNTH-$(CONFIG_BOXBLUR_FILTER) += fate-filter-boxblur
 fate-filter-boxblur: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf boxblur=2:1
 
@@ -32,11 +32,16 @@ FATE_MOV_FFPROBE = fate-mov-neg-firstpts-discard \
 
 FATE_MOV_FASTSTART = fate-mov-faststart-4gb-overflow \
 
-FATE_SAMPLES_AVCONV += $(FATE_MOV)
+FATE_MOV_COMPACT_INDEX = fate-mov-1elist-noctts-compact-index \
+                         fate-mov-1elist-1ctts-compact-index \
+                         fate-mov-3elist-compact-index \
+                         fate-mov-frag-overlap-compact-index \
+
+FATE_SAMPLES_AVCONV += $(FATE_MOV) $(FATE_MOV_COMPACT_INDEX)
 FATE_SAMPLES_FFPROBE += $(FATE_MOV_FFPROBE)
 FATE_SAMPLES_FASTSTART += $(FATE_MOV_FASTSTART)
 
-fate-mov: $(FATE_MOV) $(FATE_MOV_FFPROBE) $(FATE_MOV_FASTSTART)
+fate-mov: $(FATE_MOV) $(FATE_MOV_FFPROBE) $(FATE_MOV_FASTSTART) $(FATE_MOV_COMPACT_INDEX)
 
 # Make sure we handle edit lists correctly in normal cases.
 fate-mov-1elist-noctts: CMD = framemd5 -i $(TARGET_SAMPLES)/mov/mov-1elist-noctts.mov
@@ -83,6 +88,14 @@ fate-mov-ibi-elst-starts-b: CMD = framemd5 -flags +bitexact -i $(TARGET_SAMPLES)
 # Makes sure that we handle overlapping framgments
 fate-mov-frag-overlap: CMD = framemd5 -i $(TARGET_SAMPLES)/mov/frag_overlap.mp4
 
+# The compact index must give the same packets as the full one, also for
+# the edit lists and fragments it hands over to a full index.
+$(FATE_MOV_COMPACT_INDEX): REF = $(SRC_PATH)/tests/ref/fate/$(@:fate-%-compact-index=%)
+fate-mov-1elist-noctts-compact-index: CMD = framemd5 -compact_index 1 -i $(TARGET_SAMPLES)/mov/mov-1elist-noctts.mov
+fate-mov-1elist-1ctts-compact-index: CMD = framemd5 -compact_index 1 -i $(TARGET_SAMPLES)/mov/mov-1elist-1ctts.mov
+fate-mov-3elist-compact-index: CMD = framemd5 -compact_index 1 -i $(TARGET_SAMPLES)/mov/mov-3elist.mov
+fate-mov-frag-overlap-compact-index: CMD = framemd5 -compact_index 1 -i $(TARGET_SAMPLES)/mov/frag_overlap.mp4
+
 # Makes sure that we pick the right frames according to edit list when there is no keyframe with PTS < edit list start.
 # For example, when video starts on a B-frame, and edit list starts on that B-frame too.
 # GOP structure : B B I in presentation order.
@@ -22,4 +22,18 @@ fate-mpegts-probe-pmt-merge: CMD = run $(PROBE_CODEC_NAME_COMMAND) -merge_pmt_ve
 
 FATE_SAMPLES_FFPROBE += $(FATE_MPEGTS_PROBE-yes)
 
-fate-mpegts: $(FATE_MPEGTS_PROBE-yes)
+
+#
+# Test that probing the streams on several threads finds the same parameters
+#
+FATE_MPEGTS_PROBE_THREADS-$(call ALLYES, RAWVIDEO_DEMUXER WAV_DEMUXER MPEG4_ENCODER AAC_ENCODER \
+                                         MPEGTS_MUXER MPEGTS_DEMUXER MPEG4_DECODER AAC_DECODER  \
+                                         FRAMECRC_MUXER) += fate-mpegts-probe-threads
+fate-mpegts-probe-threads: tests/data/vsynth1.yuv tests/data/asynth-44100-2.wav
+fate-mpegts-probe-threads: CMD = probe_threads "-f rawvideo -s 352x288 -pix_fmt yuv420p" tests/data/vsynth1.yuv tests/data/asynth-44100-2.wav \
+    "-auto_conversion_filters -map 0:v -map 1:a -map 0:v -map 1:a -map 1:a -c:v mpeg4 -qscale 10 -c:a aac -b:a 64k -t 1 \
+     -program st=0:st=1 -program st=2:st=3:st=4 -flags +bitexact -fflags +bitexact"
+
+FATE_AVCONV += $(FATE_MPEGTS_PROBE_THREADS-yes)
+
+fate-mpegts: $(FATE_MPEGTS_PROBE-yes) $(FATE_MPEGTS_PROBE_THREADS-yes)
@@ -266,12 +266,50 @@ fate-seek-mkv-codec-delay:   CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_
 
 FATE_SEEK_EXTRA += $(FATE_SEEK_EXTRA-yes)
 
+# read-ahead must not change the seek results
+FATE_SEEK_PREFETCH-$(call ENCDEC2, MPEG4, MP2,      MATROSKA) += fate-seek-prefetch-mkv
+FATE_SEEK_PREFETCH-$(call ENCDEC2, MPEG4, PCM_ALAW, MOV)      += fate-seek-prefetch-mov
 
-$(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA): libavformat/tests/seek$(EXESUF)
+fate-seek-prefetch-mkv: fate-lavf-mkv
+fate-seek-prefetch-mkv: CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/lavf/lavf.mkv -prefetch_size 65536
+fate-seek-prefetch-mkv: REF = $(SRC_PATH)/tests/ref/seek/lavf-mkv
+fate-seek-prefetch-mov: fate-lavf-mov
+fate-seek-prefetch-mov: CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/lavf/lavf.mov -prefetch_size 65536
+fate-seek-prefetch-mov: REF = $(SRC_PATH)/tests/ref/seek/lavf-mov
+
+FATE_SEEK_PREFETCH += $(FATE_SEEK_PREFETCH-yes)
+
+# the compact mov index must seek like the full one
+FATE_SEEK_COMPACT_INDEX-$(call ENCDEC2, MPEG4, PCM_ALAW, MOV) += fate-seek-compact-index-mov
+FATE_SEEK_COMPACT_INDEX_SAMPLES-$(CONFIG_MOV_DEMUXER) += fate-seek-compact-index-test-iibbibb-mp4
+FATE_SEEK_COMPACT_INDEX_SAMPLES-$(CONFIG_MOV_DEMUXER) += fate-seek-compact-index-test-iibbibb-neg-ctts-mp4
+
+fate-seek-compact-index-mov: fate-lavf-mov
+fate-seek-compact-index-mov: CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/lavf/lavf.mov -compact_index 1
+fate-seek-compact-index-mov: REF = $(SRC_PATH)/tests/ref/seek/lavf-mov
+fate-seek-compact-index-test-iibbibb-mp4: CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_SAMPLES)/mov/test_iibbibb.mp4 -duration 13 -frames 4 -compact_index 1
+fate-seek-compact-index-test-iibbibb-mp4: REF = $(SRC_PATH)/tests/ref/seek/test-iibbibb-mp4
+fate-seek-compact-index-test-iibbibb-neg-ctts-mp4: CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_SAMPLES)/mov/test_iibbibb_neg_ctts.mp4 -duration 13 -frames 4 -compact_index 1
+fate-seek-compact-index-test-iibbibb-neg-ctts-mp4: REF = $(SRC_PATH)/tests/ref/seek/test-iibbibb-neg-ctts-mp4
+
+FATE_SEEK_COMPACT_INDEX += $(FATE_SEEK_COMPACT_INDEX-yes)
+FATE_SEEK_COMPACT_INDEX_SAMPLES += $(FATE_SEEK_COMPACT_INDEX_SAMPLES-yes)
+
+# the index cache must not change the demuxed packets, and a cache of
+# another or a broken file must not be used
+FATE_SEEK_INDEX_CACHE-$(call ALLYES, RAWVIDEO_DEMUXER MPEG4_ENCODER MPEGTS_MUXER MPEGTS_DEMUXER FRAMECRC_MUXER) += fate-seek-index-cache-ts
+
+fate-seek-index-cache-ts: tests/data/vsynth1.yuv
+fate-seek-index-cache-ts: CMD = index_cache "-f rawvideo -s 352x288 -pix_fmt yuv420p" tests/data/vsynth1.yuv "-c:v mpeg4 -qscale 10 -g 10"
+
+FATE_SEEK_INDEX_CACHE += $(FATE_SEEK_INDEX_CACHE-yes)
+
+
+$(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA) $(FATE_SEEK_PREFETCH) $(FATE_SEEK_COMPACT_INDEX) $(FATE_SEEK_COMPACT_INDEX_SAMPLES) $(FATE_SEEK_INDEX_CACHE): libavformat/tests/seek$(EXESUF)
 $(FATE_SEEK) $(FATE_SAMPLES_SEEK): CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/$(SRC)
 $(FATE_SEEK) $(FATE_SAMPLES_SEEK): fate-seek-%: fate-%
 fate-seek-%: REF = $(SRC_PATH)/tests/ref/seek/$(@:fate-seek-%=%)
 
-FATE_AVCONV += $(FATE_SEEK)
-FATE_SAMPLES_AVCONV += $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
-fate-seek:     $(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
+FATE_AVCONV += $(FATE_SEEK) $(FATE_SEEK_PREFETCH) $(FATE_SEEK_COMPACT_INDEX) $(FATE_SEEK_INDEX_CACHE)
+FATE_SAMPLES_AVCONV += $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA) $(FATE_SEEK_COMPACT_INDEX_SAMPLES)
+fate-seek:     $(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA) $(FATE_SEEK_PREFETCH) $(FATE_SEEK_COMPACT_INDEX) $(FATE_SEEK_COMPACT_INDEX_SAMPLES) $(FATE_SEEK_INDEX_CACHE)
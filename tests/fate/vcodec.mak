@@ -232,6 +232,11 @@ fate-vsynth%-jpeg2000:                DECINOPTS = -c:v jpeg2000
 fate-vsynth%-jpeg2000-97:             ENCOPTS = -qscale 7 -strict experimental -pix_fmt rgb24
 fate-vsynth%-jpeg2000-97:             DECINOPTS = -c:v jpeg2000
 
+# Tier-1 coding is distributed over threads, the output must not change.
+FATE_VCODEC_MT-$(call ENCDEC, JPEG2000, AVI) += jpeg2000-97-threads
+fate-vsynth%-jpeg2000-97-threads:     ENCOPTS = -qscale 7 -strict experimental -pix_fmt rgb24 -threads 4
+fate-vsynth%-jpeg2000-97-threads:     DECINOPTS = -c:v jpeg2000
+
 FATE_VCODEC-$(call ENCDEC, LJPEG MJPEG, AVI) += ljpeg
 fate-vsynth%-ljpeg:              ENCOPTS = -strict -1
 
@@ -243,6 +248,12 @@ fate-vsynth%-mjpeg-trell:             ENCOPTS = -qscale 9 -pix_fmt yuvj420p -tre
 fate-vsynth%-mjpeg-huffman:           ENCOPTS = -qscale 9 -pix_fmt yuvj420p -huffman optimal
 fate-vsynth%-mjpeg-trell-huffman:     ENCOPTS = -qscale 9 -pix_fmt yuvj420p -trellis 1 -huffman optimal
 
+# Slice threaded encoding adds restart markers, which the decoder in turn
+# uses to decode the restart intervals in parallel.
+FATE_VCODEC_MT-$(call ENCDEC, MJPEG, AVI) += mjpeg-rst
+fate-vsynth%-mjpeg-rst:               ENCOPTS = -qscale 9 -pix_fmt yuvj420p -threads 4 -thread_type slice
+fate-vsynth%-mjpeg-rst:               THREADS = 4
+
 FATE_VCODEC-$(call ENCDEC, MPEG1VIDEO, MPEG1VIDEO MPEGVIDEO) += mpeg1 mpeg1b
 fate-vsynth%-mpeg1:              FMT     = mpeg1video
 fate-vsynth%-mpeg1:              CODEC   = mpeg1video
@@ -288,6 +299,21 @@ fate-vsynth%-mpeg2-thread:       ENCOPTS = -qscale 10 -bf 2 -flags +ildct+ilme \
 fate-vsynth%-mpeg2-thread-ivlc:  ENCOPTS = -qscale 10 -bf 2 -flags +ildct+ilme \
                                            -intra_vlc 1 -threads 2 -slices 2
 
+# Check the order and timestamps of the packets of GOP-parallel encoding
+FATE_AVCONV-$(call ALLYES, RAWVIDEO_DEMUXER RAWVIDEO_DECODER MPEG2VIDEO_ENCODER FRAMECRC_MUXER) += fate-mpeg2-gop-thread
+fate-mpeg2-gop-thread: tests/data/vsynth1.yuv
+fate-mpeg2-gop-thread: CMD = framecrc -f rawvideo -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv \
+                             -c:v mpeg2video -qscale 10 -bf 2 -g 12 -threads 3 -gop_lookahead 1
+
+# Slice threaded encoding on the shared thread pool must match private threads
+FATE_AVCONV-$(call ALLYES, RAWVIDEO_DEMUXER RAWVIDEO_DECODER MPEG4_ENCODER FRAMECRC_MUXER) += fate-mpeg4-slice-thread fate-mpeg4-slice-thread-shared
+fate-mpeg4-slice-thread fate-mpeg4-slice-thread-shared: tests/data/vsynth1.yuv
+fate-mpeg4-slice-thread: CMD = framecrc -f rawvideo -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv \
+                               -c:v mpeg4 -qscale 10 -threads 4 -slices 4
+fate-mpeg4-slice-thread-shared: CMD = framecrc -f rawvideo -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv \
+                                      -c:v mpeg4 -qscale 10 -threads 4 -slices 4 -shared_threads 1
+fate-mpeg4-slice-thread-shared: REF = $(SRC_PATH)/tests/ref/fate/mpeg4-slice-thread
+
 FATE_MPEG4_MP4 = mpeg4
 FATE_MPEG4_AVI = mpeg4-rc                                               \
                  mpeg4-adv                                              \
@@ -477,6 +503,10 @@ VSYNTH3_OFF  = $(RESIZE_OFF) $(INC_PAR_OFF)
 FATE_VCODEC3 = $(filter-out $(VSYNTH3_OFF),$(FATE_VCODEC))
 FATE_VSYNTH3 = $(FATE_VCODEC3:%=fate-vsynth3-%)
 
+FATE_VSYNTH1 += $(FATE_VCODEC_MT-yes:%=fate-vsynth1-%)
+FATE_VSYNTH2 += $(FATE_VCODEC_MT-yes:%=fate-vsynth2-%)
+FATE_VSYNTH3 += $(FATE_VCODEC_MT-yes:%=fate-vsynth3-%)
+
 $(FATE_VSYNTH1): tests/data/vsynth1.yuv
 $(FATE_VSYNTH2): tests/data/vsynth2.yuv
 $(FATE_VSYNTH_LENA): tests/data/vsynth_lena.yuv
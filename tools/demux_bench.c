@@ -0,0 +1,133 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Measure the demuxing throughput of a file, i.e. how fast av_read_frame()
+ * returns all of its packets, optionally with all but one stream discarded.
+ *
+ * With -p the parsers are disabled, so that mostly the demuxer itself is
+ * measured; this is how the MPEG-TS packet loop is best looked at. The
+ * checksum over the packet sizes, timestamps and positions allows to
+ * compare the output of two builds.
+ *
+ * Build with: make tools/demux_bench
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "config.h"
+#if HAVE_UNISTD_H
+#include <unistd.h> /* for getopt */
+#endif
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+#include "libavformat/avformat.h"
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+#include "libavutil/time.h"
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-s stream] [-n runs] [-p] file\n"
+            "  -s  keep only this stream, discard all others\n"
+            "  -n  runs, the best one is printed (default 5)\n"
+            "  -p  do not parse the packets\n",
+            name);
+}
+
+static int bench(const char *filename, int keep, int noparse, int64_t *time,
+                 int64_t *nb_packets, int64_t *size, uint32_t *check)
+{
+    AVFormatContext *s = avformat_alloc_context();
+    AVPacket pkt;
+    int64_t start;
+    int i, ret;
+
+    if (!s)
+        return AVERROR(ENOMEM);
+    if (noparse)
+        s->flags |= AVFMT_FLAG_NOPARSE | AVFMT_FLAG_NOFILLIN;
+    if ((ret = avformat_open_input(&s, filename, NULL, NULL)) < 0)
+        return ret;
+    if (keep >= (int)s->nb_streams) {
+        avformat_close_input(&s);
+        return AVERROR(EINVAL);
+    }
+    if (keep >= 0) {
+        for (i = 0; i < s->nb_streams; i++)
+            if (i != keep)
+                s->streams[i]->discard = AVDISCARD_ALL;
+    }
+
+    *nb_packets = 0;
+    *check      = 0;
+    start = av_gettime_relative();
+    while ((ret = av_read_frame(s, &pkt)) >= 0) {
+        (*nb_packets)++;
+        *check = *check * 31 + pkt.size + (uint32_t)pkt.pts +
+                 (uint32_t)pkt.pos + pkt.stream_index;
+        av_packet_unref(&pkt);
+    }
+    *time = av_gettime_relative() - start;
+    *size = avio_size(s->pb);
+
+    avformat_close_input(&s);
+    return ret == AVERROR_EOF ? 0 : ret;
+}
+
+int main(int argc, char **argv)
+{
+    int64_t best = INT64_MAX, time, nb_packets = 0, size = 0;
+    uint32_t check = 0;
+    int keep = -1, nb_runs = 5, noparse = 0;
+    int i, opt, ret;
+
+    while ((opt = getopt(argc, argv, "s:n:ph")) != -1) {
+        switch (opt) {
+        case 's': keep    = atoi(optarg); break;
+        case 'n': nb_runs = atoi(optarg); break;
+        case 'p': noparse = 1;            break;
+        default:
+            usage(argv[0]);
+            return opt != 'h';
+        }
+    }
+    if (optind != argc - 1 || nb_runs < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    av_log_set_level(AV_LOG_FATAL);
+
+    for (i = 0; i < nb_runs; i++) {
+        if ((ret = bench(argv[optind], keep, noparse, &time, &nb_packets,
+                         &size, &check)) < 0) {
+            fprintf(stderr, "Error: %s\n", av_err2str(ret));
+            return 1;
+        }
+        best = FFMIN(best, time);
+    }
+
+    printf("%"PRId64" packets in %.2f ms, %.0f MB/s, check %08"PRIx32"\n",
+           nb_packets, best / 1000.0, size / (double)best, check);
+    return 0;
+}
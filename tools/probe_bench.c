@@ -0,0 +1,141 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Measure the time avformat_find_stream_info() takes on a file, for several
+ * values of the probe_threads option.
+ *
+ * The interesting inputs have many streams, e.g. a transport stream with
+ * several programs, which can be made with
+ *   ffmpeg -f lavfi -i testsrc=s=1280x720 -f lavfi -i sine \
+ *          -map 0 -map 1 -map 1 -map 0 -map 1 -map 1 -t 10 \
+ *          -program st=0:st=1:st=2 -program st=3:st=4:st=5 multi.ts
+ *
+ * Build with: make tools/probe_bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "config.h"
+#if HAVE_UNISTD_H
+#include <unistd.h> /* for getopt */
+#endif
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+#include "libavformat/avformat.h"
+#include "libavutil/avstring.h"
+#include "libavutil/dict.h"
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-t threads[,threads...]] [-l latency] [-n runs] file\n"
+            "  -t  probe_threads values to compare, 0 for one per CPU (default 1,0)\n"
+            "  -l  max_probe_latency in microseconds (default none)\n"
+            "  -n  runs per value, the best one is printed (default 10)\n",
+            name);
+}
+
+static int bench(const char *filename, const char *threads, const char *latency,
+                 int nb_runs)
+{
+    int64_t best = INT64_MAX;
+    int i, j, found = 0, nb_streams = 0, ret = 0;
+
+    for (i = 0; i < nb_runs; i++) {
+        AVFormatContext *s = NULL;
+        AVDictionary *opts = NULL;
+        int64_t start, elapsed;
+
+        av_dict_set(&opts, "probe_threads", threads, 0);
+        if (latency)
+            av_dict_set(&opts, "max_probe_latency", latency, 0);
+        ret = avformat_open_input(&s, filename, NULL, &opts);
+        av_dict_free(&opts);
+        if (ret < 0)
+            return ret;
+
+        start = av_gettime_relative();
+        ret = avformat_find_stream_info(s, NULL);
+        elapsed = av_gettime_relative() - start;
+        if (ret < 0) {
+            avformat_close_input(&s);
+            return ret;
+        }
+        best = FFMIN(best, elapsed);
+
+        /* the streams whose parameters were found */
+        found = 0;
+        for (j = 0; j < s->nb_streams; j++) {
+            AVCodecParameters *par = s->streams[j]->codecpar;
+            found += par->sample_rate > 0 || par->width > 0;
+        }
+        nb_streams = s->nb_streams;
+        avformat_close_input(&s);
+    }
+
+    printf("probe_threads %-4s %8.2f ms, %d/%d streams with parameters\n",
+           threads, best / 1000.0, found, nb_streams);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *latency = NULL, *threads = "1,0";
+    char *list, *value, *saveptr = NULL;
+    int nb_runs = 10;
+    int opt, ret = 0;
+
+    while ((opt = getopt(argc, argv, "t:l:n:h")) != -1) {
+        switch (opt) {
+        case 't': threads = optarg;       break;
+        case 'l': latency = optarg;       break;
+        case 'n': nb_runs = atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            return opt != 'h';
+        }
+    }
+    if (optind != argc - 1 || nb_runs < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    av_log_set_level(AV_LOG_ERROR);
+
+    list = av_strdup(threads);
+    if (!list)
+        return 1;
+    for (value = av_strtok(list, ",", &saveptr); value;
+         value = av_strtok(NULL, ",", &saveptr)) {
+        if ((ret = bench(argv[optind], value, latency, nb_runs)) < 0)
+            break;
+    }
+    av_free(list);
+
+    if (ret < 0) {
+        fprintf(stderr, "Error: %s\n", av_err2str(ret));
+        return 1;
+    }
+    return 0;
+}
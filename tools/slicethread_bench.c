@@ -0,0 +1,199 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Measure the throughput of slice threading on a memory bound workload,
+ * with several contexts (codecs or filtergraphs) running at the same time.
+ *
+ * Every context owns a buffer which its jobs update in slices. With -a the
+ * threads are pinned to a list of CPUs before they first write the buffer.
+ * With -S the contexts run on the process-wide shared pool instead of
+ * threads of their own.
+ *
+ * Build with: make tools/slicethread_bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "config.h"
+#if HAVE_UNISTD_H
+#include <unistd.h> /* for getopt */
+#endif
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+#include "libavutil/slicethread.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#if HAVE_THREADS
+
+#define MAX_CONTEXTS 64
+
+typedef struct BenchContext {
+    AVSliceThread *thread;
+    pthread_t      tid;
+    uint64_t      *buf;
+    size_t         nb_words;
+    int            nb_jobs;
+    int            nb_runs;
+    int            touched;
+} BenchContext;
+
+static void worker(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    BenchContext *c = priv;
+    size_t start = c->nb_words *  jobnr      / nb_jobs;
+    size_t end   = c->nb_words * (jobnr + 1) / nb_jobs;
+    size_t i;
+
+    if (!c->touched) {
+        for (i = start; i < end; i++)
+            c->buf[i] = i;
+    } else {
+        for (i = start; i < end; i++)
+            c->buf[i] = c->buf[i] * 3 + i;
+    }
+}
+
+static void *run_context(void *arg)
+{
+    BenchContext *c = arg;
+    int i;
+
+    for (i = 0; i < c->nb_runs; i++)
+        avpriv_slicethread_execute(c->thread, c->nb_jobs, 0);
+    return NULL;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-c contexts] [-t threads] [-j jobs] [-m MiB] "
+            "[-n runs] [-a cpus] [-S]\n"
+            "  -c  number of contexts running at the same time (default 1)\n"
+            "  -t  threads per context, 0 for one per CPU (default 0)\n"
+            "  -j  jobs per run (default 64)\n"
+            "  -m  buffer size of each context in MiB (default 64)\n"
+            "  -n  runs per context (default 50)\n"
+            "  -a  pin the threads to a CPU list, e.g. 0-7,16-23\n"
+            "  -S  run all contexts on the shared thread pool\n",
+            name);
+}
+
+int main(int argc, char **argv)
+{
+    BenchContext ctx[MAX_CONTEXTS] = { { 0 } };
+    const char *cpus = NULL;
+    int nb_contexts = 1, nb_threads = 0, nb_jobs = 64, size = 64, nb_runs = 50;
+    int shared = 0;
+    int i, opt, ret = 0;
+    int64_t start, elapsed;
+
+    while ((opt = getopt(argc, argv, "c:t:j:m:n:a:Sh")) != -1) {
+        switch (opt) {
+        case 'c': nb_contexts = atoi(optarg); break;
+        case 't': nb_threads  = atoi(optarg); break;
+        case 'j': nb_jobs     = atoi(optarg); break;
+        case 'm': size        = atoi(optarg); break;
+        case 'n': nb_runs     = atoi(optarg); break;
+        case 'a': cpus        = optarg;       break;
+        case 'S': shared      = 1;            break;
+        default:
+            usage(argv[0]);
+            return opt != 'h';
+        }
+    }
+    if (nb_contexts < 1 || nb_contexts > MAX_CONTEXTS || nb_threads < 0 ||
+        nb_jobs < 1 || size < 1 || nb_runs < 1 || (shared && cpus)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    for (i = 0; i < nb_contexts; i++) {
+        BenchContext *c = &ctx[i];
+
+        c->nb_words = (size_t)size << 17;
+        c->nb_jobs  = nb_jobs;
+        c->nb_runs  = nb_runs;
+        c->buf = av_malloc_array(c->nb_words, sizeof(*c->buf));
+        if (!c->buf) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        ret = shared ? avpriv_slicethread_create_shared(&c->thread, c, worker, nb_threads) :
+                       avpriv_slicethread_create(&c->thread, c, worker, NULL, nb_threads);
+        if (ret < 0)
+            goto end;
+        if (i == 0)
+            printf("%d context(s), %d thread(s) each%s\n", nb_contexts, ret,
+                   shared ? " on the shared pool" : "");
+        if (cpus && (ret = avpriv_slicethread_set_affinity(c->thread, cpus)) < 0)
+            goto end;
+
+        /* let the (pinned) threads write the buffer once */
+        avpriv_slicethread_execute(c->thread, c->nb_jobs, 0);
+        c->touched = 1;
+    }
+
+    start = av_gettime_relative();
+    if (nb_contexts == 1) {
+        run_context(&ctx[0]);
+    } else {
+        for (i = 0; i < nb_contexts; i++) {
+            if ((ret = pthread_create(&ctx[i].tid, NULL, run_context, &ctx[i]))) {
+                ret = AVERROR(ret);
+                while (--i >= 0)
+                    pthread_join(ctx[i].tid, NULL);
+                goto end;
+            }
+        }
+        for (i = 0; i < nb_contexts; i++)
+            pthread_join(ctx[i].tid, NULL);
+    }
+    elapsed = av_gettime_relative() - start;
+
+    printf("%.2f ms per run, %.0f MiB/s updated over all contexts\n",
+           elapsed / 1000.0 / nb_runs,
+           (double)size * nb_runs * nb_contexts * 1000000 / elapsed);
+    ret = 0;
+
+end:
+    for (i = 0; i < nb_contexts; i++) {
+        avpriv_slicethread_free(&ctx[i].thread);
+        av_freep(&ctx[i].buf);
+    }
+    if (ret < 0) {
+        fprintf(stderr, "Error: %s\n", av_err2str(ret));
+        return 1;
+    }
+    return 0;
+}
+
+#else
+
+int main(void)
+{
+    fprintf(stderr, "This tool needs thread support.\n");
+    return 1;
+}
+
+#endif /* HAVE_THREADS */